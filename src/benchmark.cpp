@@ -0,0 +1,336 @@
+#include "benchmark.h"
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+
+namespace Benchmark
+{
+
+static double Percentile(const std::vector<double> &Sorted, const double Pct)
+{
+    // nearest-rank percentile of an already sorted list
+    if (Sorted.empty())
+        return 0.0;
+    const size_t Rank = static_cast<size_t>(std::ceil(Pct / 100.0 * Sorted.size()));
+    return Sorted[std::clamp<size_t>(Rank, 1, Sorted.size()) - 1];
+}
+
+std::string Config::Mode() const
+{
+    if (!bFoveated)
+        return "full";
+    if (Strategy == FovStrategy::Checkerboard && Reconstruction == ReconstructionMode::Temporal)
+        return fstos(Strategy) + "-temporal";
+    return fstos(Strategy);
+}
+
+void Result::Summarize()
+{
+    if (FrameMs.empty())
+        return;
+    std::vector<double> Sorted = FrameMs;
+    std::sort(Sorted.begin(), Sorted.end());
+    Mean = std::accumulate(Sorted.begin(), Sorted.end(), 0.0) / Sorted.size();
+    P50 = Percentile(Sorted, 50.0);
+    P95 = Percentile(Sorted, 95.0);
+    P99 = Percentile(Sorted, 99.0);
+
+    PassMean.clear();
+    for (const auto &Pass : PassMs)
+        PassMean.push_back(Pass.empty() ? 0.0 : std::accumulate(Pass.begin(), Pass.end(), 0.0) / Pass.size());
+}
+
+double Result::GpuMs() const
+{
+    const double Sum = std::accumulate(PassMean.begin(), PassMean.end(), 0.0);
+    return (Sum > 0.0) ? Sum : Mean;
+}
+
+std::string ThresholdsName(const std::vector<float> &Thresholds)
+{
+    std::ostringstream Name;
+    for (size_t i = 0; i < Thresholds.size(); i++)
+        Name << (i > 0 ? ":" : "") << Thresholds[i];
+    return Name.str();
+}
+
+std::vector<Config> BuildSweep(const BenchmarkParamsStruct &P, const std::string &Shader)
+{
+    std::vector<Config> Sweep;
+    Config Baseline;
+    Baseline.Shader = Shader;
+    Baseline.bFoveated = false;
+    Sweep.push_back(Baseline);
+    for (const FovStrategy Strategy : P.strategies)
+    {
+        // multires has no stride or reconstruction, only sweep its thresholds once
+        const bool bMultiRes = (Strategy == FovStrategy::MultiRes);
+        const std::vector<int> Strides = bMultiRes ? std::vector<int>{0} : P.strides;
+        const std::vector<ReconstructionMode> Reconstructions =
+            bMultiRes ? std::vector<ReconstructionMode>{ReconstructionMode::Spatial} : P.reconstructions;
+        for (const ReconstructionMode Reconstruction : Reconstructions)
+        {
+            for (const int Stride : Strides)
+            {
+                for (const auto &Thresholds : P.thresholds)
+                {
+                    Config C;
+                    C.Shader = Shader;
+                    C.bFoveated = true;
+                    C.Strategy = Strategy;
+                    C.Reconstruction = Reconstruction;
+                    C.Stride = Stride;
+                    C.Thresholds = Thresholds;
+                    Sweep.push_back(C);
+                }
+            }
+        }
+    }
+    return Sweep;
+}
+
+void ComputeSpeedups(std::vector<Result> &Results)
+{
+    for (auto &R : Results)
+    {
+        for (const auto &Baseline : Results)
+        {
+            if (!Baseline.Cfg.bFoveated && Baseline.Cfg.Shader == R.Cfg.Shader && R.Mean > 0.0)
+                R.Speedup = Baseline.Mean / R.Mean;
+        }
+    }
+}
+
+static std::string ShaderName(const Config &C)
+{
+    return std::filesystem::path(C.Shader).filename().string();
+}
+
+void PrintComparison(const std::vector<Result> &Results)
+{
+    std::cout << std::endl << "shader, thresholds: full | best per strategy (mean ms, speedup)" << std::endl;
+    for (const auto &Baseline : Results)
+    {
+        if (Baseline.Cfg.bFoveated)
+            continue;
+        // every set of radii that was measured for this shader
+        std::vector<std::vector<float>> Thresholds;
+        for (const auto &R : Results)
+        {
+            if (R.Cfg.bFoveated && R.Cfg.Shader == Baseline.Cfg.Shader &&
+                std::find(Thresholds.begin(), Thresholds.end(), R.Cfg.Thresholds) == Thresholds.end())
+                Thresholds.push_back(R.Cfg.Thresholds);
+        }
+        for (const auto &T : Thresholds)
+        {
+            std::cout << ShaderName(Baseline.Cfg) << ", " << ThresholdsName(T) << ": " << Baseline.Mean << "ms";
+            for (const FovStrategy S : {FovStrategy::Checkerboard, FovStrategy::MultiRes})
+            {
+                const Result *Best = nullptr;
+                for (const auto &R : Results)
+                {
+                    if (R.Cfg.bFoveated && R.Cfg.Strategy == S && R.Cfg.Shader == Baseline.Cfg.Shader &&
+                        R.Cfg.Thresholds == T && (Best == nullptr || R.Mean < Best->Mean))
+                        Best = &R;
+                }
+                if (Best != nullptr)
+                {
+                    std::cout << " | " << Best->Cfg.Mode();
+                    if (Best->Cfg.Stride > 0)
+                        std::cout << " (stride " << Best->Cfg.Stride << ")";
+                    std::cout << ": " << Best->Mean << "ms (" << Best->Speedup << "x)";
+                }
+            }
+            std::cout << std::endl;
+        }
+    }
+    std::cout << std::endl;
+}
+
+static bool Dominates(const Result &A, const Result &B)
+{
+    // A is at least as cheap and as good as B, and strictly better in one of the two
+    const double CostA = A.GpuMs(), CostB = B.GpuMs();
+    const double QualityA = A.Quality.Ssim, QualityB = B.Quality.Ssim;
+    return CostA <= CostB && QualityA >= QualityB && (CostA < CostB || QualityA > QualityB);
+}
+
+void PrintPareto(const std::vector<Result> &Results)
+{
+    std::vector<std::string> Shaders;
+    for (const auto &R : Results)
+    {
+        if (R.bHasQuality && std::find(Shaders.begin(), Shaders.end(), R.Cfg.Shader) == Shaders.end())
+            Shaders.push_back(R.Cfg.Shader);
+    }
+    for (const std::string &Shader : Shaders)
+    {
+        std::vector<const Result *> Runs;
+        for (const auto &R : Results)
+        {
+            if (R.bHasQuality && R.Cfg.Shader == Shader)
+                Runs.push_back(&R);
+        }
+        std::sort(Runs.begin(), Runs.end(), [](const Result *A, const Result *B) { return A->GpuMs() < B->GpuMs(); });
+
+        const int NumRings = Runs.front()->Quality.NumRings;
+        std::cout << std::filesystem::path(Shader).filename().string()
+                  << ": mode, stride, thresholds, gpu ms, speedup, psnr, ssim";
+        for (int Ring = 0; Ring < NumRings; Ring++)
+            std::cout << ", " << ImageQuality::RingName(Ring, NumRings) << " ssim";
+        std::cout << " (* = pareto optimal)" << std::endl;
+        for (const Result *R : Runs)
+        {
+            const bool bOptimal =
+                std::none_of(Runs.begin(), Runs.end(), [&](const Result *O) { return Dominates(*O, *R); });
+            std::cout << (bOptimal ? " * " : "   ") << R->Cfg.Mode() << ", " << R->Cfg.Stride << ", "
+                      << ThresholdsName(R->Cfg.Thresholds) << ", " << R->GpuMs() << ", " << R->Speedup << "x, "
+                      << R->Quality.Psnr << "dB, " << R->Quality.Ssim;
+            for (int Ring = 0; Ring < R->Quality.NumRings; Ring++)
+                std::cout << ", " << R->Quality.RingSsim[Ring];
+            std::cout << std::endl;
+        }
+        std::cout << std::endl;
+    }
+}
+
+bool CheckQuality(const BenchmarkParamsStruct &P, const std::vector<Result> &Results)
+{
+    bool bPassed = true;
+    for (const auto &R : Results)
+    {
+        if (P.min_ssim > 0.f && R.bHasQuality && R.Cfg.bFoveated && R.Quality.Ssim < P.min_ssim)
+        {
+            std::cerr << "quality regression: " << ShaderName(R.Cfg) << " " << R.Cfg.Mode() << " stride "
+                      << R.Cfg.Stride << " scored ssim " << R.Quality.Ssim << " < " << P.min_ssim << std::endl;
+            bPassed = false;
+        }
+    }
+    return bPassed;
+}
+
+static std::vector<std::string> PassNames(const std::vector<Result> &Results)
+{
+    // every result is measured with the same passes
+    return Results.empty() ? std::vector<std::string>{} : Results.front().PassNames;
+}
+
+static bool WriteFramesCSV(const std::string &Path, const std::vector<Result> &Results)
+{
+    std::ofstream Out(Path);
+    if (!Out.is_open())
+        return false;
+    const std::vector<std::string> Passes = PassNames(Results);
+    Out << "shader,mode,stride,thresholds,frame,frame_ms";
+    for (const auto &Pass : Passes)
+        Out << ",gpu_" << Pass << "_ms";
+    Out << std::endl;
+    for (const auto &R : Results)
+    {
+        for (size_t i = 0; i < R.FrameMs.size(); i++)
+        {
+            Out << ShaderName(R.Cfg) << "," << R.Cfg.Mode() << "," << R.Cfg.Stride << ","
+                << ThresholdsName(R.Cfg.Thresholds) << "," << i << "," << R.FrameMs[i];
+            for (size_t P = 0; P < Passes.size(); P++)
+                Out << "," << (P < R.PassMs.size() ? R.PassMs[P][i] : 0.0);
+            Out << std::endl;
+        }
+    }
+    return true;
+}
+
+static bool WriteSummaryCSV(const std::string &Path, const std::vector<Result> &Results)
+{
+    std::ofstream Out(Path);
+    if (!Out.is_open())
+        return false;
+    const std::vector<std::string> Passes = PassNames(Results);
+    // as many ring columns as the profile with the most levels
+    int NumRings = 0;
+    for (const auto &R : Results)
+        NumRings = std::max(NumRings, R.bHasQuality ? R.Quality.NumRings : 0);
+    Out << "shader,mode,stride,thresholds,frames,mean_ms,p50_ms,p95_ms,p99_ms,speedup";
+    for (const auto &Pass : Passes)
+        Out << ",gpu_" << Pass << "_mean_ms";
+    Out << ",psnr,ssim";
+    for (int Ring = 0; Ring < NumRings; Ring++)
+        Out << "," << ImageQuality::RingName(Ring, NumRings) << "_psnr," << ImageQuality::RingName(Ring, NumRings)
+            << "_ssim";
+    Out << std::endl;
+    for (const auto &R : Results)
+    {
+        Out << ShaderName(R.Cfg) << "," << R.Cfg.Mode() << "," << R.Cfg.Stride << ","
+            << ThresholdsName(R.Cfg.Thresholds) << "," << R.FrameMs.size() << "," << R.Mean << "," << R.P50 << ","
+            << R.P95 << "," << R.P99 << "," << R.Speedup;
+        for (size_t P = 0; P < Passes.size(); P++)
+            Out << "," << (P < R.PassMean.size() ? R.PassMean[P] : 0.0);
+        // empty quality columns if it wasn't measured
+        Out << "," << (R.bHasQuality ? std::to_string(R.Quality.Psnr) : "") << ","
+            << (R.bHasQuality ? std::to_string(R.Quality.Ssim) : "");
+        for (int Ring = 0; Ring < NumRings; Ring++)
+        {
+            const bool bHasRing = R.bHasQuality && Ring < R.Quality.NumRings;
+            Out << "," << (bHasRing ? std::to_string(R.Quality.RingPsnr[Ring]) : "") << ","
+                << (bHasRing ? std::to_string(R.Quality.RingSsim[Ring]) : "");
+        }
+        Out << std::endl;
+    }
+    return true;
+}
+
+static bool WriteSummaryJSON(const std::string &Path, const std::vector<Result> &Results)
+{
+    std::ofstream Out(Path);
+    if (!Out.is_open())
+        return false;
+    Out << "{" << std::endl << "  \"results\": [" << std::endl;
+    for (size_t i = 0; i < Results.size(); i++)
+    {
+        const Result &R = Results[i];
+        Out << "    {\"shader\": \"" << ShaderName(R.Cfg) << "\", \"mode\": \"" << R.Cfg.Mode() << "\""
+            << ", \"stride\": " << R.Cfg.Stride << ", \"thresholds\": [";
+        for (size_t T = 0; T < R.Cfg.Thresholds.size(); T++)
+            Out << (T > 0 ? ", " : "") << R.Cfg.Thresholds[T];
+        Out << "]"
+            << ", \"frames\": " << R.FrameMs.size() << ", \"mean_ms\": " << R.Mean << ", \"p50_ms\": " << R.P50
+            << ", \"p95_ms\": " << R.P95 << ", \"p99_ms\": " << R.P99 << ", \"speedup\": " << R.Speedup
+            << ", \"gpu_mean_ms\": {";
+        for (size_t P = 0; P < R.PassNames.size() && P < R.PassMean.size(); P++)
+            Out << (P > 0 ? ", " : "") << "\"" << R.PassNames[P] << "\": " << R.PassMean[P];
+        Out << "}";
+        if (R.bHasQuality)
+        {
+            Out << ", \"quality\": {\"psnr\": " << R.Quality.Psnr << ", \"ssim\": " << R.Quality.Ssim;
+            for (int Ring = 0; Ring < R.Quality.NumRings; Ring++)
+                Out << ", \"" << ImageQuality::RingName(Ring, R.Quality.NumRings)
+                    << "\": {\"psnr\": " << R.Quality.RingPsnr[Ring] << ", \"ssim\": " << R.Quality.RingSsim[Ring]
+                    << ", \"coverage\": " << R.Quality.RingCoverage[Ring] << "}";
+            Out << "}";
+        }
+        Out << "}" << (i + 1 < Results.size() ? "," : "") << std::endl;
+    }
+    Out << "  ]" << std::endl << "}" << std::endl;
+    return true;
+}
+
+bool WriteResults(const std::string &OutputPrefix, const std::vector<Result> &Results)
+{
+    const std::string FramesPath = OutputPrefix + "_frames.csv";
+    const std::string SummaryPath = OutputPrefix + "_summary.csv";
+    const std::string JSONPath = OutputPrefix + ".json";
+    if (!WriteFramesCSV(FramesPath, Results) || !WriteSummaryCSV(SummaryPath, Results) ||
+        !WriteSummaryJSON(JSONPath, Results))
+    {
+        std::cerr << "unable to write benchmark results to \"" << OutputPrefix << "*\"" << std::endl;
+        return false;
+    }
+    std::cout << "Wrote benchmark results to \"" << FramesPath << "\", \"" << SummaryPath << "\" and \"" << JSONPath
+              << "\"" << std::endl;
+    return true;
+}
+
+} // namespace Benchmark
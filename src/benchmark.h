@@ -0,0 +1,68 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include "image_quality.h"
+#include "utils.h"
+#include <string>
+#include <vector>
+
+namespace Benchmark
+{
+
+struct Config
+{
+    std::string Shader; // path to the expensive (main) shader
+    bool bFoveated = false;
+    FovStrategy Strategy = FovStrategy::Checkerboard;
+    ReconstructionMode Reconstruction = ReconstructionMode::Spatial; // unused by the multires strategy
+    int Stride = 0; // unused by the multires strategy
+    std::vector<float> Thresholds; // radii of the foveation levels
+
+    std::string Mode() const;
+};
+
+struct Result
+{
+    Config Cfg;
+    std::vector<double> FrameMs; // per-frame wall time (ms) of the measured frames
+
+    // per-pass GPU time (ms) of the measured frames, indexed as PassMs[pass][frame]
+    std::vector<std::string> PassNames;
+    std::vector<std::vector<double>> PassMs;
+
+    // aggregate stats (filled by Summarize)
+    double Mean = 0.0, P50 = 0.0, P95 = 0.0, P99 = 0.0;
+    std::vector<double> PassMean;
+    double Speedup = 1.0; // relative to the non-foveated run of the same shader
+
+    // last frame against the last frame of the full quality run (bench_quality)
+    bool bHasQuality = false;
+    ImageQuality::Score Quality;
+
+    void Summarize();
+    double GpuMs() const; // mean GPU time of all passes (wall time without timer queries)
+};
+
+std::string ThresholdsName(const std::vector<float> &Thresholds); // ex. "0.1:0.25:0.4"
+
+// every configuration to run for a single shader (non-foveated baseline first)
+std::vector<Config> BuildSweep(const BenchmarkParamsStruct &P, const std::string &Shader);
+
+// fills in the Speedup of every foveated result w.r.t. its shader's baseline
+void ComputeSpeedups(std::vector<Result> &Results);
+
+// per shader & thresholds: the full quality baseline next to the best run of each strategy
+void PrintComparison(const std::vector<Result> &Results);
+
+// per shader: every run by cost with its quality, marking the ones no other run beats in both
+void PrintPareto(const std::vector<Result> &Results);
+
+// false if any foveated run scored below bench_min_ssim
+bool CheckQuality(const BenchmarkParamsStruct &P, const std::vector<Result> &Results);
+
+// per-frame timings as <prefix>_frames.csv, aggregates as <prefix>_summary.csv and <prefix>.json
+bool WriteResults(const std::string &OutputPrefix, const std::vector<Result> &Results);
+
+} // namespace Benchmark
+
+#endif
@@ -0,0 +1,307 @@
+#include "cpu_backend.h"
+#include "benchmark.h"
+#include "image_quality.h"
+#include "input_trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+namespace CpuBackend
+{
+
+using Colour = std::array<float, 4>;
+
+static float Cos01(const float a)
+{
+    return 0.5f + 0.5f * std::cos(a);
+}
+
+// shaders/main/example.glsl
+static Colour Example(const Inputs &, float, float)
+{
+    return {1.f, 0.5f, 0.2f, 1.f};
+}
+
+// ShaderToy's default shader
+static Colour Gradient(const Inputs &In, const float FragX, const float FragY)
+{
+    const float u = FragX / In.iResolution[0], v = FragY / In.iResolution[1];
+    return {Cos01(In.iTime + u), Cos01(In.iTime + v + 2.f), Cos01(In.iTime + u + 4.f), 1.f};
+}
+
+// slowly zooming into the seahorse valley, the iteration count varies a lot across the frame
+static Colour Mandelbrot(const Inputs &In, const float FragX, const float FragY)
+{
+    constexpr int MaxIterations = 256;
+    const float Zoom = 1.25f / (1.f + 0.25f * In.iTime);
+    const float cx = -0.745f + (2.f * FragX - In.iResolution[0]) / In.iResolution[1] * Zoom;
+    const float cy = 0.186f + (2.f * FragY - In.iResolution[1]) / In.iResolution[1] * Zoom;
+    float zx = 0.f, zy = 0.f, r2 = 0.f;
+    int n = 0;
+    for (; n < MaxIterations && r2 <= 256.f; n++)
+    {
+        const float x = zx * zx - zy * zy + cx;
+        zy = 2.f * zx * zy + cy;
+        zx = x;
+        r2 = zx * zx + zy * zy;
+    }
+    if (n == MaxIterations)
+        return {0.f, 0.f, 0.f, 1.f};
+    const float t = n - std::log2(std::log2(r2)) + 4.f; // smooth iteration count
+    return {Cos01(3.f + 0.15f * t), Cos01(3.6f + 0.15f * t), Cos01(4.f + 0.15f * t), 1.f};
+}
+
+static const struct
+{
+    const char *Name;
+    Shader S;
+} Shaders[] = {
+    {"example", Example},
+    {"gradient", Gradient},
+    {"mandelbrot", Mandelbrot},
+};
+
+Shader FindShader(const std::string &Name)
+{
+    for (const auto &Entry : Shaders)
+    {
+        if (Name == Entry.Name)
+            return Entry.S;
+    }
+    return nullptr;
+}
+
+std::vector<std::string> ShaderNames()
+{
+    std::vector<std::string> Names;
+    for (const auto &Entry : Shaders)
+        Names.push_back(Entry.Name);
+    return Names;
+}
+
+static void ShadeRect(const Shader S, const Inputs &In, FovReference::Image &Out, const int X0, const int Y0,
+                      const int X1, const int Y1)
+{
+    for (int y = Y0; y < Y1; y++)
+    {
+        uint8_t *Px = Out.At(X0, y);
+        for (int x = X0; x < X1; x++, Px += 4)
+        {
+            const Colour C = S(In, x + 0.5f, y + 0.5f);
+            // like the GL's conversion to the 8 bit target
+            for (int c = 0; c < 4; c++)
+                Px[c] = static_cast<uint8_t>(std::lround(std::clamp(C[c], 0.f, 1.f) * 255.f));
+        }
+    }
+}
+
+static void ClearRect(FovReference::Image &Out, const int X0, const int Y0, const int X1, const int Y1)
+{
+    static const uint8_t Clear[4] = {0, 0, 0, 255};
+    for (int y = Y0; y < Y1; y++)
+    {
+        uint8_t *Px = Out.At(X0, y);
+        for (int x = X0; x < X1; x++, Px += 4)
+            std::memcpy(Px, Clear, 4);
+    }
+}
+
+void Shade(WorkPool &Pool, const Shader S, const Inputs &In, const FovReference::Pattern *P,
+           FovReference::Image &Out)
+{
+    // tiles of whole blocks (about 32 pixels wide), so the drop pattern is decided once per quad, not per pixel
+    const int Stride = (P != nullptr) ? P->Stride : 16;
+    const int Quad = Stride / 2;
+    const int TileSize = Stride * std::max(32 / Stride, 1);
+    const int TilesX = (Out.W + TileSize - 1) / TileSize, TilesY = (Out.H + TileSize - 1) / TileSize;
+    Pool.Run(TilesX * TilesY, [&](const int Tile) {
+        const int X0 = (Tile % TilesX) * TileSize, Y0 = (Tile / TilesX) * TileSize;
+        const int X1 = std::min(X0 + TileSize, Out.W), Y1 = std::min(Y0 + TileSize, Out.H);
+        if (P == nullptr)
+        {
+            ShadeRect(S, In, Out, X0, Y0, X1, Y1);
+            return;
+        }
+        for (int by = Y0 / Stride; by * Stride < Y1; by++)
+        {
+            for (int bx = X0 / Stride; bx * Stride < X1; bx++)
+            {
+                const int Keep = FovReference::BlockKeep(*P, Out.H, bx, by, 0.f);
+                for (int qy = 0; qy < 2; qy++)
+                {
+                    for (int qx = 0; qx < 2; qx++)
+                    {
+                        const int QX0 = bx * Stride + qx * Quad, QY0 = by * Stride + qy * Quad;
+                        const int QX1 = std::min(qx ? (bx + 1) * Stride : QX0 + Quad, X1);
+                        const int QY1 = std::min(qy ? (by + 1) * Stride : QY0 + Quad, Y1);
+                        if (FovReference::QuadKept(Keep, bx, by, qx, qy))
+                            ShadeRect(S, In, Out, QX0, QY0, QX1, QY1);
+                        else
+                            ClearRect(Out, QX0, QY0, QX1, QY1);
+                    }
+                }
+            }
+        }
+    });
+}
+
+void Reconstruct(WorkPool &Pool, const FovReference::Pattern &P, const FovReference::Image &In,
+                 FovReference::Image &Out)
+{
+    Out.Resize(In.W, In.H);
+    const int NumBands = (In.H + P.Stride - 1) / P.Stride; // a row of blocks each
+    Pool.Run(NumBands, [&](const int Band) {
+        FovReference::ReconstructRows(P, In, Out, Band * P.Stride, std::min((Band + 1) * P.Stride, In.H));
+    });
+}
+
+// the FrameState a view of W x H would get (Renderer::UpdateFrameState)
+static FovReference::Pattern MakePattern(const FRShaderParams &FR, const int W, const int H)
+{
+    FovReference::Pattern P;
+    P.Stride = FR.stride;
+    P.NumLevels = static_cast<int>(FR.keep.size());
+    P.AspectW = 1.f / (FR.aspect * FR.aspect);
+    const float diag = 0.5f * (W + H);
+    for (int i = 0; i < FovReference::MaxLevels; i++)
+    {
+        const size_t Level = std::min<size_t>(i, FR.keep.size() - 1);
+        P.Radius[i] = FR.radii.empty() ? 0.f : FR.radii[std::min(Level, FR.radii.size() - 1)] * diag;
+        P.Keep[i] = KeepSixteenths(FR.keep[Level]);
+    }
+    return P;
+}
+
+static double Ms(const std::chrono::steady_clock::time_point &Start, const std::chrono::steady_clock::time_point &End)
+{
+    return std::chrono::duration<double, std::milli>(End - Start).count();
+}
+
+bool RunBenchmark(const ParamsStruct &Params)
+{
+    const BenchmarkParamsStruct &B = Params.BenchParams;
+    const int W = B.width, H = B.height;
+
+    // fixed foveal center for reproducible runs, or the gaze path of a recorded session (one frame per frame)
+    std::vector<InputTrace::Frame> Trace;
+    InputTrace::Header TraceHeader;
+    if (!B.trace.empty() && !InputTrace::Load(B.trace, TraceHeader, Trace))
+        return false;
+    const int NumMeasured = Trace.empty() ? B.num_frames : static_cast<int>(Trace.size());
+    if (NumViews(Params) > 1)
+        std::cout << "WARNING: the CPU backend renders a single view" << std::endl;
+
+    WorkPool Pool(Params.CpuParams.num_threads);
+    std::cout << "Benchmarking " << Params.CpuParams.shaders.size() << " CPU shaders at (" << W << " x " << H
+              << ") on " << Pool.NumThreads() << " threads for " << NumMeasured << " frames each" << std::endl;
+
+    std::vector<Benchmark::Result> Results;
+    FovReference::Image Dropped, Reconstructed;
+    FovReference::Image Truth; // last frame of the full quality run of TruthShader
+    std::string TruthShader = "";
+    for (const std::string &Name : Params.CpuParams.shaders)
+    {
+        const Shader S = FindShader(Name);
+        if (S == nullptr)
+        {
+            std::cerr << "skipping \"" << Name << "\", there's no CPU port of it (";
+            for (const std::string &Port : ShaderNames())
+                std::cerr << (Port == ShaderNames().front() ? "" : ", ") << Port;
+            std::cerr << ")" << std::endl;
+            continue;
+        }
+        for (const Benchmark::Config &C : Benchmark::BuildSweep(B, Name))
+        {
+            FRShaderParams FR = Params.FRParams;
+            if (C.bFoveated)
+            {
+                if (C.Strategy != FovStrategy::Checkerboard || C.Reconstruction != ReconstructionMode::Spatial)
+                {
+                    std::cerr << "skipping " << C.Mode() << ", the CPU backend only does spatial checkerboard"
+                              << std::endl;
+                    continue;
+                }
+                if (C.Stride > 0)
+                    FR.stride = C.Stride;
+                FR.radii = C.Thresholds;
+                if (!CheckFovProfile(FR))
+                {
+                    std::cerr << "skipping the radii " << Benchmark::ThresholdsName(C.Thresholds) << std::endl;
+                    continue;
+                }
+            }
+            FovReference::Pattern P = MakePattern(FR, W, H);
+            P.GazeX = 0.5f * W;
+            P.GazeY = 0.5f * H;
+
+            Benchmark::Result R;
+            R.Cfg = C;
+            R.PassNames = {"shade", "reconstruction"};
+            R.PassMs.resize(R.PassNames.size());
+            Dropped.Resize(W, H);
+            for (int Frame = 0; Frame < B.num_warmup_frames + NumMeasured; Frame++)
+            {
+                // fixed simulated time step so every configuration renders the same frames
+                Inputs In;
+                In.iResolution[0] = static_cast<float>(W);
+                In.iResolution[1] = static_cast<float>(H);
+                In.iTime = Frame * B.time_step;
+                In.iFrame = Frame;
+                if (!Trace.empty())
+                {
+                    // the warmup runs through the start of the trace as well
+                    const int Idx = (Frame < B.num_warmup_frames) ? Frame : Frame - B.num_warmup_frames;
+                    const InputTrace::Frame &T = Trace[Idx % Trace.size()];
+                    P.GazeX = T.GazeX * W;
+                    P.GazeY = T.GazeY * H;
+                }
+
+                const auto Start = std::chrono::steady_clock::now();
+                Shade(Pool, S, In, C.bFoveated ? &P : nullptr, Dropped);
+                const auto Shaded = std::chrono::steady_clock::now();
+                if (C.bFoveated)
+                    Reconstruct(Pool, P, Dropped, Reconstructed);
+                const auto End = std::chrono::steady_clock::now();
+                if (Frame >= B.num_warmup_frames)
+                {
+                    R.FrameMs.push_back(Ms(Start, End));
+                    R.PassMs[0].push_back(Ms(Start, Shaded));
+                    R.PassMs[1].push_back(Ms(Shaded, End));
+                }
+            }
+
+            // every run ends on the same simulated time, so the last frames are directly comparable
+            if (B.bQuality)
+            {
+                const FovReference::Image &Last = C.bFoveated ? Reconstructed : Dropped;
+                if (!C.bFoveated)
+                {
+                    Truth = Last;
+                    TruthShader = C.Shader;
+                }
+                R.bHasQuality = (TruthShader == C.Shader);
+                if (R.bHasQuality)
+                    R.Quality = ImageQuality::Compare(Truth, Last, P);
+            }
+
+            R.Summarize();
+            std::cout << "[" << C.Mode() << " stride=" << C.Stride
+                      << " thresh=" << Benchmark::ThresholdsName(C.Thresholds) << "] mean: " << R.Mean
+                      << "ms p50: " << R.P50 << "ms p95: " << R.P95 << "ms p99: " << R.P99 << "ms";
+            for (size_t Pass = 0; Pass < R.PassNames.size(); Pass++)
+                std::cout << " " << R.PassNames[Pass] << ": " << R.PassMean[Pass] << "ms";
+            std::cout << std::endl;
+            Results.push_back(R);
+        }
+    }
+
+    Benchmark::ComputeSpeedups(Results);
+    Benchmark::PrintComparison(Results);
+    Benchmark::PrintPareto(Results);
+    const bool bWritten = Benchmark::WriteResults(B.output_prefix, Results);
+    return Benchmark::CheckQuality(B, Results) && bWritten;
+}
+
+} // namespace CpuBackend
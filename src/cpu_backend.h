@@ -0,0 +1,45 @@
+#ifndef CPU_BACKEND_H
+#define CPU_BACKEND_H
+
+#include "fov_reference.h"
+#include "utils.h"
+#include "work_pool.h"
+#include <array>
+#include <string>
+#include <vector>
+
+// Foveated rendering without a GL context. The main shaders are C++ callables (ports of expensive_main()), frames
+// are split into stride aligned tiles shaded on a work stealing pool, with the drop pattern applied before shading
+// so dropped pixels cost nothing, and the spatial reconstruction (FovReference) runs as a second parallel pass.
+// Runs the benchmark sweep on CPU-only machines
+namespace CpuBackend
+{
+
+// the ShaderToy inputs of the main shaders
+struct Inputs
+{
+    float iResolution[2] = {0.f, 0.f};
+    float iTime = 0.f;
+    int iFrame = 0;
+    float iMouse[2] = {0.f, 0.f};
+};
+
+// fragColor of the pixel at FragX, FragY (gl_FragCoord, pixel centers)
+using Shader = std::array<float, 4> (*)(const Inputs &In, float FragX, float FragY);
+
+Shader FindShader(const std::string &Name); // null if there's no such port
+std::vector<std::string> ShaderNames();
+
+// shades every pixel P keeps (everything if P is null) of Out (which must be sized) & clears the others like the
+// drop pass does
+void Shade(WorkPool &Pool, Shader S, const Inputs &In, const FovReference::Pattern *P, FovReference::Image &Out);
+// FovReference::Reconstruct, in bands of block rows on Pool
+void Reconstruct(WorkPool &Pool, const FovReference::Pattern &P, const FovReference::Image &In,
+                 FovReference::Image &Out);
+
+// Renderer::RunBenchmark's sweep over the CPU shaders (spatial checkerboard runs only)
+bool RunBenchmark(const ParamsStruct &Params);
+
+} // namespace CpuBackend
+
+#endif
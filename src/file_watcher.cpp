@@ -0,0 +1,139 @@
+#include "file_watcher.h"
+#include <algorithm>
+#include <iostream>
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// how often modification times are compared without inotify
+static constexpr std::chrono::milliseconds PollInterval(500);
+
+bool FileWatcher::Init()
+{
+#ifdef __linux__
+    Fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (Fd >= 0)
+        return true;
+    std::cerr << "inotify unavailable (" << std::strerror(errno) << "), polling file times instead" << std::endl;
+#endif
+    LastScan = std::chrono::steady_clock::now();
+    return true;
+}
+
+void FileWatcher::Destroy()
+{
+#ifdef __linux__
+    if (Fd >= 0)
+        close(Fd); // drops every watch with it
+#endif
+    Fd = -1;
+    Watches.clear();
+    Times.clear();
+}
+
+void FileWatcher::Watch(const std::string &Path)
+{
+    std::error_code Err;
+    const std::filesystem::path Full = std::filesystem::weakly_canonical(Path, Err);
+    if (Err)
+    {
+        std::cerr << "can't watch \"" << Path << "\": " << Err.message() << std::endl;
+        return;
+    }
+    const bool bDir = std::filesystem::is_directory(Full, Err);
+    const std::string Dir = bDir ? Full.string() : Full.parent_path().string();
+
+    int Id = static_cast<int>(Watches.size());
+#ifdef __linux__
+    if (Fd >= 0)
+    {
+        // editors either rewrite the file in place or rename a temporary over it
+        Id = inotify_add_watch(Fd, Dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (Id < 0)
+        {
+            std::cerr << "can't watch \"" << Dir << "\": " << std::strerror(errno) << std::endl;
+            return;
+        }
+    }
+#endif
+    // the same directory maps to the same watch, so merge what is watched in it
+    auto It = std::find_if(Watches.begin(), Watches.end(), [&](const auto &W) { return W.second.Dir == Dir; });
+    Entry &E = (It != Watches.end()) ? It->second : Watches[Id];
+    const bool bNew = E.Dir.empty();
+    E.Dir = Dir;
+    if (bDir)
+        E.Files.clear();
+    else if ((bNew || !E.Files.empty()) &&
+             std::find(E.Files.begin(), E.Files.end(), Full.filename().string()) == E.Files.end())
+        E.Files.push_back(Full.filename().string());
+
+    if (Fd < 0)
+    {
+        // remember the current times, only later changes are reported
+        for (const auto &File : std::filesystem::directory_iterator(Dir, Err))
+            Times[File.path().string()] = File.last_write_time(Err);
+    }
+}
+
+bool FileWatcher::IsWatched(const Entry &E, const std::string &File) const
+{
+    return E.Files.empty() || std::find(E.Files.begin(), E.Files.end(), File) != E.Files.end();
+}
+
+std::vector<std::string> FileWatcher::Poll()
+{
+    if (Fd < 0)
+        return PollTimes();
+
+    std::vector<std::string> Changed;
+#ifdef __linux__
+    // drain every pending event, a single save often shows up as several
+    alignas(inotify_event) char Buffer[4096];
+    ssize_t Len;
+    while ((Len = read(Fd, Buffer, sizeof(Buffer))) > 0)
+    {
+        for (char *Ptr = Buffer; Ptr < Buffer + Len;)
+        {
+            const inotify_event *Event = reinterpret_cast<const inotify_event *>(Ptr);
+            Ptr += sizeof(inotify_event) + Event->len;
+            auto It = Watches.find(Event->wd);
+            if (Event->len == 0 || It == Watches.end() || !IsWatched(It->second, Event->name))
+                continue;
+            const std::string Path = It->second.Dir + "/" + Event->name;
+            if (std::find(Changed.begin(), Changed.end(), Path) == Changed.end())
+                Changed.push_back(Path);
+        }
+    }
+#endif
+    return Changed;
+}
+
+std::vector<std::string> FileWatcher::PollTimes()
+{
+    std::vector<std::string> Changed;
+    const auto Now = std::chrono::steady_clock::now();
+    if (Now - LastScan < PollInterval)
+        return Changed;
+    LastScan = Now;
+
+    std::error_code Err;
+    for (const auto &It : Watches)
+    {
+        for (const auto &File : std::filesystem::directory_iterator(It.second.Dir, Err))
+        {
+            if (!IsWatched(It.second, File.path().filename().string()))
+                continue;
+            const auto Time = File.last_write_time(Err);
+            auto Last = Times.find(File.path().string());
+            if (Last != Times.end() && Last->second == Time)
+                continue;
+            Times[File.path().string()] = Time;
+            Changed.push_back(File.path().string());
+        }
+    }
+    return Changed;
+}
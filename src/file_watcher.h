@@ -0,0 +1,36 @@
+#ifndef FILE_WATCHER_H
+#define FILE_WATCHER_H
+
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+// Reports files that changed on disk (shaders & params) so they can be reloaded while running.
+// Uses inotify on Linux, elsewhere it falls back to comparing modification times every PollInterval.
+class FileWatcher
+{
+  public:
+    bool Init();
+    void Destroy();
+
+    void Watch(const std::string &Path); // a directory, or a single file (watched through its directory)
+    std::vector<std::string> Poll();     // changed files since the last Poll (never blocks)
+
+  private:
+    struct Entry
+    {
+        std::string Dir;
+        std::vector<std::string> Files; // only these files of Dir, every file if empty
+    };
+    bool IsWatched(const Entry &E, const std::string &File) const;
+    std::vector<std::string> PollTimes();
+
+    int Fd = -1;                   // inotify instance, -1 when polling modification times
+    std::map<int, Entry> Watches;  // by inotify watch descriptor (or just an index when polling)
+    std::map<std::string, std::filesystem::file_time_type> Times; // last seen modification times
+    std::chrono::steady_clock::time_point LastScan;
+};
+
+#endif
@@ -0,0 +1,124 @@
+#include "fov_controller.h"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+// each radius step shrinks the radii by this much
+static constexpr float RadiusStep = 0.85f;
+// timings above this share of the budget take two steps at once (ex. after switching to a heavier shader)
+static constexpr double FarOver = 1.5;
+// longest hold (in decisions) before giving a step back
+static constexpr int MaxHold = 16;
+// keep ratios in sixteenths, each step outside the fovea moves one to the right
+static constexpr int KeepLadder[] = {16, 12, 8, 4, 2, 1};
+static constexpr int NumKeeps = sizeof(KeepLadder) / sizeof(KeepLadder[0]);
+
+int FovController::NumRadiusSteps(const AdaptiveParamsStruct &P)
+{
+    if (P.min_radius >= 1.f)
+        return 0;
+    return static_cast<int>(std::log(std::max(P.min_radius, 0.01f)) / std::log(RadiusStep));
+}
+
+int FovController::NumStrideSteps(const AdaptiveParamsStruct &P, const int BaseStride)
+{
+    int Steps = 0;
+    while ((BaseStride << (Steps + 1)) <= std::min(P.max_stride, 256))
+        Steps++;
+    return Steps;
+}
+
+FovController::Steps FovController::Split(const AdaptiveParamsStruct &P, const int BaseStride, const int Taken)
+{
+    Steps S;
+    const int NumRadius = NumRadiusSteps(P);
+    const int NumKeep = std::max(P.max_keep_steps, 0);
+    S.Radius = std::clamp(Taken, 0, NumRadius);
+    S.Keep = std::clamp(Taken - NumRadius, 0, NumKeep);
+    S.Stride = std::clamp(Taken - NumRadius - NumKeep, 0, NumStrideSteps(P, BaseStride));
+    return S;
+}
+
+bool FovController::Add(const uint64_t FrameId, const double Ms, const uint64_t NextFrame,
+                        const AdaptiveParamsStruct &P, const int BaseStride, const std::function<bool(int)> &IsBuilt)
+{
+    if (FrameId < ChangedAt)
+        return false; // still rendered with the previous step
+    SumMs += Ms;
+    NumMs++;
+    if (NumMs < std::max(P.num_frames, 1))
+        return false;
+    LastMs = SumMs / NumMs;
+    SumMs = 0.0;
+    NumMs = 0;
+
+    // the knobs' ranges change with the params (ex. the stride keys)
+    const int NumSteps = NumRadiusSteps(P) + std::max(P.max_keep_steps, 0) + NumStrideSteps(P, BaseStride);
+    const int Old = Step;
+    Step = std::min(Step, NumSteps);
+    const bool bOver = LastMs > P.target_ms;
+    if (bJustRelaxed)
+    {
+        // a step given back that didn't fit makes the next attempt wait longer, one that did less so
+        Hold = bOver ? std::min(Hold * 2, MaxHold) : std::max(Hold / 2, 1);
+        bJustRelaxed = false;
+    }
+    int Next = Step;
+    if (bOver)
+    {
+        Next = std::min(Step + (LastMs > FarOver * P.target_ms ? 2 : 1), NumSteps);
+        NumCalm = 0;
+    }
+    else if (LastMs < (1.0 - P.hysteresis) * P.target_ms)
+    {
+        if (++NumCalm >= Hold && Step > 0)
+            Next = Step - 1;
+    }
+    else
+        NumCalm = 0; // within the band, right where it should be
+
+    // the next step either way is built ahead, a step whose programs aren't built yet waits for the next decision
+    // (instead of stalling a frame on the compile)
+    while (Next != Step && !IsBuilt(Next - Step))
+        Next += (Next > Step) ? -1 : 1;
+    if (Next < Step)
+    {
+        NumCalm = 0;
+        bJustRelaxed = true;
+    }
+    Step = Next;
+    if (Step == Old)
+        return false;
+    ChangedAt = NextFrame;
+    return true;
+}
+
+void FovController::Apply(const FRShaderParams &Base, const AdaptiveParamsStruct &P, FRShaderParams &Out,
+                          const int Offset) const
+{
+    Out = Base;
+    if (Step + Offset <= 0)
+        return;
+    const Steps S = Split(P, Base.stride, Step + Offset);
+    const float Scale = std::pow(RadiusStep, static_cast<float>(S.Radius));
+    for (float &Radius : Out.radii)
+        Radius *= Scale;
+    // the fovea stays at full quality, the levels keep their order since each one moves as many notches
+    for (size_t i = 1; i < Out.keep.size(); i++)
+    {
+        const int *Keep = std::find(KeepLadder, KeepLadder + NumKeeps, KeepSixteenths(Out.keep[i]));
+        const int Idx = std::min(static_cast<int>(Keep - KeepLadder) + S.Keep, NumKeeps - 1);
+        Out.keep[i] = KeepLadder[Idx] / 16.f;
+    }
+    Out.stride = Base.stride << S.Stride;
+}
+
+std::string FovController::Stats(const AdaptiveParamsStruct &P, const int BaseStride) const
+{
+    const Steps S = Split(P, BaseStride, Step);
+    std::stringstream ss;
+    ss << "ADAPT: " << LastMs << "/" << P.target_ms << "ms step " << Step << " (radii x"
+       << std::pow(RadiusStep, static_cast<float>(S.Radius)) << " keep -" << S.Keep << " stride "
+       << (BaseStride << S.Stride) << ")";
+    return ss.str();
+}
@@ -0,0 +1,45 @@
+#ifndef FOV_CONTROLLER_H
+#define FOV_CONTROLLER_H
+
+#include "utils.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// Closed loop between the GPU frame time and the foveation profile, to hold a frame time budget with as little
+// quality loss as possible. Quality is traded in steps, least visible first: the radii shrink towards the gaze,
+// then every level outside the fovea keeps fewer pixels, then the stride doubles. Steps are given back in the
+// reverse order once there's headroom. The band between the two thresholds, and a hold time that grows every
+// time a step given back had to be taken again, keep it from oscillating around the budget.
+class FovController
+{
+  public:
+    // GPU time (ms) of a finished frame, which arrive a few frames late. NextFrame is the next frame to be
+    // rendered, the first one a change applies to. IsBuilt(Offset) tells whether the programs of the profile
+    // Offset steps away are built, a step is only taken once they are. True if the profile changed
+    bool Add(uint64_t FrameId, double Ms, uint64_t NextFrame, const AdaptiveParamsStruct &P, int BaseStride,
+             const std::function<bool(int)> &IsBuilt);
+    // the configured profile with the current steps taken (and Offset more, ex. to build the next one ahead)
+    void Apply(const FRShaderParams &Base, const AdaptiveParamsStruct &P, FRShaderParams &Out, int Offset = 0) const;
+    std::string Stats(const AdaptiveParamsStruct &P, int BaseStride) const;
+
+  private:
+    struct Steps
+    {
+        int Radius = 0, Keep = 0, Stride = 0;
+    };
+    static int NumRadiusSteps(const AdaptiveParamsStruct &P);
+    static int NumStrideSteps(const AdaptiveParamsStruct &P, int BaseStride);
+    static Steps Split(const AdaptiveParamsStruct &P, int BaseStride, int Taken); // Taken steps per knob
+
+    int Step = 0;              // quality steps taken, 0 is the configured profile
+    uint64_t ChangedAt = 0;    // first frame rendered with the current step
+    double SumMs = 0.0;        // timings of the frames since ChangedAt (or the last decision)
+    int NumMs = 0;
+    double LastMs = 0.0;       // mean of the last decision
+    int NumCalm = 0;           // decisions in a row with headroom
+    int Hold = 1;              // decisions with headroom needed before giving a step back
+    bool bJustRelaxed = false; // the last change gave a step back
+};
+
+#endif
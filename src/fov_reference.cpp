@@ -0,0 +1,602 @@
+#include "fov_reference.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FOV_AVX2 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define FOV_NEON 1
+#endif
+
+namespace FovReference
+{
+
+void Image::Resize(const int Width, const int Height)
+{
+    W = Width;
+    H = Height;
+    Pixels.resize(4 * static_cast<size_t>(W) * H);
+}
+
+uint8_t *Image::At(const int x, const int y)
+{
+    return const_cast<uint8_t *>(static_cast<const Image *>(this)->At(x, y));
+}
+
+const uint8_t *Image::At(const int x, const int y) const
+{
+    if (x < 0 || y < 0 || x >= W || y >= H)
+        return nullptr;
+    return Pixels.data() + 4 * (static_cast<size_t>(y) * W + x);
+}
+
+static float glslMod(const float a, const float b)
+{
+    return a - b * std::floor(a / b);
+}
+
+// fov_common.glsl, blocks are indices into the (shifted) grid of blocks
+static int LevelKeep(const Pattern &P, const int bx, const int by, const int Center[2])
+{
+    const float dx = static_cast<float>(bx - Center[0]) * P.Stride, dy = static_cast<float>(by - Center[1]) * P.Stride;
+    const float d2 = dx * dx * P.AspectW + dy * dy;
+    // FrameState repeats the last radius, counting every one of them only overshoots past it
+    int Level = 0;
+    for (int i = 0; i < MaxLevels; i++)
+        Level += (d2 > P.Radius[i] * P.Radius[i]) ? 1 : 0;
+    return P.Keep[std::min(Level, P.NumLevels - 1)];
+}
+
+bool QuadKept(const int Keep, const int bx, const int by, const int qx, const int qy)
+{
+    if (qx == 0 && qy == 0) // top left
+        return Keep >= 4 || ((by & 1) == 0 && (Keep == 2 || (bx & 1) == 0));
+    else if (qx == 0 && qy == 1) // top right
+        return Keep >= 16;
+    else if (qx == 1 && qy == 0) // bottom left
+        return Keep >= 12;
+    else // bottom right
+        return Keep >= 8;
+}
+
+bool Kept(const Pattern &P, const int H, const int x, const int y)
+{
+    // fov_render_frag.glsl, coordinates are the top left corner of the pixel (in the shifted pattern)
+    const float Stride = static_cast<float>(P.Stride);
+    const int Quad = P.Stride / 2;
+    const float cx = static_cast<float>(x + P.Phase[0]), cy = static_cast<float>(y + P.Phase[1]);
+    const float xmod = glslMod(cx, Stride), ymod = glslMod(cy, Stride);
+
+    const float GazeX = P.GazeX, GazeY = -P.GazeY + H;
+    const int Center[2] = {static_cast<int>(std::floor((GazeX + P.Phase[0]) / Stride)),
+                           static_cast<int>(std::floor((GazeY + P.Phase[1]) / Stride))};
+    const int bx = static_cast<int>(std::floor(cx / Stride)), by = static_cast<int>(std::floor(cy / Stride));
+    return QuadKept(LevelKeep(P, bx, by, Center), bx, by, xmod >= Quad, ymod >= Quad);
+}
+
+void Drop(const Pattern &P, Image &Img)
+{
+    static const uint8_t Clear[4] = {0, 0, 0, 255};
+    for (int y = 0; y < Img.H; y++)
+    {
+        for (int x = 0; x < Img.W; x++)
+        {
+            if (!Kept(P, Img.H, x, y))
+                std::memcpy(Img.At(x, y), Clear, 4);
+        }
+    }
+}
+
+/// NOTE: the reference backend mirrors reconstruction_shader.glsl line by line, keep them in sync
+
+using Colour = std::array<float, 4>;
+
+static Colour Fetch(const Image &In, const int x, const int y)
+{
+    // texelFetch, zero outside of the texture
+    Colour C = {0.f, 0.f, 0.f, 0.f};
+    if (const uint8_t *Px = In.At(x, y))
+    {
+        for (int c = 0; c < 4; c++)
+            C[c] = Px[c];
+    }
+    return C;
+}
+
+static void Accumulate(Colour &Acc, const float Weight, const Colour &C)
+{
+    for (int c = 0; c < 4; c++)
+        Acc[c] += Weight * C[c];
+}
+
+static bool IsFilled(const Colour &C)
+{
+    return C[0] != 0.f || C[1] != 0.f || C[2] != 0.f;
+}
+
+static bool AnchorKept(const Pattern &P, const Image &In, const int Center[2], const int bx, const int by)
+{
+    // whether the top left quad of a block was shaded (blocks outside of the frame are never sampled)
+    const int Anchor = P.Stride / 2 / 2;
+    const int ax = bx * P.Stride + Anchor, ay = by * P.Stride + Anchor;
+    if (ax < 0 || ay < 0 || ax >= In.W || ay >= In.H)
+        return true;
+    return QuadKept(LevelKeep(P, bx, by, Center), bx, by, 0, 0);
+}
+
+static Colour Lattice(const Pattern &P, const Image &In, const int Center[2], const int x, const int y)
+{
+    // bilinear infill between the top left quads of a lattice of shaded blocks (the sparse levels)
+    const int S = P.Stride, Anchor = S / 2 / 2;
+    const int Pixel[2] = {x, y}, Max[2] = {In.W - 1, In.H - 1};
+    int Cells[2] = {1, 2}; // 1/8 shades every block of the even rows
+    int Block0[2];
+    const auto Place = [&]() {
+        for (int c = 0; c < 2; c++)
+            Block0[c] = ((Pixel[c] - Anchor + Cells[c] * S) / (Cells[c] * S) - 1) * Cells[c];
+    };
+    Place();
+    if (!AnchorKept(P, In, Center, Block0[0], Block0[1]) ||
+        !AnchorKept(P, In, Center, Block0[0] + Cells[0], Block0[1]) ||
+        !AnchorKept(P, In, Center, Block0[0], Block0[1] + Cells[1]) ||
+        !AnchorKept(P, In, Center, Block0[0] + Cells[0], Block0[1] + Cells[1]))
+    {
+        Cells[0] = Cells[1] = 2; // 1/16 shades every other block of them, which every level does
+        Place();
+    }
+    int P0[2], P1[2];
+    float Weight[2];
+    for (int c = 0; c < 2; c++)
+    {
+        P0[c] = Block0[c] * S + Anchor;
+        P1[c] = P0[c] + Cells[c] * S;
+        Weight[c] = static_cast<float>(Pixel[c] - P0[c]) / static_cast<float>(Cells[c] * S);
+        // only the inner anchor at the window border
+        if (P0[c] < 0)
+            Weight[c] = 1.f;
+        if (P1[c] > Max[c])
+            Weight[c] = 0.f;
+        P0[c] = std::clamp(P0[c], 0, Max[c]);
+        P1[c] = std::clamp(P1[c], 0, Max[c]);
+    }
+    const float wx = Weight[0], wy = Weight[1];
+    Colour C = {0.f, 0.f, 0.f, 0.f};
+    Accumulate(C, (1.f - wy) * (1.f - wx), Fetch(In, P0[0], P0[1])); // bottom left
+    Accumulate(C, (1.f - wy) * wx, Fetch(In, P1[0], P0[1]));         // bottom right
+    Accumulate(C, wy * (1.f - wx), Fetch(In, P0[0], P1[1]));         // top left
+    Accumulate(C, wy * wx, Fetch(In, P1[0], P1[1]));                 // top right
+    return C;
+}
+
+static bool NeedsLattice(const Pattern &P, const int Center[2], const int Keep, const int bx, const int by)
+{
+    // the regular infill samples the blocks to the right & above, which the sparse levels may not shade
+    if (P.Keep[P.NumLevels - 1] >= 4)
+        return false;
+    return Keep < 4 || std::min({LevelKeep(P, bx + 1, by, Center), LevelKeep(P, bx, by + 1, Center),
+                                 LevelKeep(P, bx + 1, by + 1, Center)}) < 4;
+}
+
+static void ReconstructPixel(const Pattern &P, const Image &In, const int Center[2], const int x, const int y,
+                             uint8_t *Out)
+{
+    const int stride = P.Stride;
+    const int quad = stride / 2;
+    const float xmod = static_cast<float>(x % stride), ymod = static_cast<float>(y % stride);
+    const int ix = static_cast<int>(xmod), iy = static_cast<int>(ymod);
+    const int bx = x / stride, by = y / stride;
+    const int Keep = LevelKeep(P, bx, by, Center);
+
+    float weight_x = 0.5f;
+    float weight_y = 0.5f;
+    Colour C = {0.f, 0.f, 0.f, 0.f};
+
+    if (QuadKept(Keep, bx, by, ix >= quad, iy >= quad))
+        C = Fetch(In, x, y);
+    else if (NeedsLattice(P, Center, Keep, bx, by))
+        C = Lattice(P, In, Center, x, y);
+    else if (xmod < quad && ymod >= quad && Keep >= 8) // top right
+    {
+        weight_x = xmod / quad;
+        weight_y = (ymod - quad) / quad;
+        Accumulate(C, weight_y, Fetch(In, x, y + stride - iy));           // top
+        Accumulate(C, 1.f - weight_y, Fetch(In, x, y - iy + quad - 1)); // bottom
+        const Colour Left = Fetch(In, x - ix - 1, y);
+        if (IsFilled(Left))
+        {
+            Accumulate(C, weight_x, Fetch(In, x + quad - ix, y)); // right
+            Accumulate(C, 1.f - weight_x, Left);                  // left
+            for (float &c : C)
+                c /= 2;
+        }
+    }
+    else if (xmod >= quad && ymod < quad && Keep >= 8) // bottom left
+    {
+        weight_x = (xmod - quad) / quad;
+        weight_y = ymod / quad;
+        Accumulate(C, 1.f - weight_x, Fetch(In, x - ix + quad - 1, y)); // left
+        Accumulate(C, weight_x, Fetch(In, x + stride - ix, y));         // right
+        const Colour Bottom = Fetch(In, x, y - iy - 1);
+        if (IsFilled(Bottom))
+        {
+            Accumulate(C, weight_y, Fetch(In, x, y + quad - iy)); // top
+            Accumulate(C, 1.f - weight_y, Bottom);                // bottom
+            for (float &c : C)
+                c /= 2;
+        }
+    }
+    else // only the top left is shaded
+    {
+        if (xmod < quad)
+        {
+            // vertical
+            weight_y = (ymod - quad) / quad;
+            Accumulate(C, weight_y, Fetch(In, x, y + stride - iy));
+            Accumulate(C, 1.f - weight_y, Fetch(In, x, y - iy + quad - 1));
+        }
+        else
+        {
+            weight_x = (xmod - quad) / quad;
+            if (ymod < quad)
+            {
+                // horizontal
+                Accumulate(C, weight_x, Fetch(In, x + stride - ix, y));
+                Accumulate(C, 1.f - weight_x, Fetch(In, x - ix + quad - 1, y));
+            }
+            else
+            {
+                // diagonal
+                weight_y = (ymod - quad) / quad;
+                Accumulate(C, (1.f - weight_y) * weight_x, Fetch(In, x + stride - ix, y - iy + quad - 1));
+                Accumulate(C, weight_y * (1.f - weight_x), Fetch(In, x - ix + quad - 1, y + stride - iy));
+                Accumulate(C, weight_y * weight_x, Fetch(In, x + stride - ix, y + stride - iy));
+                Accumulate(C, (1.f - weight_y) * (1.f - weight_x), Fetch(In, x - ix + quad - 1, y - iy + quad - 1));
+            }
+        }
+    }
+
+    // UNORM8 render target: round to nearest
+    for (int c = 0; c < 4; c++)
+        Out[c] = static_cast<uint8_t>(std::clamp(std::nearbyint(C[c]), 0.f, 255.f));
+}
+
+// The fast backends work on spans instead of pixels: within half a block of a row every pixel takes the
+// same branch of the shader, and each output is a weighted sum of a few inputs that are either the
+// matching pixels of another row (Step 1) or a single pixel (Step 0), with weights linear in the position.
+
+struct Term
+{
+    const uint8_t *Src = nullptr;
+    int Step = 0;               // pixels to advance Src per output pixel
+    float W0 = 0.f, dW = 0.f;   // weight of output pixel i is W0 + dW * (First + i)
+};
+
+struct Span
+{
+    uint8_t *Dst = nullptr;
+    int N = 0;     // pixels
+    int First = 0; // index of Dst within its half block (weights are relative to that)
+    Term Terms[4];
+    int NumTerms = 0;
+    float Scale = 1.f;
+
+    void Add(const uint8_t *Src, const int Step, const float W0, const float dW)
+    {
+        if (Src != nullptr) // out of range fetches are zero, so they add nothing
+            Terms[NumTerms++] = {Src, Step, W0, dW};
+    }
+};
+
+using BlendFn = void (*)(const Span &S);
+
+static void BlendScalar(const Span &S, const int Begin)
+{
+    for (int i = Begin; i < S.N; i++)
+    {
+        const float Idx = static_cast<float>(S.First + i);
+        float Acc[4] = {0.f, 0.f, 0.f, 0.f};
+        for (int t = 0; t < S.NumTerms; t++)
+        {
+            const Term &T = S.Terms[t];
+            const float W = T.W0 + T.dW * Idx;
+            const uint8_t *Px = T.Src + 4 * T.Step * i;
+            for (int c = 0; c < 4; c++)
+                Acc[c] = Acc[c] + W * Px[c];
+        }
+        for (int c = 0; c < 4; c++)
+            S.Dst[4 * i + c] = static_cast<uint8_t>(std::clamp(std::nearbyint(Acc[c] * S.Scale), 0.f, 255.f));
+    }
+}
+
+static void BlendScalar(const Span &S)
+{
+    BlendScalar(S, 0);
+}
+
+#if FOV_AVX2
+__attribute__((target("avx2"))) static void BlendAvx2(const Span &S)
+{
+    // 2 pixels (8 channels) per iteration, same operations in the same order as BlendScalar
+    const __m256 Lane = _mm256_setr_ps(0.f, 0.f, 0.f, 0.f, 1.f, 1.f, 1.f, 1.f);
+    int i = 0;
+    for (; i + 2 <= S.N; i += 2)
+    {
+        const __m256 Idx = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(S.First + i)), Lane);
+        __m256 Acc = _mm256_setzero_ps();
+        for (int t = 0; t < S.NumTerms; t++)
+        {
+            const Term &T = S.Terms[t];
+            const __m256 W = _mm256_add_ps(_mm256_set1_ps(T.W0), _mm256_mul_ps(_mm256_set1_ps(T.dW), Idx));
+            int64_t Bytes;
+            if (T.Step != 0)
+                std::memcpy(&Bytes, T.Src + 4 * i, 8);
+            else
+            {
+                std::memcpy(&Bytes, T.Src, 4);
+                std::memcpy(reinterpret_cast<uint8_t *>(&Bytes) + 4, T.Src, 4);
+            }
+            const __m256 C = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_cvtsi64_si128(Bytes)));
+            Acc = _mm256_add_ps(Acc, _mm256_mul_ps(W, C));
+        }
+        const __m256i Rounded = _mm256_cvtps_epi32(_mm256_mul_ps(Acc, _mm256_set1_ps(S.Scale))); // to nearest
+        const __m128i Words =
+            _mm_packus_epi32(_mm256_castsi256_si128(Rounded), _mm256_extracti128_si256(Rounded, 1));
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(S.Dst + 4 * i), _mm_packus_epi16(Words, Words));
+    }
+    BlendScalar(S, i);
+}
+#endif
+
+#if FOV_NEON
+static void BlendNeon(const Span &S)
+{
+    // 2 pixels per iteration (one register per pixel), same operations in the same order as BlendScalar
+    int i = 0;
+    for (; i + 2 <= S.N; i += 2)
+    {
+        const float32x4_t Idx0 = vdupq_n_f32(static_cast<float>(S.First + i));
+        const float32x4_t Idx1 = vdupq_n_f32(static_cast<float>(S.First + i + 1));
+        float32x4_t Acc0 = vdupq_n_f32(0.f), Acc1 = vdupq_n_f32(0.f);
+        for (int t = 0; t < S.NumTerms; t++)
+        {
+            const Term &T = S.Terms[t];
+            const float32x4_t W0 = vdupq_n_f32(T.W0), dW = vdupq_n_f32(T.dW);
+            uint8_t Bytes[8];
+            std::memcpy(Bytes, T.Src + 4 * T.Step * i, 4);
+            std::memcpy(Bytes + 4, T.Src + 4 * T.Step * (i + 1), 4);
+            const uint16x8_t Wide = vmovl_u8(vld1_u8(Bytes));
+            const float32x4_t C0 = vcvtq_f32_u32(vmovl_u16(vget_low_u16(Wide)));
+            const float32x4_t C1 = vcvtq_f32_u32(vmovl_u16(vget_high_u16(Wide)));
+            Acc0 = vaddq_f32(Acc0, vmulq_f32(vaddq_f32(W0, vmulq_f32(dW, Idx0)), C0));
+            Acc1 = vaddq_f32(Acc1, vmulq_f32(vaddq_f32(W0, vmulq_f32(dW, Idx1)), C1));
+        }
+        const float32x4_t Scale = vdupq_n_f32(S.Scale);
+        const int32x4_t Rounded0 = vcvtnq_s32_f32(vmulq_f32(Acc0, Scale)); // to nearest
+        const int32x4_t Rounded1 = vcvtnq_s32_f32(vmulq_f32(Acc1, Scale));
+        vst1_u8(S.Dst + 4 * i, vqmovn_u16(vcombine_u16(vqmovun_s32(Rounded0), vqmovun_s32(Rounded1))));
+    }
+    BlendScalar(S, i);
+}
+#endif
+
+bool HasSimd()
+{
+#if FOV_AVX2
+    return __builtin_cpu_supports("avx2");
+#elif FOV_NEON
+    return true;
+#else
+    return false;
+#endif
+}
+
+std::string BackendName(const Backend B)
+{
+    switch (B)
+    {
+    case Backend::Reference:
+        return "reference";
+    case Backend::Scalar:
+        return "scalar";
+    default:
+#if FOV_AVX2
+        return HasSimd() ? "avx2" : "scalar";
+#elif FOV_NEON
+        return "neon";
+#else
+        return "scalar";
+#endif
+    }
+}
+
+static void ReconstructRow(const Pattern &P, const Image &In, Image &Out, const int Center[2], const int y,
+                           const BlendFn Blend)
+{
+    const int S = P.Stride, Q = S / 2;
+    const float InvQ = 1.f / Q;
+    const int ymod = y % S, by = y - ymod;
+    const bool bLow = ymod < Q;
+
+    for (int x0 = 0; x0 < In.W; x0 += S)
+    {
+        const int Keep = LevelKeep(P, x0 / S, by / S, Center);
+        const bool bLattice = NeedsLattice(P, Center, Keep, x0 / S, by / S);
+        for (int Half = 0; Half < 2; Half++)
+        {
+            const bool bLeft = (Half == 0);
+            const int xs = x0 + Half * Q;
+            const int N = std::min(bLeft ? Q : S - Q, In.W - xs);
+            if (N <= 0)
+                break;
+
+            Span Sp;
+            Sp.Dst = Out.At(xs, y);
+            Sp.N = N;
+            bool bPassThrough = false;
+
+            if (QuadKept(Keep, x0 / S, by / S, !bLeft, !bLow))
+                bPassThrough = true;
+            else if (bLattice)
+            {
+                // rare (only around the sparse levels), per pixel
+                for (int i = 0; i < N; i++)
+                    ReconstructPixel(P, In, Center, xs + i, y, Out.At(xs + i, y));
+                continue;
+            }
+            else if (bLeft && !bLow && Keep >= 8) // top right
+            {
+                const float wy = static_cast<float>(ymod - Q) / Q;
+                Sp.Add(In.At(xs, by + S), 1, wy, 0.f);           // top
+                Sp.Add(In.At(xs, by + Q - 1), 1, 1.f - wy, 0.f); // bottom
+                const uint8_t *Left = In.At(x0 - 1, y);
+                if (Left != nullptr && (Left[0] | Left[1] | Left[2]) != 0)
+                {
+                    Sp.Add(In.At(x0 + Q, y), 0, 0.f, InvQ); // right
+                    Sp.Add(Left, 0, 1.f, -InvQ);            // left
+                    Sp.Scale = 0.5f;
+                }
+            }
+            else if (!bLeft && bLow && Keep >= 8) // bottom left
+            {
+                // whether the row below can be used is decided per pixel, so split into runs of equal choice
+                const float wy = static_cast<float>(ymod) / Q;
+                const uint8_t *Bottom = In.At(xs, by - 1);
+                const auto bFilled = [&](const int i) {
+                    return Bottom != nullptr && (Bottom[4 * i] | Bottom[4 * i + 1] | Bottom[4 * i + 2]) != 0;
+                };
+                for (int Begin = 0, End = 0; Begin < N; Begin = End)
+                {
+                    const bool bUseBottom = bFilled(Begin);
+                    for (End = Begin + 1; End < N && bFilled(End) == bUseBottom; End++)
+                        ;
+                    Span Run;
+                    Run.Dst = Out.At(xs + Begin, y);
+                    Run.N = End - Begin;
+                    Run.First = Begin;
+                    Run.Add(In.At(x0 + Q - 1, y), 0, 1.f, -InvQ); // left
+                    Run.Add(In.At(x0 + S, y), 0, 0.f, InvQ);      // right
+                    if (bUseBottom)
+                    {
+                        Run.Add(In.At(xs + Begin, by + Q), 1, wy, 0.f);  // top
+                        Run.Add(Bottom + 4 * Begin, 1, 1.f - wy, 0.f); // bottom
+                        Run.Scale = 0.5f;
+                    }
+                    Blend(Run);
+                }
+                continue;
+            }
+            else // only the top left is shaded
+            {
+                if (bLeft)
+                {
+                    // vertical
+                    const float wy = static_cast<float>(ymod - Q) / Q;
+                    Sp.Add(In.At(xs, by + S), 1, wy, 0.f);
+                    Sp.Add(In.At(xs, by + Q - 1), 1, 1.f - wy, 0.f);
+                }
+                else if (bLow)
+                {
+                    // horizontal
+                    Sp.Add(In.At(x0 + S, y), 0, 0.f, InvQ);
+                    Sp.Add(In.At(x0 + Q - 1, y), 0, 1.f, -InvQ);
+                }
+                else
+                {
+                    // diagonal
+                    const float wy = static_cast<float>(ymod - Q) / Q;
+                    Sp.Add(In.At(x0 + S, by + Q - 1), 0, 0.f, (1.f - wy) * InvQ);
+                    Sp.Add(In.At(x0 + Q - 1, by + S), 0, wy, -wy * InvQ);
+                    Sp.Add(In.At(x0 + S, by + S), 0, 0.f, wy * InvQ);
+                    Sp.Add(In.At(x0 + Q - 1, by + Q - 1), 0, 1.f - wy, -(1.f - wy) * InvQ);
+                }
+            }
+
+            if (bPassThrough)
+                std::memcpy(Sp.Dst, In.At(xs, y), 4 * N);
+            else
+                Blend(Sp);
+        }
+    }
+}
+
+static void GazeCenter(const Pattern &P, const int H, int Center[2])
+{
+    Center[0] = static_cast<int>(std::floor(P.GazeX / P.Stride));
+    Center[1] = static_cast<int>(std::floor((H - P.GazeY) / P.Stride));
+}
+
+int BlockKeep(const Pattern &P, const int H, const int bx, const int by, const float Slack)
+{
+    int Center[2];
+    GazeCenter(P, H, Center);
+    const float dx = static_cast<float>(bx - Center[0]) * P.Stride, dy = static_cast<float>(by - Center[1]) * P.Stride;
+    const float d = std::sqrt(dx * dx * P.AspectW + dy * dy);
+    for (int i = 0; i < P.NumLevels - 1; i++)
+    {
+        if (std::abs(d - P.Radius[i]) < Slack)
+            return -1;
+    }
+    return LevelKeep(P, bx, by, Center);
+}
+
+void ReconstructRows(const Pattern &P, const Image &In, Image &Out, const int Y0, const int Y1, const Backend B)
+{
+    int Center[2];
+    GazeCenter(P, In.H, Center);
+
+    if (B == Backend::Reference)
+    {
+        for (int y = Y0; y < Y1; y++)
+        {
+            for (int x = 0; x < In.W; x++)
+                ReconstructPixel(P, In, Center, x, y, Out.At(x, y));
+        }
+        return;
+    }
+
+    BlendFn Blend = BlendScalar;
+#if FOV_AVX2
+    if (B == Backend::Simd && HasSimd())
+        Blend = BlendAvx2;
+#elif FOV_NEON
+    if (B == Backend::Simd)
+        Blend = BlendNeon;
+#endif
+    for (int y = Y0; y < Y1; y++)
+        ReconstructRow(P, In, Out, Center, y, Blend);
+}
+
+void Reconstruct(const Pattern &P, const Image &In, Image &Out, const Backend B, int NumThreads)
+{
+    Out.Resize(In.W, In.H);
+    if (B == Backend::Reference)
+    {
+        ReconstructRows(P, In, Out, 0, In.H, B);
+        return;
+    }
+
+    // tiles are rows of blocks, handed out to the threads as they finish
+    const int NumTiles = (In.H + P.Stride - 1) / P.Stride;
+    if (NumThreads <= 0)
+        NumThreads = std::max(1u, std::thread::hardware_concurrency());
+    NumThreads = std::min(NumThreads, NumTiles);
+    std::atomic<int> NextTile(0);
+    const auto Work = [&]() {
+        for (int Tile = NextTile++; Tile < NumTiles; Tile = NextTile++)
+            ReconstructRows(P, In, Out, Tile * P.Stride, std::min((Tile + 1) * P.Stride, In.H), B);
+    };
+    std::vector<std::thread> Threads;
+    for (int t = 1; t < NumThreads; t++)
+        Threads.emplace_back(Work);
+    Work();
+    for (std::thread &T : Threads)
+        T.join();
+}
+
+} // namespace FovReference
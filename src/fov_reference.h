@@ -0,0 +1,65 @@
+#ifndef FOV_REFERENCE_H
+#define FOV_REFERENCE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// CPU implementation of the checkerboard drop pattern (fov_render_frag.glsl) and its spatial infill
+// (reconstruction_shader.glsl). Serves as the golden reference for the GPU output, and as a software path
+// for processing captured frames without a GL context.
+namespace FovReference
+{
+
+// RGBA8 image laid out like GL reads it back: tightly packed rows, bottom row first
+struct Image
+{
+    int W = 0, H = 0;
+    std::vector<uint8_t> Pixels;
+
+    void Resize(int Width, int Height);
+    uint8_t *At(int x, int y);
+    const uint8_t *At(int x, int y) const; // null outside of the image
+};
+
+constexpr int MaxLevels = 8; // foveation levels of the FrameState block
+
+// everything the drop pattern depends on, mirrors the FrameState block (and fov_common.glsl)
+struct Pattern
+{
+    int Stride = 16;                              // width (in pixels) of a block of 4 quads
+    int NumLevels = 4;                            // foveation levels in use
+    float Radius[MaxLevels] = {};                 // outer radius (pixels) of each level, the last one repeated
+    int Keep[MaxLevels] = {16, 12, 8, 4};         // kept sixteenths of each level (16, 12, 8, 4, 2 or 1)
+    float AspectW = 1.f;                          // weight of the horizontal distance (1 / aspect^2)
+    float GazeX = 0.f, GazeY = 0.f;               // window coordinates, y down (like the mouse)
+    int Phase[2] = {0, 0};                        // shift of the drop pattern, only used by Kept & Drop
+};
+
+enum class Backend
+{
+    Reference, // straight per-pixel port of the shader, single threaded
+    Scalar,    // per-span kernels, tile parallel
+    Simd,      // per-span AVX2/NEON kernels, tile parallel (Scalar if the CPU has neither)
+};
+
+bool HasSimd(); // AVX2 (checked at runtime) or NEON
+std::string BackendName(Backend B);
+
+bool Kept(const Pattern &P, int H, int x, int y); // whether the drop pass shades pixel (x, y) of an H tall frame
+// whether quad (qx, qy) ((0, 0) is the top left) of block (bx, by) is shaded at Keep sixteenths
+bool QuadKept(int Keep, int bx, int by, int qx, int qy);
+void Drop(const Pattern &P, Image &Img);          // clears every dropped pixel like the drop pass does
+// kept sixteenths of block (bx, by) of an H tall frame (with no phase shift), or -1 if it lies within Slack pixels
+// of a level boundary, where the GPU's rounding may pick either level
+int BlockKeep(const Pattern &P, int H, int bx, int by, float Slack);
+
+// infills the dropped pixels of In (which must use P with no phase shift) into Out.
+// NumThreads = 0 uses every hardware thread, out of range fetches read as zero like they do on the GPU
+void Reconstruct(const Pattern &P, const Image &In, Image &Out, Backend B = Backend::Simd, int NumThreads = 0);
+// rows [Y0, Y1) of Reconstruct on the calling thread, Out must already be In's size (for running on a thread pool)
+void ReconstructRows(const Pattern &P, const Image &In, Image &Out, int Y0, int Y1, Backend B = Backend::Simd);
+
+} // namespace FovReference
+
+#endif
@@ -0,0 +1,315 @@
+#include "frame_capture.h"
+#include "timeline.h"
+#include <algorithm>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+
+// frames waiting for the writer before new ones are dropped
+static constexpr size_t MaxQueued = 8;
+
+bool FrameCapture::Start(const CaptureParamsStruct &P)
+{
+    if (bActive)
+        return true;
+    Params = P;
+    FileW = FileH = 0;
+    bSizeWarned = false;
+    NumFrames = NumDropped = NumWritten = 0;
+
+    if (Params.Format == CaptureFormat::Y4M)
+        Out = fopen((Params.path + ".y4m").c_str(), "wb");
+    else if (Params.Format == CaptureFormat::Pipe)
+    {
+        std::signal(SIGPIPE, SIG_IGN); // a crashing encoder shouldn't take the renderer with it
+        Out = popen(Params.command.c_str(), "w");
+    }
+    if (Params.Format != CaptureFormat::PNG && Out == nullptr)
+    {
+        const std::string &Target = (Params.Format == CaptureFormat::Pipe) ? Params.command : Params.path;
+        std::cerr << "can't open the capture output \"" << Target << "\"" << std::endl;
+        return false;
+    }
+
+    Ring.resize(std::max(Params.num_pbos, 2));
+    for (Slot &S : Ring)
+        glGenBuffers(1, &S.PBO);
+    Next = 0;
+
+    bStop = false;
+    Writer = std::thread(&FrameCapture::WriterLoop, this);
+    bActive = true;
+    std::cout << "Capturing frames (" << cftos(Params.Format) << ")" << std::endl;
+    return true;
+}
+
+void FrameCapture::Stop()
+{
+    if (!bActive)
+        return;
+    Collect(true); // everything still in flight
+
+    {
+        std::lock_guard<std::mutex> L(Lock);
+        bStop = true;
+    }
+    QueueChanged.notify_all();
+    Writer.join();
+
+    for (Slot &S : Ring)
+    {
+        if (S.Fence != nullptr)
+            glDeleteSync(S.Fence);
+        glDeleteBuffers(1, &S.PBO);
+    }
+    Ring.clear();
+    Pool.clear();
+    if (Out != nullptr)
+        (Params.Format == CaptureFormat::Pipe) ? pclose(Out) : fclose(Out);
+    Out = nullptr;
+    bActive = false;
+    std::cout << "Captured " << NumWritten << " frames (" << NumDropped << " dropped)" << std::endl;
+}
+
+bool FrameCapture::IsActive() const
+{
+    return bActive;
+}
+
+void FrameCapture::Capture(const GLuint Framebuffer, const int W, const int H)
+{
+    if (!bActive)
+        return;
+    const Timeline::Span Span("FrameCapture::Capture");
+    Collect(false);
+
+    Slot &S = Ring[Next];
+    if (S.Fence != nullptr)
+    {
+        NumDropped++; // the oldest readback still isn't done, don't wait for it
+        return;
+    }
+    const size_t Size = 4 * static_cast<size_t>(W) * H;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, S.PBO);
+    if (S.W != W || S.H != H)
+        glBufferData(GL_PIXEL_PACK_BUFFER, Size, NULL, GL_STREAM_READ);
+    S.W = W;
+    S.H = H;
+
+    // returns right away, the copy into the PBO happens once the GPU gets to it
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, Framebuffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, W, H, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    S.Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    Next = (Next + 1) % Ring.size();
+}
+
+void FrameCapture::Collect(const bool bWait)
+{
+    // oldest first, so frames reach the writer in order
+    for (size_t i = 0; i < Ring.size(); i++)
+    {
+        Slot &S = Ring[(Next + i) % Ring.size()];
+        if (S.Fence == nullptr)
+            continue;
+        const GLenum Status = glClientWaitSync(S.Fence, bWait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+                                               bWait ? 1000000000ull : 0); // up to a second when draining
+        if (Status != GL_ALREADY_SIGNALED && Status != GL_CONDITION_SATISFIED)
+            break;
+        glDeleteSync(S.Fence);
+        S.Fence = nullptr;
+
+        Frame F;
+        {
+            std::lock_guard<std::mutex> L(Lock);
+            if (Queue.size() >= MaxQueued)
+            {
+                NumDropped++; // the writer can't keep up
+                continue;
+            }
+            if (!Pool.empty())
+            {
+                F = std::move(Pool.back());
+                Pool.pop_back();
+            }
+        }
+        F.W = S.W;
+        F.H = S.H;
+        F.Pixels.resize(4 * static_cast<size_t>(S.W) * S.H);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, S.PBO);
+        const void *Mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, F.Pixels.size(), GL_MAP_READ_BIT);
+        if (Mapped != nullptr)
+            std::memcpy(F.Pixels.data(), Mapped, F.Pixels.size());
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        if (Mapped == nullptr)
+        {
+            NumDropped++;
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> L(Lock);
+            Queue.push_back(std::move(F));
+        }
+        QueueChanged.notify_one();
+        NumFrames++;
+    }
+}
+
+void FrameCapture::WriterLoop()
+{
+    std::unique_lock<std::mutex> L(Lock);
+    while (true)
+    {
+        QueueChanged.wait(L, [&]() { return bStop || !Queue.empty(); });
+        if (Queue.empty())
+            break; // only stops once everything was written
+        Frame F = std::move(Queue.front());
+        Queue.pop_front();
+
+        L.unlock();
+        if (Write(F))
+            NumWritten++;
+        L.lock();
+        Pool.push_back(std::move(F));
+    }
+}
+
+static void WriteY4M(FILE *Out, const std::vector<uint8_t> &Pixels, const int W, const int H)
+{
+    // full resolution chroma (C444), BT.601 studio range, rows top first
+    std::vector<uint8_t> Planes(3 * static_cast<size_t>(W) * H);
+    uint8_t *Y = Planes.data(), *Cb = Y + static_cast<size_t>(W) * H, *Cr = Cb + static_cast<size_t>(W) * H;
+    for (int y = 0; y < H; y++)
+    {
+        const uint8_t *Row = Pixels.data() + 4 * static_cast<size_t>(H - 1 - y) * W;
+        for (int x = 0; x < W; x++)
+        {
+            const float R = Row[4 * x], G = Row[4 * x + 1], B = Row[4 * x + 2];
+            const size_t i = static_cast<size_t>(y) * W + x;
+            Y[i] = static_cast<uint8_t>(16.5f + (65.481f * R + 128.553f * G + 24.966f * B) / 255.f);
+            Cb[i] = static_cast<uint8_t>(128.5f + (-37.797f * R - 74.203f * G + 112.f * B) / 255.f);
+            Cr[i] = static_cast<uint8_t>(128.5f + (112.f * R - 93.786f * G - 18.214f * B) / 255.f);
+        }
+    }
+    fputs("FRAME\n", Out);
+    fwrite(Planes.data(), 1, Planes.size(), Out);
+}
+
+static uint32_t Crc32(const uint8_t *Data, const size_t Size, uint32_t Crc = 0)
+{
+    static uint32_t Table[256] = {};
+    if (Table[1] == 0)
+    {
+        for (uint32_t n = 0; n < 256; n++)
+        {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            Table[n] = c;
+        }
+    }
+    Crc = ~Crc;
+    for (size_t i = 0; i < Size; i++)
+        Crc = Table[(Crc ^ Data[i]) & 0xff] ^ (Crc >> 8);
+    return ~Crc;
+}
+
+static void PutU32(std::vector<uint8_t> &Buf, const uint32_t v)
+{
+    for (int Shift = 24; Shift >= 0; Shift -= 8)
+        Buf.push_back(static_cast<uint8_t>(v >> Shift));
+}
+
+static void PutChunk(FILE *Out, const char Type[4], const std::vector<uint8_t> &Data)
+{
+    std::vector<uint8_t> Chunk;
+    PutU32(Chunk, static_cast<uint32_t>(Data.size()));
+    Chunk.insert(Chunk.end(), Type, Type + 4);
+    Chunk.insert(Chunk.end(), Data.begin(), Data.end());
+    PutU32(Chunk, Crc32(Chunk.data() + 4, Chunk.size() - 4));
+    fwrite(Chunk.data(), 1, Chunk.size(), Out);
+}
+
+static bool WritePNG(const std::string &Path, const std::vector<uint8_t> &Pixels, const int W, const int H)
+{
+    // uncompressed (stored deflate blocks) RGB, so no zlib is needed. Big files, but cheap to write
+    FILE *Out = fopen(Path.c_str(), "wb");
+    if (Out == nullptr)
+        return false;
+    static const uint8_t Signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    fwrite(Signature, 1, sizeof(Signature), Out);
+
+    std::vector<uint8_t> Header;
+    PutU32(Header, W);
+    PutU32(Header, H);
+    Header.insert(Header.end(), {8, 2, 0, 0, 0}); // 8 bit RGB, no interlacing
+    PutChunk(Out, "IHDR", Header);
+
+    // scanlines (filter type 0) top row first
+    std::vector<uint8_t> Raw;
+    Raw.reserve((3 * static_cast<size_t>(W) + 1) * H);
+    for (int y = H - 1; y >= 0; y--)
+    {
+        Raw.push_back(0);
+        const uint8_t *Row = Pixels.data() + 4 * static_cast<size_t>(y) * W;
+        for (int x = 0; x < W; x++)
+            Raw.insert(Raw.end(), Row + 4 * x, Row + 4 * x + 3);
+    }
+
+    std::vector<uint8_t> Zlib = {0x78, 0x01};
+    uint32_t A = 1, B = 0; // adler32
+    for (size_t Pos = 0; Pos < Raw.size() || Pos == 0;)
+    {
+        const size_t Len = std::min<size_t>(Raw.size() - Pos, 65535);
+        const bool bFinal = (Pos + Len == Raw.size());
+        const uint16_t Len16 = static_cast<uint16_t>(Len), NotLen16 = static_cast<uint16_t>(~Len16);
+        // stored block header: final flag & type 0, then the length and its complement (little endian)
+        Zlib.insert(Zlib.end(), {static_cast<uint8_t>(bFinal), static_cast<uint8_t>(Len16),
+                                 static_cast<uint8_t>(Len16 >> 8), static_cast<uint8_t>(NotLen16),
+                                 static_cast<uint8_t>(NotLen16 >> 8)});
+        Zlib.insert(Zlib.end(), Raw.begin() + Pos, Raw.begin() + Pos + Len);
+        for (size_t i = Pos; i < Pos + Len; i++)
+        {
+            A = (A + Raw[i]) % 65521;
+            B = (B + A) % 65521;
+        }
+        Pos += Len;
+        if (bFinal)
+            break;
+    }
+    PutU32(Zlib, (B << 16) | A);
+    PutChunk(Out, "IDAT", Zlib);
+    PutChunk(Out, "IEND", {});
+    return fclose(Out) == 0;
+}
+
+bool FrameCapture::Write(const Frame &F)
+{
+    if (Params.Format == CaptureFormat::PNG)
+    {
+        char Name[32];
+        snprintf(Name, sizeof(Name), "_%06d.png", NumWritten);
+        return WritePNG(Params.path + Name, F.Pixels, F.W, F.H);
+    }
+
+    if (FileW == 0)
+    {
+        FileW = F.W;
+        FileH = F.H;
+        fprintf(Out, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n", FileW, FileH, Params.fps);
+    }
+    if (F.W != FileW || F.H != FileH)
+    {
+        // the stream's size is fixed by its header
+        if (!bSizeWarned)
+            std::cerr << "the window was resized, skipping captured frames that aren't " << FileW << " x " << FileH
+                      << std::endl;
+        bSizeWarned = true;
+        return false;
+    }
+    WriteY4M(Out, F.Pixels, F.W, F.H);
+    return !ferror(Out);
+}
@@ -0,0 +1,65 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include "gl_headers.h"
+#include "utils.h"
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Streams the final frames out of the renderer without stalling it: each frame is read back into one of a
+// ring of pixel buffer objects, which is only mapped once its fence signaled (a few frames later). A writer
+// thread then encodes the frames as a Y4M file, a PNG sequence, or a Y4M stream piped into an encoder.
+// If the GPU or the writer fall behind, frames are dropped (and counted) rather than stalling the render loop.
+class FrameCapture
+{
+  public:
+    bool Start(const CaptureParamsStruct &P);
+    void Stop(); // waits for every queued frame to be written
+    bool IsActive() const;
+
+    void Capture(GLuint Framebuffer, int W, int H); // queues the readback of the frame, call before swapping
+
+  private:
+    struct Frame
+    {
+        int W = 0, H = 0;
+        std::vector<uint8_t> Pixels; // RGBA8, bottom row first
+    };
+    struct Slot
+    {
+        GLuint PBO = 0;
+        GLsync Fence = nullptr; // null if the slot is free
+        int W = 0, H = 0;
+    };
+
+    void Collect(bool bWait); // hands finished readbacks (in order) to the writer
+    void WriterLoop();
+    bool Write(const Frame &F);
+
+    bool bActive = false;
+    CaptureParamsStruct Params;
+    std::vector<Slot> Ring;
+    size_t Next = 0;   // slot the next frame is read into
+    int NumFrames = 0; // frames handed to the writer
+    int NumDropped = 0;
+
+    // writer thread
+    std::thread Writer;
+    std::mutex Lock; // guards Queue, Pool & bStop
+    std::condition_variable QueueChanged;
+    std::deque<Frame> Queue;
+    std::vector<Frame> Pool; // written frames, reused to avoid reallocating
+    bool bStop = false;
+    FILE *Out = nullptr;   // y4m file or pipe
+    int FileW = 0, FileH = 0; // y4m streams can't change size
+    bool bSizeWarned = false;
+    int NumWritten = 0;
+};
+
+#endif
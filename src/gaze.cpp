@@ -0,0 +1,311 @@
+#include "gaze.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace Gaze
+{
+
+// a gap this long (blink, dropped connection) resets the motion state
+static constexpr double MaxGap = 0.25;
+// time constants of the velocity filter & the fixation smoothing (seconds)
+static constexpr float VelocityTau = 0.02f, FixationTau = 0.05f;
+// below this fraction of the saccade speed the eye is considered fixating (only jitter, nothing to extrapolate)
+static constexpr float FixationSpeed = 0.05f;
+// saccades decelerate into their landing point, so their extrapolation levels off after about this long
+static constexpr float SaccadeTau = 0.02f;
+// never extrapolate further ahead than this (seconds), ex. if the provider stalled
+static constexpr float MaxLeadTime = 0.1f;
+
+double Now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool Queue::Push(const Sample &S)
+{
+    const size_t H = Head.load(std::memory_order_relaxed);
+    const size_t Next = (H + 1) % Capacity;
+    if (Next == Tail.load(std::memory_order_acquire))
+        return false;
+    Items[H] = S;
+    Head.store(Next, std::memory_order_release); // publishes the sample
+    return true;
+}
+
+bool Queue::Pop(Sample &S)
+{
+    const size_t T = Tail.load(std::memory_order_relaxed);
+    if (T == Head.load(std::memory_order_acquire))
+        return false;
+    S = Items[T];
+    Tail.store((T + 1) % Capacity, std::memory_order_release); // hands the slot back to the producer
+    return true;
+}
+
+bool Provider::Start()
+{
+    if (!Open())
+    {
+        std::cerr << "can't open the gaze " << Name() << std::endl;
+        return false;
+    }
+    bStop = false;
+    if (Threaded())
+        Thread = std::thread(&Provider::Loop, this);
+    std::cout << "Gaze from the " << Name() << std::endl;
+    return true;
+}
+
+void Provider::Stop()
+{
+    if (!Thread.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> L(Lock);
+        bStop = true;
+    }
+    Wake.notify_all();
+    Thread.join();
+    Close();
+    if (NumDropped > 0)
+        std::cout << "Dropped " << NumDropped << " gaze samples (the renderer fell behind)" << std::endl;
+}
+
+bool Provider::WaitUntil(const double Time)
+{
+    using namespace std::chrono;
+    const steady_clock::time_point Deadline(duration_cast<steady_clock::duration>(duration<double>(Time)));
+    std::unique_lock<std::mutex> L(Lock);
+    return !Wake.wait_until(L, Deadline, [&]() { return bStop.load(); });
+}
+
+void Provider::Push(const Sample &S)
+{
+    if (!Samples.Push(S))
+        NumDropped++;
+}
+
+void MouseProvider::Cursor(const double Time, const float X, const float Y)
+{
+    Sample S;
+    S.Time = Time;
+    S.X = X;
+    S.Y = Y;
+    Push(S);
+}
+
+bool TraceProvider::Open()
+{
+    std::ifstream Input(Path);
+    if (!Input.is_open())
+        return false;
+    Trace.clear();
+    std::string Line;
+    while (std::getline(Input, Line))
+    {
+        if (Line.empty() || Line[0] == '#')
+            continue;
+        std::istringstream Fields(Line);
+        Sample S;
+        if (!(Fields >> S.Time >> S.X >> S.Y))
+        {
+            std::cout << "WARNING: ignoring malformed gaze sample \"" << Line << "\"" << std::endl;
+            continue;
+        }
+        if (!(Fields >> S.View))
+            S.View = -1; // both eyes
+        S.bValid = (S.X >= 0.f && S.Y >= 0.f);
+        Trace.push_back(S);
+    }
+    if (Trace.empty())
+        return false;
+    std::stable_sort(Trace.begin(), Trace.end(), [](const Sample &A, const Sample &B) { return A.Time < B.Time; });
+    return true;
+}
+
+void TraceProvider::Loop()
+{
+    double Start = Now() - Trace.front().Time;
+    // one mean sample interval between the end and the restart, so looping doesn't repeat a timestamp
+    const double Period = Trace.back().Time - Trace.front().Time +
+                          (Trace.size() > 1 ? (Trace.back().Time - Trace.front().Time) / (Trace.size() - 1) : 0.0);
+    while (!Stopping())
+    {
+        for (const Sample &T : Trace)
+        {
+            if (!WaitUntil(Start + T.Time))
+                return;
+            Sample S = T;
+            S.Time = Start + T.Time;
+            Push(S);
+        }
+        if (!bLoop || Period <= 0.0)
+            return;
+        Start += Period;
+    }
+}
+
+bool SocketProvider::Open()
+{
+    if (Address.rfind("unix:", 0) == 0)
+    {
+        UnixPath = Address.substr(5);
+        sockaddr_un Addr = {};
+        Addr.sun_family = AF_UNIX;
+        if (UnixPath.empty() || UnixPath.size() >= sizeof(Addr.sun_path))
+            return false;
+        std::copy(UnixPath.begin(), UnixPath.end(), Addr.sun_path);
+        Fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+        unlink(UnixPath.c_str()); // left behind by an earlier run
+        if (Fd >= 0 && bind(Fd, reinterpret_cast<sockaddr *>(&Addr), sizeof(Addr)) == 0)
+            return true;
+        UnixPath.clear();
+    }
+    else
+    {
+        // udp:host:port
+        const std::string HostPort = (Address.rfind("udp:", 0) == 0) ? Address.substr(4) : Address;
+        const size_t Colon = HostPort.rfind(':');
+        sockaddr_in Addr = {};
+        Addr.sin_family = AF_INET;
+        if (Colon == std::string::npos ||
+            inet_pton(AF_INET, HostPort.substr(0, Colon).c_str(), &Addr.sin_addr) != 1)
+            return false;
+        Addr.sin_port = htons(static_cast<uint16_t>(std::atoi(HostPort.c_str() + Colon + 1)));
+        Fd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (Fd >= 0 && bind(Fd, reinterpret_cast<sockaddr *>(&Addr), sizeof(Addr)) == 0)
+            return true;
+    }
+    perror("gaze socket");
+    Close();
+    return false;
+}
+
+void SocketProvider::Close()
+{
+    if (Fd >= 0)
+        close(Fd);
+    Fd = -1;
+    if (!UnixPath.empty())
+        unlink(UnixPath.c_str());
+    UnixPath.clear();
+}
+
+void SocketProvider::Loop()
+{
+    while (!Stopping())
+    {
+        // wake up regularly to notice Stop
+        pollfd P = {Fd, POLLIN, 0};
+        if (poll(&P, 1, 100) <= 0)
+            continue;
+        char Buf[128];
+        const ssize_t Len = recv(Fd, Buf, sizeof(Buf) - 1, 0);
+        if (Len <= 0)
+            continue;
+        Buf[Len] = '\0';
+        Sample S;
+        S.Time = Now();
+        if (std::sscanf(Buf, "%f %f %d", &S.X, &S.Y, &S.View) < 2)
+            continue;
+        S.bValid = (S.X >= 0.f && S.Y >= 0.f);
+        Push(S);
+    }
+}
+
+std::unique_ptr<Provider> MakeProvider(const GazeParamsStruct &P)
+{
+    if (P.Source == GazeSource::Trace)
+        return std::make_unique<TraceProvider>(P.trace, P.bTraceLoop);
+    if (P.Source == GazeSource::Socket)
+        return std::make_unique<SocketProvider>(P.socket);
+    return std::make_unique<MouseProvider>();
+}
+
+void Predictor::Add(const Sample &S, const GazeParamsStruct &P)
+{
+    if (!S.bValid)
+        return; // keep the last known gaze through blinks
+    const double dt = S.Time - Last.Time;
+    if (!bHasSample || dt > MaxGap)
+    {
+        FixX = S.X;
+        FixY = S.Y;
+        VelX = VelY = 0.f;
+        bSaccade = false;
+        bHasSample = true;
+        Last = S;
+        return;
+    }
+
+    if (dt > 1e-4)
+    {
+        const float a = 1.f - std::exp(-static_cast<float>(dt) / VelocityTau);
+        VelX += a * ((S.X - Last.X) / static_cast<float>(dt) - VelX);
+        VelY += a * ((S.Y - Last.Y) / static_cast<float>(dt) - VelY);
+    }
+    const float Speed = std::hypot(VelX, VelY);
+    // hysteresis, so the onset & landing of a saccade don't flicker
+    if (Speed > P.saccade_speed)
+        bSaccade = true;
+    else if (Speed < 0.5f * P.saccade_speed)
+        bSaccade = false;
+
+    if (!bSaccade && Speed < FixationSpeed * P.saccade_speed)
+    {
+        const float b = 1.f - std::exp(-static_cast<float>(std::max(dt, 0.0)) / FixationTau);
+        FixX += b * (S.X - FixX);
+        FixY += b * (S.Y - FixY);
+    }
+    else
+    {
+        FixX = S.X;
+        FixY = S.Y;
+    }
+    Last = S;
+}
+
+bool Predictor::Predict(const double Time, const GazeParamsStruct &P, float &X, float &Y) const
+{
+    if (!bHasSample)
+        return false;
+    X = Last.X;
+    Y = Last.Y;
+    if (!P.bPredict)
+        return true;
+
+    const float Speed = std::hypot(VelX, VelY);
+    if (!bSaccade && Speed < FixationSpeed * P.saccade_speed)
+    {
+        X = FixX; // fixating, the jitter isn't worth following
+        Y = FixY;
+        return true;
+    }
+
+    // pursuits keep going in a straight line, saccades level off as they land
+    const float t = std::clamp(static_cast<float>(Time - Last.Time), 0.f, MaxLeadTime);
+    const float Lead = bSaccade ? SaccadeTau * (1.f - std::exp(-t / SaccadeTau)) : t;
+    float dx = VelX * Lead, dy = VelY * Lead;
+    const float Dist = std::hypot(dx, dy);
+    if (Dist > P.max_lead)
+    {
+        dx *= P.max_lead / Dist;
+        dy *= P.max_lead / Dist;
+    }
+    X = std::clamp(Last.X + dx, 0.f, 1.f);
+    Y = std::clamp(Last.Y + dy, 0.f, 1.f);
+    return true;
+}
+
+} // namespace Gaze
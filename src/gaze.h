@@ -0,0 +1,143 @@
+#ifndef GAZE_H
+#define GAZE_H
+
+#include "utils.h"
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Where the user is looking, which is the center of the foveal region. Providers produce gaze samples (from the
+// mouse, a recorded trace or an eye tracker process on a local socket) and hand them to the render thread through
+// a lock-free queue, where the Predictor extrapolates them to the time the frame will actually be scanned out.
+namespace Gaze
+{
+
+double Now(); // seconds on the clock every sample is stamped with (steady, unrelated to the shader time)
+
+struct Sample
+{
+    double Time = 0.0;  // when the sample was taken (Now)
+    float X = 0.f;      // normalized window (or view, when stereo) coordinates, y down (like the mouse)
+    float Y = 0.f;
+    bool bValid = true; // false while the tracker lost the eye (ex. blinks)
+    int View = -1;      // eye of a stereo tracker (0 left, 1 right), -1 for both
+};
+
+// single producer (the provider's thread), single consumer (the render thread)
+class Queue
+{
+  public:
+    bool Push(const Sample &S); // false if full, the sample is dropped
+    bool Pop(Sample &S);        // false if empty
+
+  private:
+    static constexpr size_t Capacity = 256; // a 1 kHz tracker fills a quarter of it per 60 Hz frame
+    std::array<Sample, Capacity> Items;
+    std::atomic<size_t> Head{0}; // next slot written by the producer
+    std::atomic<size_t> Tail{0}; // next slot read by the consumer
+};
+
+class Provider
+{
+  public:
+    virtual ~Provider() = default;
+    bool Start(); // opens the source and starts its thread
+    void Stop();  // call before destroying it
+    bool Poll(Sample &S) { return Samples.Pop(S); } // render thread, never blocks
+
+    virtual std::string Name() const = 0;
+    virtual void Cursor(double, float, float) {} // the latest cursor position (time, normalized x & y)
+
+  protected:
+    virtual bool Open() { return true; }
+    virtual void Close() {}
+    virtual bool Threaded() const { return true; }
+    virtual void Loop() {} // produces samples on the provider's thread until Stopping()
+
+    bool Stopping() const { return bStop; }
+    bool WaitUntil(double Time); // sleeps until Now() reaches Time, false if stopped in the meantime
+    void Push(const Sample &S);
+
+  private:
+    Queue Samples;
+    std::thread Thread;
+    std::atomic<bool> bStop{false};
+    std::mutex Lock; // only for waking up WaitUntil
+    std::condition_variable Wake;
+    std::atomic<int> NumDropped{0};
+};
+
+// the cursor, fed from the render thread with the position the input thread last polled
+class MouseProvider : public Provider
+{
+  public:
+    std::string Name() const override { return "mouse"; }
+    void Cursor(double Time, float X, float Y) override;
+
+  protected:
+    bool Threaded() const override { return false; }
+};
+
+// replays a text trace of "seconds x y [eye]" lines (# for comments, x & y negative for lost samples) in real time
+class TraceProvider : public Provider
+{
+  public:
+    TraceProvider(const std::string &Path, bool bLoop) : Path(Path), bLoop(bLoop) {}
+    ~TraceProvider() override { Stop(); }
+    std::string Name() const override { return "trace \"" + Path + "\""; }
+
+  protected:
+    bool Open() override;
+    void Loop() override;
+
+  private:
+    std::string Path;
+    bool bLoop;
+    std::vector<Sample> Trace; // times relative to the start of the trace
+};
+
+// datagrams of "x y [eye]" (normalized, negative for lost samples) on a local udp port or unix socket
+class SocketProvider : public Provider
+{
+  public:
+    explicit SocketProvider(const std::string &Address) : Address(Address) {}
+    ~SocketProvider() override { Stop(); }
+    std::string Name() const override { return "socket \"" + Address + "\""; }
+
+  protected:
+    bool Open() override;
+    void Close() override;
+    void Loop() override;
+
+  private:
+    std::string Address;
+    std::string UnixPath; // removed again on close
+    int Fd = -1;
+};
+
+std::unique_ptr<Provider> MakeProvider(const GazeParamsStruct &P);
+
+// smooths the fixations and extrapolates moving gaze (pursuits & saccades) with its filtered velocity
+class Predictor
+{
+  public:
+    void Add(const Sample &S, const GazeParamsStruct &P);
+    bool Predict(double Time, const GazeParamsStruct &P, float &X, float &Y) const; // false until a sample
+    bool InSaccade() const { return bSaccade; }
+
+  private:
+    bool bHasSample = false;
+    Sample Last;                  // latest valid sample
+    float FixX = 0.f, FixY = 0.f; // low passed position while fixating
+    float VelX = 0.f, VelY = 0.f; // low passed velocity (per second)
+    bool bSaccade = false;
+};
+
+} // namespace Gaze
+
+#endif
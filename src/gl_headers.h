@@ -0,0 +1,24 @@
+#ifndef GL_HEADERS_H
+#define GL_HEADERS_H
+
+// platform specific OpenGL (+ GLFW) includes shared by every GL translation unit
+#ifdef __APPLE__
+/* Defined before OpenGL and GLUT includes to avoid deprecation messages */
+#define GL_SILENCE_DEPRECATION
+#define GLFW_INCLUDE_GLCOREARB
+#include <GLFW/glfw3.h>
+#else
+#define GL_GLEXT_PROTOTYPES
+#define GLFW_INCLUDE_GLEXT
+#include <GLFW/glfw3.h>
+#endif
+
+// GL 4.3 compute (the reconstruction_engine), loaded at runtime since macOS stops at 4.1
+#ifndef GL_COMPUTE_SHADER
+#define GL_COMPUTE_SHADER 0x91B9
+#endif
+#ifndef GL_FRAMEBUFFER_BARRIER_BIT
+#define GL_FRAMEBUFFER_BARRIER_BIT 0x00000400
+#endif
+
+#endif
@@ -0,0 +1,152 @@
+#include "gpu_profiler.h"
+#include <algorithm>
+#include <iostream>
+
+bool GpuProfiler::Init(const size_t FramesInFlight)
+{
+    Ring.resize(FramesInFlight);
+    for (auto &F : Ring)
+    {
+        glGenQueries(NumPasses, F.Begin);
+        glGenQueries(NumPasses, F.End);
+    }
+    Current = 0;
+    return glGetError() == GL_NO_ERROR;
+}
+
+void GpuProfiler::Destroy()
+{
+    for (auto &F : Ring)
+    {
+        glDeleteQueries(NumPasses, F.Begin);
+        glDeleteQueries(NumPasses, F.End);
+    }
+    Ring.clear();
+    Completed.clear();
+}
+
+void GpuProfiler::BeginFrame(const uint64_t FrameId)
+{
+    if (Ring.empty())
+        return;
+    Current = (Current + 1) % Ring.size();
+    FrameQueries &F = Ring[Current];
+    if (F.bPending)
+    {
+        // the GPU is more than a full ring behind, rather than waiting we lose this sample
+        if (IsAvailable(F))
+            ReadBack(F);
+        else
+            Dropped++;
+    }
+    // the query objects themselves are reused across frames
+    std::fill(std::begin(F.bIssued), std::end(F.bIssued), false);
+    F.bPending = false;
+    F.FrameId = FrameId;
+}
+
+void GpuProfiler::BeginPass(const Pass P)
+{
+    if (Ring.empty())
+        return;
+    glQueryCounter(Ring[Current].Begin[P], GL_TIMESTAMP);
+}
+
+void GpuProfiler::EndPass(const Pass P)
+{
+    if (Ring.empty())
+        return;
+    glQueryCounter(Ring[Current].End[P], GL_TIMESTAMP);
+    Ring[Current].bIssued[P] = true;
+}
+
+void GpuProfiler::EndFrame()
+{
+    if (Ring.empty())
+        return;
+    Ring[Current].bPending = true;
+    Poll(false);
+}
+
+void GpuProfiler::Flush()
+{
+    Poll(true);
+}
+
+std::vector<GpuProfiler::FrameTimings> GpuProfiler::Collect()
+{
+    std::vector<FrameTimings> Out;
+    Out.swap(Completed);
+    return Out;
+}
+
+const char *GpuProfiler::PassName(const Pass P)
+{
+    switch (P)
+    {
+    case MaskPass:
+        return "mask";
+    case DropPass:
+        return "drop";
+    case ReconstructionPass:
+        return "reconstruction";
+    case BufferPass:
+        return "buffers";
+    default:
+        return "unknown";
+    }
+}
+
+size_t GpuProfiler::NumDropped() const
+{
+    return Dropped;
+}
+
+bool GpuProfiler::IsAvailable(const FrameQueries &F) const
+{
+    // timestamps retire in order, so checking every issued end query is sufficient
+    for (int P = 0; P < NumPasses; P++)
+    {
+        if (!F.bIssued[P])
+            continue;
+        GLint bAvailable = GL_FALSE;
+        glGetQueryObjectiv(F.End[P], GL_QUERY_RESULT_AVAILABLE, &bAvailable);
+        if (!bAvailable)
+            return false;
+    }
+    return true;
+}
+
+void GpuProfiler::ReadBack(FrameQueries &F)
+{
+    FrameTimings T;
+    T.FrameId = F.FrameId;
+    for (int P = 0; P < NumPasses; P++)
+    {
+        if (!F.bIssued[P])
+            continue;
+        GLuint64 Begin = 0, End = 0;
+        glGetQueryObjectui64v(F.Begin[P], GL_QUERY_RESULT, &Begin);
+        glGetQueryObjectui64v(F.End[P], GL_QUERY_RESULT, &End);
+        T.Ms[P] = (End - Begin) * 1e-6; // ns to ms
+        T.bMeasured[P] = true;
+        T.BeginNs[P] = Begin;
+        T.EndNs[P] = End;
+    }
+    F.bPending = false;
+    Completed.push_back(T);
+}
+
+void GpuProfiler::Poll(const bool bBlocking)
+{
+    // walk the ring from the oldest frame to the newest, stop at the first one still in flight
+    for (size_t i = 1; i <= Ring.size(); i++)
+    {
+        FrameQueries &F = Ring[(Current + i) % Ring.size()];
+        if (!F.bPending)
+            continue;
+        if (!bBlocking && !IsAvailable(F))
+            break;
+        ReadBack(F);
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include "gl_headers.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Per-pass GPU timings from GL_TIMESTAMP queries. Queries are kept in a ring that spans several
+// frames and results are only read back once the GPU reports them as available, so measuring
+// never stalls the pipeline (unlike glFinish). Timings therefore arrive a few frames late.
+class GpuProfiler
+{
+  public:
+    enum Pass
+    {
+        MaskPass = 0,
+        DropPass,
+        ReconstructionPass,
+        BufferPass, // the buffers of a multipass shader
+        NumPasses
+    };
+
+    struct FrameTimings
+    {
+        uint64_t FrameId = 0;
+        double Ms[NumPasses] = {};
+        bool bMeasured[NumPasses] = {};
+        uint64_t BeginNs[NumPasses] = {}, EndNs[NumPasses] = {}; // the raw GL_TIMESTAMPs (timeline)
+    };
+
+    bool Init(size_t FramesInFlight = 5);
+    void Destroy();
+    bool IsActive() const { return !Ring.empty(); } // Init'ed (it measures nothing otherwise)
+
+    void BeginFrame(uint64_t FrameId);
+    void BeginPass(Pass P);
+    void EndPass(Pass P);
+    void EndFrame(); // polls for finished frames without blocking
+
+    void Flush();                        // blocks until every issued frame has been read back
+    std::vector<FrameTimings> Collect(); // hands over (and clears) the finished frames
+
+    static const char *PassName(Pass P);
+    size_t NumDropped() const;
+
+  private:
+    struct FrameQueries
+    {
+        GLuint Begin[NumPasses] = {};
+        GLuint End[NumPasses] = {};
+        bool bIssued[NumPasses] = {};
+        bool bPending = false;
+        uint64_t FrameId = 0;
+    };
+
+    bool IsAvailable(const FrameQueries &F) const;
+    void ReadBack(FrameQueries &F);
+    void Poll(bool bBlocking);
+
+    std::vector<FrameQueries> Ring;
+    size_t Current = 0;
+    size_t Dropped = 0; // frames whose queries were recycled before the GPU finished them
+    std::vector<FrameTimings> Completed;
+};
+
+#endif
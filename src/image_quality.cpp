@@ -0,0 +1,142 @@
+#include "image_quality.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace ImageQuality
+{
+
+std::string RingName(const int Ring, const int NumRings)
+{
+    if (Ring == 0)
+        return "fovea";
+    return (Ring == NumRings - 1) ? "periphery" : "ring" + std::to_string(Ring);
+}
+
+static int RingOf(const FovReference::Pattern &P, const int H, const int x, const int y)
+{
+    // distance from the pixel center to the gaze (y up like the images)
+    const float dx = x + 0.5f - P.GazeX, dy = y + 0.5f - (H - P.GazeY);
+    const float d = std::sqrt(dx * dx * P.AspectW + dy * dy);
+    int Ring = 0;
+    while (Ring < P.NumLevels - 1 && d >= P.Radius[Ring])
+        Ring++;
+    return Ring;
+}
+
+static double Psnr(const double SqErr, const double NumSamples)
+{
+    if (NumSamples == 0.0)
+        return 0.0;
+    if (SqErr == 0.0)
+        return MaxPsnr;
+    return std::min(MaxPsnr, 10.0 * std::log10(255.0 * 255.0 * NumSamples / SqErr));
+}
+
+static std::vector<float> Luma(const FovReference::Image &Img)
+{
+    std::vector<float> Y(static_cast<size_t>(Img.W) * Img.H);
+    for (size_t i = 0; i < Y.size(); i++)
+    {
+        const uint8_t *Px = &Img.Pixels[4 * i];
+        Y[i] = 0.299f * Px[0] + 0.587f * Px[1] + 0.114f * Px[2];
+    }
+    return Y;
+}
+
+static void Blur(std::vector<float> &Map, const int W, const int H)
+{
+    // separable 11x11 gaussian (sigma 1.5) as in the original SSIM, clamped at the borders
+    constexpr int Radius = 5;
+    float Kernel[2 * Radius + 1];
+    float Sum = 0.f;
+    for (int i = -Radius; i <= Radius; i++)
+        Sum += Kernel[i + Radius] = std::exp(-(i * i) / (2.f * 1.5f * 1.5f));
+    for (float &k : Kernel)
+        k /= Sum;
+
+    std::vector<float> Tmp(Map.size());
+    for (int y = 0; y < H; y++)
+    {
+        for (int x = 0; x < W; x++)
+        {
+            float Acc = 0.f;
+            for (int i = -Radius; i <= Radius; i++)
+                Acc += Kernel[i + Radius] * Map[static_cast<size_t>(y) * W + std::clamp(x + i, 0, W - 1)];
+            Tmp[static_cast<size_t>(y) * W + x] = Acc;
+        }
+    }
+    for (int y = 0; y < H; y++)
+    {
+        for (int x = 0; x < W; x++)
+        {
+            float Acc = 0.f;
+            for (int i = -Radius; i <= Radius; i++)
+                Acc += Kernel[i + Radius] * Tmp[static_cast<size_t>(std::clamp(y + i, 0, H - 1)) * W + x];
+            Map[static_cast<size_t>(y) * W + x] = Acc;
+        }
+    }
+}
+
+Score Compare(const FovReference::Image &Reference, const FovReference::Image &Test,
+              const FovReference::Pattern &Rings)
+{
+    Score S;
+    const int W = Reference.W, H = Reference.H;
+    if (W != Test.W || H != Test.H || W == 0 || H == 0)
+        return S;
+    const size_t N = static_cast<size_t>(W) * H;
+
+    // local means, variances & covariance of the luma
+    std::vector<float> X = Luma(Reference), Y = Luma(Test);
+    std::vector<float> XX(N), YY(N), XY(N);
+    for (size_t i = 0; i < N; i++)
+    {
+        XX[i] = X[i] * X[i];
+        YY[i] = Y[i] * Y[i];
+        XY[i] = X[i] * Y[i];
+    }
+    for (std::vector<float> *Map : {&X, &Y, &XX, &YY, &XY})
+        Blur(*Map, W, H);
+
+    constexpr float C1 = (0.01f * 255.f) * (0.01f * 255.f);
+    constexpr float C2 = (0.03f * 255.f) * (0.03f * 255.f);
+    double SqErr = 0.0, SsimSum = 0.0;
+    std::array<double, MaxRings> RingSqErr = {}, RingSsimSum = {}, RingPixels = {};
+    for (int y = 0; y < H; y++)
+    {
+        for (int x = 0; x < W; x++)
+        {
+            const size_t i = static_cast<size_t>(y) * W + x;
+            const float VarX = XX[i] - X[i] * X[i], VarY = YY[i] - Y[i] * Y[i], CovXY = XY[i] - X[i] * Y[i];
+            const double Ssim = ((2.0 * X[i] * Y[i] + C1) * (2.0 * CovXY + C2)) /
+                                ((double(X[i]) * X[i] + double(Y[i]) * Y[i] + C1) * (double(VarX) + VarY + C2));
+            double Err = 0.0;
+            for (int c = 0; c < 3; c++)
+            {
+                const double d = double(Reference.Pixels[4 * i + c]) - Test.Pixels[4 * i + c];
+                Err += d * d;
+            }
+
+            const int Ring = RingOf(Rings, H, x, y);
+            SqErr += Err;
+            SsimSum += Ssim;
+            RingSqErr[Ring] += Err;
+            RingSsimSum[Ring] += Ssim;
+            RingPixels[Ring] += 1.0;
+        }
+    }
+
+    S.Psnr = Psnr(SqErr, 3.0 * N);
+    S.Ssim = SsimSum / N;
+    S.NumRings = Rings.NumLevels;
+    for (int r = 0; r < S.NumRings; r++)
+    {
+        S.RingPsnr[r] = Psnr(RingSqErr[r], 3.0 * RingPixels[r]);
+        S.RingSsim[r] = (RingPixels[r] > 0.0) ? RingSsimSum[r] / RingPixels[r] : 0.0;
+        S.RingCoverage[r] = RingPixels[r] / N;
+    }
+    return S;
+}
+
+} // namespace ImageQuality
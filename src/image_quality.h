@@ -0,0 +1,31 @@
+#ifndef IMAGE_QUALITY_H
+#define IMAGE_QUALITY_H
+
+#include "fov_reference.h"
+#include <array>
+#include <string>
+
+// Full-reference image quality of a foveated frame against the full quality render of the same frame,
+// over the whole image and per foveal ring (so loss in the periphery is told apart from loss at the gaze)
+namespace ImageQuality
+{
+
+constexpr int MaxRings = FovReference::MaxLevels; // one per foveation level
+constexpr double MaxPsnr = 100.0;                  // reported for identical images
+std::string RingName(int Ring, int NumRings);      // fovea, ring1, ring2, ..., periphery
+
+struct Score
+{
+    double Psnr = 0.0, Ssim = 0.0; // PSNR (dB) over RGB, SSIM over luma
+    int NumRings = 0;
+    std::array<double, MaxRings> RingPsnr = {}, RingSsim = {};
+    std::array<double, MaxRings> RingCoverage = {}; // fraction of the pixels in each ring (rings may be empty)
+};
+
+// rings are Rings' levels around its gaze (with its pixel radii & aspect), both images must be the same size
+Score Compare(const FovReference::Image &Reference, const FovReference::Image &Test,
+              const FovReference::Pattern &Rings);
+
+} // namespace ImageQuality
+
+#endif
@@ -0,0 +1,132 @@
+#include "input_thread.h"
+#include "gaze.h"
+#include "timeline.h"
+#include <iostream>
+#include <thread>
+
+namespace
+{
+
+// keys of every action (either one triggers it)
+struct Binding
+{
+    InputTrace::Action Action;
+    int Keys[2];
+};
+const Binding Bindings[] = {
+    {InputTrace::Action::Reload, {GLFW_KEY_R, GLFW_KEY_R}},
+    {InputTrace::Action::PrevShader, {GLFW_KEY_LEFT, GLFW_KEY_A}},
+    {InputTrace::Action::NextShader, {GLFW_KEY_RIGHT, GLFW_KEY_D}},
+    {InputTrace::Action::StrideUp, {GLFW_KEY_UP, GLFW_KEY_W}},
+    {InputTrace::Action::StrideDown, {GLFW_KEY_DOWN, GLFW_KEY_S}},
+    {InputTrace::Action::TogglePostprocessing, {GLFW_KEY_TAB, GLFW_KEY_ENTER}},
+    {InputTrace::Action::TogglePause, {GLFW_KEY_SPACE, GLFW_KEY_SPACE}},
+    {InputTrace::Action::ToggleCapture, {GLFW_KEY_C, GLFW_KEY_C}},
+    {InputTrace::Action::DumpTimeline, {GLFW_KEY_T, GLFW_KEY_T}},
+};
+
+} // namespace
+
+bool InputThread::Run(GLFWwindow *const Win, const std::function<bool()> &Render)
+{
+    Window = Win;
+    Timeline::NameThread("main (input)"); // where the startup spans (first shader builds) are too
+    Poll(); // the first frame already has a state
+    bRendering = true;
+    bool bResult = false;
+    glfwMakeContextCurrent(nullptr);
+    std::thread RenderThread([&] {
+        glfwMakeContextCurrent(Window);
+        bResult = Render();
+        glfwMakeContextCurrent(nullptr);
+        bRendering = false;
+        glfwPostEmptyEvent(); // wakes up the loop below
+    });
+
+    // nothing to do between events, the render thread wakes it up for its requests
+    while (bRendering)
+    {
+        glfwWaitEvents();
+        Poll();
+    }
+    RenderThread.join();
+    glfwMakeContextCurrent(Window);
+    return bResult;
+}
+
+bool InputThread::PopAction(InputTrace::Action &A)
+{
+    const size_t T = Tail.load(std::memory_order_relaxed);
+    if (T == Head.load(std::memory_order_acquire))
+        return false;
+    A = Actions[T];
+    Tail.store((T + 1) % Capacity, std::memory_order_release); // hands the slot back to the input thread
+    return true;
+}
+
+void InputThread::SetTitle(const std::string &T)
+{
+    Title.Write(T);
+    glfwPostEmptyEvent();
+}
+
+void InputThread::SetWindowSize(const int W, const int H)
+{
+    Size.Write({W, H});
+    glfwPostEmptyEvent();
+}
+
+void InputThread::Poll()
+{
+    InputState S;
+    S.Time = Gaze::Now();
+    glfwGetFramebufferSize(Window, &S.W, &S.H);
+    glfwGetCursorPos(Window, &S.MouseX, &S.MouseY);
+#ifdef __APPLE__
+    /// HACK: special case for MacOS hiDPI monitors which exactly 2x or 1/2x the dpi between hi and lo dpi displays
+    int ExpectedWindowW, ExpectedWindowH;
+    glfwGetWindowSize(Window, &ExpectedWindowW, &ExpectedWindowH);
+    const bool bHiDPI = (ExpectedWindowH == S.H / 2 && ExpectedWindowW == S.W / 2);
+    if (bHiDPI && !bIsHiDPI)
+        std::cout << "Detected hiDPI display" << std::endl;
+    bIsHiDPI = bHiDPI;
+#endif
+    if (bIsHiDPI)
+    {
+        S.MouseX *= 2;
+        S.MouseY *= 2;
+    }
+    S.bMouseDown = glfwGetMouseButton(Window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+    State.Write(S);
+
+    // check for closing window
+    if (glfwGetKey(Window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+        glfwSetWindowShouldClose(Window, true);
+
+    // rising edges, caught between frames too
+    for (const Binding &B : Bindings)
+    {
+        bool &bWasPressed = bPressed[static_cast<int>(B.Action)];
+        const bool bPress =
+            (glfwGetKey(Window, B.Keys[0]) == GLFW_PRESS || glfwGetKey(Window, B.Keys[1]) == GLFW_PRESS);
+        if (bPress && !bWasPressed)
+        {
+            const size_t H = Head.load(std::memory_order_relaxed);
+            const size_t Next = (H + 1) % Capacity;
+            if (Next != Tail.load(std::memory_order_acquire)) // dropped if the render thread is that far behind
+            {
+                Actions[H] = B.Action;
+                Head.store(Next, std::memory_order_release); // publishes the action
+            }
+        }
+        bWasPressed = bPress;
+    }
+
+    // requests of the render thread
+    std::string T;
+    if (Title.Read(T))
+        glfwSetWindowTitle(Window, T.c_str());
+    std::array<int, 2> WH;
+    if (Size.Read(WH))
+        glfwSetWindowSize(Window, WH[0], WH[1]);
+}
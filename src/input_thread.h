@@ -0,0 +1,83 @@
+#ifndef INPUT_THREAD_H
+#define INPUT_THREAD_H
+
+#include "gl_headers.h"
+#include "input_trace.h"
+#include <array>
+#include <atomic>
+#include <functional>
+#include <string>
+
+// The window's event loop. GLFW only polls events (and the keys & cursor) on the main thread, so that one becomes
+// the input thread and the frames are rendered on a thread of their own, with the context current there. Inputs
+// go to the render thread and requests (title, size) come back without locks, neither side ever waits on the
+// other, so the render thread can latch the cursor right before it submits a frame.
+
+// single writer, single reader. The reader gets the latest complete value (a triple buffer, the slot being
+// written, the one in the middle & the one being read are always different)
+template <typename T> class Latest
+{
+  public:
+    void Write(const T &Value)
+    {
+        Slots[Back] = Value;
+        // publishes the written slot, takes the one the reader left behind
+        Back = Middle.exchange(Back | Fresh, std::memory_order_acq_rel) & ~Fresh;
+    }
+    bool Read(T &Value) // false (and Value untouched) if nothing was written since the last read
+    {
+        if ((Middle.load(std::memory_order_relaxed) & Fresh) == 0)
+            return false;
+        Front = Middle.exchange(Front, std::memory_order_acq_rel) & ~Fresh;
+        Value = Slots[Front];
+        return true;
+    }
+
+  private:
+    static constexpr unsigned Fresh = 4; // set in Middle when it holds a value the reader hasn't seen
+    std::array<T, 3> Slots = {};
+    std::atomic<unsigned> Middle{1};
+    unsigned Back = 0;  // the writer's
+    unsigned Front = 2; // the reader's
+};
+
+// what the render thread needs from the window, as last polled
+struct InputState
+{
+    double Time = 0.0;                 // Gaze::Now() when it was polled
+    int W = 0, H = 0;                  // framebuffer size
+    double MouseX = 0.0, MouseY = 0.0; // cursor in framebuffer pixels, y down
+    bool bMouseDown = false;           // left button
+};
+
+class InputThread
+{
+  public:
+    // polls events on this (the main) thread until Render returns, Render runs on its own thread with Window's
+    // context current. The context is current on this thread again afterwards
+    bool Run(GLFWwindow *Window, const std::function<bool()> &Render);
+
+    // render thread
+    bool Read(InputState &S) { return State.Read(S); }
+    bool PopAction(InputTrace::Action &A); // the key actions in the order they were pressed, false once empty
+    void SetTitle(const std::string &Title);
+    void SetWindowSize(int W, int H);
+
+  private:
+    void Poll(); // input thread
+
+    GLFWwindow *Window = nullptr;
+    Latest<InputState> State;
+    Latest<std::string> Title;
+    Latest<std::array<int, 2>> Size;
+    // key actions, single producer (the input thread) single consumer (the render thread)
+    static constexpr size_t Capacity = 64;
+    std::array<InputTrace::Action, Capacity> Actions;
+    std::atomic<size_t> Head{0}; // next slot written by the input thread
+    std::atomic<size_t> Tail{0}; // next slot read by the render thread
+    bool bPressed[static_cast<int>(InputTrace::Action::NumActions)] = {}; // rising edges of the bindings
+    bool bIsHiDPI = false;
+    std::atomic<bool> bRendering{false};
+};
+
+#endif
@@ -0,0 +1,254 @@
+#include "input_trace.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+namespace InputTrace
+{
+
+static const char Magic[8] = {'F', 'O', 'V', 'T', 'R', 'A', 'C', 'E'};
+static constexpr uint32_t Version = 2; // 1 had exactly three radii, no keep ratios or aspect
+
+// frame record flags
+enum : uint8_t
+{
+    FlagMouseDown = 1 << 0,
+    FlagResize = 1 << 1,
+    FlagActions = 1 << 2,
+};
+
+// header flags
+enum : uint8_t
+{
+    FlagPostProcessing = 1 << 0,
+    FlagFovRender = 1 << 1,
+};
+
+// explicitly little endian, so traces move between machines
+static void PutU8(std::vector<uint8_t> &Buf, const uint8_t v)
+{
+    Buf.push_back(v);
+}
+
+static void PutU16(std::vector<uint8_t> &Buf, const uint16_t v)
+{
+    Buf.push_back(static_cast<uint8_t>(v));
+    Buf.push_back(static_cast<uint8_t>(v >> 8));
+}
+
+static void PutU32(std::vector<uint8_t> &Buf, const uint32_t v)
+{
+    for (int Shift = 0; Shift < 32; Shift += 8)
+        Buf.push_back(static_cast<uint8_t>(v >> Shift));
+}
+
+static void PutF32(std::vector<uint8_t> &Buf, const float v)
+{
+    uint32_t Bits;
+    std::memcpy(&Bits, &v, sizeof(Bits));
+    PutU32(Buf, Bits);
+}
+
+static void PutUnorm(std::vector<uint8_t> &Buf, const float v)
+{
+    PutU16(Buf, static_cast<uint16_t>(std::lround(std::clamp(v, 0.f, 1.f) * 65535.f)));
+}
+
+// reads from a buffer, latching bOk to false once it runs out
+struct Cursor
+{
+    const std::vector<uint8_t> &Buf;
+    size_t Pos = 0;
+    bool bOk = true;
+
+    uint32_t Get(const int NumBytes)
+    {
+        if (Pos + NumBytes > Buf.size())
+        {
+            bOk = false;
+            return 0;
+        }
+        uint32_t v = 0;
+        for (int i = 0; i < NumBytes; i++)
+            v |= static_cast<uint32_t>(Buf[Pos++]) << (8 * i);
+        return v;
+    }
+    uint8_t U8() { return static_cast<uint8_t>(Get(1)); }
+    uint16_t U16() { return static_cast<uint16_t>(Get(2)); }
+    uint32_t U32() { return Get(4); }
+    float F32()
+    {
+        const uint32_t Bits = U32();
+        float v;
+        std::memcpy(&v, &Bits, sizeof(v));
+        return v;
+    }
+    float Unorm() { return U16() / 65535.f; }
+};
+
+bool Writer::Open(const std::string &TracePath, const Header &H)
+{
+    Path = TracePath;
+    Out = fopen(Path.c_str(), "wb");
+    if (Out == nullptr)
+    {
+        std::cerr << "can't open \"" << Path << "\" to record the inputs" << std::endl;
+        return false;
+    }
+    std::vector<uint8_t> Buf(Magic, Magic + sizeof(Magic));
+    PutU32(Buf, Version);
+    const uint16_t NameLen = static_cast<uint16_t>(std::min<size_t>(H.Shader.size(), UINT16_MAX));
+    PutU16(Buf, NameLen);
+    Buf.insert(Buf.end(), H.Shader.begin(), H.Shader.begin() + NameLen);
+    PutU32(Buf, static_cast<uint32_t>(H.Stride));
+    PutU8(Buf, static_cast<uint8_t>(H.Keep.size()));
+    for (const float r : H.Radii)
+        PutF32(Buf, r);
+    for (const float k : H.Keep)
+        PutF32(Buf, k);
+    PutF32(Buf, H.Aspect);
+    PutU8(Buf, (H.bPostProcessing ? FlagPostProcessing : 0) | (H.bFovRender ? FlagFovRender : 0));
+    fwrite(Buf.data(), 1, Buf.size(), Out);
+    NumFrames = 0;
+    std::cout << "Recording inputs to \"" << Path << "\"" << std::endl;
+    return true;
+}
+
+void Writer::Write(const Frame &F)
+{
+    if (Out == nullptr)
+        return;
+    const bool bResize = (F.W > 0 && F.H > 0);
+    const bool bActions = !F.Actions.empty();
+    std::vector<uint8_t> Buf;
+    PutU8(Buf, (F.bMouseDown ? FlagMouseDown : 0) | (bResize ? FlagResize : 0) | (bActions ? FlagActions : 0));
+    PutF32(Buf, F.Dt);
+    PutUnorm(Buf, F.GazeX);
+    PutUnorm(Buf, F.GazeY);
+    PutUnorm(Buf, F.MouseX);
+    PutUnorm(Buf, F.MouseY);
+    if (bResize)
+    {
+        PutU32(Buf, static_cast<uint32_t>(F.W));
+        PutU32(Buf, static_cast<uint32_t>(F.H));
+    }
+    if (bActions)
+    {
+        const size_t Count = std::min<size_t>(F.Actions.size(), UINT8_MAX);
+        PutU8(Buf, static_cast<uint8_t>(Count));
+        for (size_t i = 0; i < Count; i++)
+            PutU8(Buf, static_cast<uint8_t>(F.Actions[i]));
+    }
+    fwrite(Buf.data(), 1, Buf.size(), Out);
+    NumFrames++;
+}
+
+bool Writer::Close()
+{
+    if (Out == nullptr)
+        return true;
+    const bool bOk = (fclose(Out) == 0);
+    Out = nullptr;
+    std::cout << "Recorded " << NumFrames << " frames to \"" << Path << "\"" << std::endl;
+    return bOk;
+}
+
+bool Load(const std::string &Path, Header &H, std::vector<Frame> &Frames)
+{
+    FILE *In = fopen(Path.c_str(), "rb");
+    if (In == nullptr)
+    {
+        std::cerr << "can't open the input trace \"" << Path << "\"" << std::endl;
+        return false;
+    }
+    std::vector<uint8_t> Buf;
+    uint8_t Chunk[4096];
+    for (size_t Len; (Len = fread(Chunk, 1, sizeof(Chunk), In)) > 0;)
+        Buf.insert(Buf.end(), Chunk, Chunk + Len);
+    fclose(In);
+
+    Cursor C{Buf};
+    if (Buf.size() < sizeof(Magic) || std::memcmp(Buf.data(), Magic, sizeof(Magic)) != 0)
+    {
+        std::cerr << "\"" << Path << "\" is not an input trace" << std::endl;
+        return false;
+    }
+    C.Pos = sizeof(Magic);
+    const uint32_t FileVersion = C.U32();
+    if (FileVersion != Version && FileVersion != 1)
+    {
+        std::cerr << "unsupported input trace version " << FileVersion << " in \"" << Path << "\"" << std::endl;
+        return false;
+    }
+    const uint16_t NameLen = C.U16();
+    if (C.Pos + NameLen <= Buf.size())
+        H.Shader.assign(Buf.begin() + C.Pos, Buf.begin() + C.Pos + NameLen);
+    C.Pos += NameLen;
+    const uint32_t Stride = C.U32();
+    const int NumLevels = (FileVersion == 1) ? 4 : C.U8();
+    H.Radii.resize(std::max(NumLevels - 1, 0));
+    for (float &r : H.Radii)
+        r = C.F32();
+    H.Keep.clear();
+    if (FileVersion > 1)
+    {
+        H.Keep.resize(NumLevels);
+        for (float &k : H.Keep)
+            k = C.F32();
+        H.Aspect = C.F32();
+    }
+    const uint8_t HeaderFlags = C.U8();
+    H.bPostProcessing = (HeaderFlags & FlagPostProcessing) != 0;
+    H.bFovRender = (HeaderFlags & FlagFovRender) != 0;
+    if (!C.bOk)
+    {
+        std::cerr << "truncated header in \"" << Path << "\"" << std::endl;
+        return false;
+    }
+    // checked before it's narrowed, CheckFovProfile checks the rest of the profile when it's applied
+    if (Stride < 2 || Stride > 256 || Stride % 2 != 0)
+    {
+        std::cerr << "invalid stride " << Stride << " in the header of \"" << Path << "\"" << std::endl;
+        return false;
+    }
+    H.Stride = static_cast<int>(Stride);
+
+    Frames.clear();
+    while (C.Pos < Buf.size())
+    {
+        Frame F;
+        const uint8_t Flags = C.U8();
+        F.bMouseDown = (Flags & FlagMouseDown) != 0;
+        F.Dt = C.F32();
+        F.GazeX = C.Unorm();
+        F.GazeY = C.Unorm();
+        F.MouseX = C.Unorm();
+        F.MouseY = C.Unorm();
+        if (Flags & FlagResize)
+        {
+            F.W = static_cast<int>(C.U32());
+            F.H = static_cast<int>(C.U32());
+        }
+        if (Flags & FlagActions)
+        {
+            for (int Count = C.U8(); Count > 0; Count--)
+            {
+                const uint8_t A = C.U8();
+                if (A < static_cast<uint8_t>(Action::NumActions))
+                    F.Actions.push_back(static_cast<Action>(A));
+            }
+        }
+        if (!C.bOk)
+        {
+            // ex. the recording was killed mid-write, everything before is still fine
+            std::cerr << "ignoring the truncated last frame of \"" << Path << "\"" << std::endl;
+            break;
+        }
+        Frames.push_back(F);
+    }
+    std::cout << "Loaded " << Frames.size() << " frames from \"" << Path << "\"" << std::endl;
+    return !Frames.empty();
+}
+
+} // namespace InputTrace
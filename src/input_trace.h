@@ -0,0 +1,74 @@
+#ifndef INPUT_TRACE_H
+#define INPUT_TRACE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Everything the interactive renderer reacts to, recorded per frame into a compact binary file so a session can
+// be replayed exactly (same gaze path, resizes, key actions & clock) to compare performance across builds.
+//
+// Layout (little endian): "FOVTRACE", u32 version, the Header (u16 shader name length & name, u32 stride,
+// u8 level count, f32 radii & keep ratios, f32 aspect, u8 flags), then one record per frame of
+//   u8 flags, f32 clock delta, u16 gaze x & y, u16 mouse x & y (normalized to 0..65535, y down)
+//   [i32 width, i32 height if FlagResize] [u8 count, u8 actions... if FlagActions]
+namespace InputTrace
+{
+
+// key actions (bound in input_thread.cpp)
+enum class Action : uint8_t
+{
+    Reload,
+    PrevShader,
+    NextShader,
+    StrideUp,
+    StrideDown,
+    TogglePostprocessing,
+    TogglePause,
+    ToggleCapture,
+    DumpTimeline,
+    NumActions
+};
+
+// state at the start of the recording
+struct Header
+{
+    std::string Shader; // file name of the main shader
+    int Stride = 16;
+    std::vector<float> Radii, Keep; // foveation profile (version 1 only has three radii and no keep ratios)
+    float Aspect = 1.f;
+    bool bFovRender = true;
+    bool bPostProcessing = true;
+};
+
+struct Frame
+{
+    float Dt = 0.f;                 // wall clock delta at the end of the frame (seconds, paused or not)
+    float GazeX = 0.f, GazeY = 0.f; // foveal center the frame was rendered with (normalized, y down)
+    float MouseX = 0.f, MouseY = 0.f;
+    bool bMouseDown = false;
+    int W = 0, H = 0;            // new framebuffer size, 0 if unchanged
+    std::vector<Action> Actions; // triggered after rendering the frame
+};
+
+class Writer
+{
+  public:
+    bool Open(const std::string &Path, const Header &H);
+    void Write(const Frame &F);
+    bool Close();
+    bool IsOpen() const { return Out != nullptr; }
+
+  private:
+    FILE *Out = nullptr;
+    std::string Path;
+    int NumFrames = 0;
+};
+
+// the whole trace at once (a minute at 60 fps is about 50 kB)
+bool Load(const std::string &Path, Header &H, std::vector<Frame> &Frames);
+
+} // namespace InputTrace
+
+#endif
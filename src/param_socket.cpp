@@ -0,0 +1,58 @@
+#include "param_socket.h"
+#include "utils.h"
+#include <cstdio>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+bool ParamSocket::Open(const std::string &Path)
+{
+    sockaddr_un Addr = {};
+    Addr.sun_family = AF_UNIX;
+    if (Path.empty() || Path.size() >= sizeof(Addr.sun_path))
+        return false;
+    std::copy(Path.begin(), Path.end(), Addr.sun_path);
+    Fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    unlink(Path.c_str()); // left behind by an earlier run
+    if (Fd >= 0 && bind(Fd, reinterpret_cast<sockaddr *>(&Addr), sizeof(Addr)) == 0)
+    {
+        UnixPath = Path;
+        std::cout << "Taking params on \"" << Path << "\"" << std::endl;
+        return true;
+    }
+    perror("params socket");
+    Close();
+    return false;
+}
+
+void ParamSocket::Close()
+{
+    if (Fd >= 0)
+        close(Fd);
+    Fd = -1;
+    if (!UnixPath.empty())
+        unlink(UnixPath.c_str());
+    UnixPath.clear();
+}
+
+std::vector<std::pair<std::string, std::string>> ParamSocket::Poll()
+{
+    std::vector<std::pair<std::string, std::string>> Pairs;
+    if (Fd < 0)
+        return Pairs;
+    char Buf[4096];
+    ssize_t Len;
+    while ((Len = recv(Fd, Buf, sizeof(Buf), 0)) > 0)
+    {
+        std::istringstream Lines(std::string(Buf, Len));
+        std::string Line;
+        std::pair<std::string, std::string> Pair;
+        while (std::getline(Lines, Line))
+        {
+            if (ParseParamLine(Line, Pair))
+                Pairs.push_back(Pair);
+        }
+    }
+    return Pairs;
+}
@@ -0,0 +1,26 @@
+#ifndef PARAM_SOCKET_H
+#define PARAM_SOCKET_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+// Live params updates over a local unix datagram socket (params_socket). Every datagram holds key=value lines
+// like the params file, ex. printf 'stride=8\nfov_radii=0.1,0.2,0.3' | socat - UNIX-SENDTO:/tmp/fovrender.sock
+// Polled between frames without blocking, Renderer::SetParams applies them
+class ParamSocket
+{
+  public:
+    ~ParamSocket() { Close(); }
+
+    bool Open(const std::string &Path);
+    void Close();
+    bool IsOpen() const { return Fd >= 0; }
+    std::vector<std::pair<std::string, std::string>> Poll(); // everything received since the last call
+
+  private:
+    std::string UnixPath; // removed again on close
+    int Fd = -1;
+};
+
+#endif
@@ -0,0 +1,443 @@
+#include "pass_graph.h"
+#include "shader_cache.h"
+#include <filesystem>
+#include <iostream>
+
+const char *const PassGraph::ImageShader = "image.glsl";
+
+bool PassGraph::IsMultipass(const std::string &Path)
+{
+    std::error_code Err;
+    return std::filesystem::is_regular_file(std::filesystem::path(Path) / "passes.ini", Err);
+}
+
+bool PassGraph::DropsBuffers(const ParamsStruct &P)
+{
+    // buffers are reconstructed spatially (the temporal history & stencil mask are the image's), otherwise they
+    // render every pixel
+    const FRShaderParams &FR = P.FRParams;
+    return P.bEnableFovRender && FR.Strategy == FovStrategy::Checkerboard && !FR.bStencilMask &&
+           FR.Reconstruction == ReconstructionMode::Spatial;
+}
+
+bool PassGraph::Parse(const std::string &Dir, std::vector<Pass> &Passes, const bool bReport)
+{
+    const std::string Ini = (std::filesystem::path(Dir) / "passes.ini").string();
+    const auto Fail = [&](const std::string &Error) {
+        if (bReport)
+            std::cerr << "\"" << Ini << "\": " << Error << std::endl;
+        return false;
+    };
+    std::ifstream Input(Ini);
+    if (!Input.is_open())
+        return Fail("can't read it");
+
+    // one [section] per pass, the buffers render in the order they're declared
+    Pass Image;
+    Image.Name = "image";
+    Image.Path = (std::filesystem::path(Dir) / ImageShader).string();
+    std::vector<std::array<std::string, NumChannels>> Reads; // channel names of every buffer, then the image's
+    std::array<std::string, NumChannels> ImageReads;
+    Pass *Current = nullptr;
+    std::array<std::string, NumChannels> *CurrentReads = nullptr;
+    std::string Line;
+    std::pair<std::string, std::string> Pair;
+    while (std::getline(Input, Line))
+    {
+        const size_t Open = Line.find_first_not_of(" \t");
+        if (Open != std::string::npos && Line[Open] == '[')
+        {
+            const size_t Close = Line.find(']', Open);
+            const std::string Name = Line.substr(Open + 1, Close == std::string::npos ? Close : Close - Open - 1);
+            if (Name == Image.Name)
+            {
+                Current = &Image;
+                CurrentReads = &ImageReads;
+                continue;
+            }
+            for (const Pass &B : Passes)
+            {
+                if (B.Name == Name)
+                    return Fail("[" + Name + "] is declared twice");
+            }
+            Passes.emplace_back();
+            Reads.emplace_back();
+            Current = &Passes.back();
+            CurrentReads = &Reads.back();
+            Current->Name = Name;
+            Current->Path = (std::filesystem::path(Dir) / (Name + ".glsl")).string();
+            continue;
+        }
+        if (!ParseParamLine(Line, Pair))
+            continue;
+        const std::string &Key = Pair.first, &Value = Pair.second;
+        if (Current == nullptr)
+            return Fail("\"" + Key + "\" is outside of a [pass]");
+        if (Key == "shader")
+            Current->Path = (std::filesystem::path(Dir) / Value).string();
+        else if (Key.size() == 9 && Key.compare(0, 8, "iChannel") == 0 && Key[8] >= '0' &&
+                 Key[8] < '0' + NumChannels)
+            (*CurrentReads)[Key[8] - '0'] = Value;
+        else if (Key == "foveated")
+            Current->bFoveated = stob(Value);
+        else if (Key == "resolution" && (Value == "full" || Value == "half" || Value == "quarter"))
+            Current->Level = (Value == "full") ? 0 : (Value == "half") ? 1 : 2;
+        else
+            return Fail("unknown key \"" + Key + "=" + Value + "\" in [" + Current->Name + "]");
+    }
+    if (Passes.empty())
+        return Fail("no buffer passes, a single .glsl is enough for that");
+    if (bReport && (Image.Level != 0 || Image.bFoveated))
+        std::cerr << "\"" << Ini << "\": the image renders like any main shader, ignoring its resolution & foveated"
+                  << std::endl;
+    Image.Level = 0;
+    Image.bFoveated = false;
+    if (!sameFile(Image.Path, (std::filesystem::path(Dir) / ImageShader).string()))
+        return Fail(std::string("the image pass is always ") + ImageShader);
+    Reads.push_back(ImageReads);
+    Passes.push_back(std::move(Image));
+
+    // the channels by index, anything read before (or while) it renders is last frame's
+    for (size_t Idx = 0; Idx < Passes.size(); Idx++)
+    {
+        Pass &Reader = Passes[Idx];
+        if (!std::filesystem::is_regular_file(Reader.Path))
+            return Fail("can't find \"" + Reader.Path + "\" of [" + Reader.Name + "]");
+        if (Reader.bFoveated && Reader.Level > 0)
+        {
+            if (bReport)
+                std::cerr << "\"" << Ini << "\": [" << Reader.Name
+                          << "] is rendered at a reduced resolution, not foveated" << std::endl;
+            Reader.bFoveated = false;
+        }
+        for (int C = 0; C < NumChannels; C++)
+        {
+            const std::string &Name = Reads[Idx][C];
+            if (Name.empty())
+                continue;
+            const auto Buffers = Passes.end() - 1;
+            const auto It = std::find_if(Passes.begin(), Buffers, [&](const Pass &B) { return B.Name == Name; });
+            if (It == Buffers)
+                return Fail("iChannel" + std::to_string(C) + " of [" + Reader.Name + "] reads \"" + Name +
+                            "\", which isn't a buffer");
+            const int Read = static_cast<int>(It - Passes.begin());
+            Reader.Channels[C] = Read;
+            if (Read >= static_cast<int>(Idx))
+                Passes[Read].bFeedback = true;
+            else
+                Passes[Read].LastReader = std::max(Passes[Read].LastReader, static_cast<int>(Idx));
+        }
+    }
+
+    return true;
+}
+
+std::vector<ShaderUtils::Shader> PassGraph::BufferSources(const Pass &B, const ParamsStruct &P, const std::string &D)
+{
+    std::vector<ShaderUtils::Shader> Sources = {
+        ShaderUtils::Shader(P.MainParams.vertex_shader_path, "vertex", GL_VERTEX_SHADER, D),
+        ShaderUtils::Shader(B.Path, "main", GL_FRAGMENT_SHADER, D),
+    };
+    if (!D.empty())
+    {
+        Sources.push_back(ShaderUtils::Shader(P.FRParams.drop_shader, "fragment", GL_FRAGMENT_SHADER, D));
+        Sources.push_back(ShaderUtils::Shader(P.FRParams.common_shader, "common", GL_FRAGMENT_SHADER, D));
+    }
+    else
+        Sources.push_back(
+            ShaderUtils::Shader(P.MainParams.non_fr_fragment_shader_path, "fragment", GL_FRAGMENT_SHADER, D));
+    return Sources;
+}
+
+std::string PassGraph::BufferJob(const std::vector<ShaderUtils::Shader> &Sources)
+{
+    std::string Name = "buffer";
+    for (const ShaderUtils::Shader &S : Sources)
+        Name += ":" + S.file_path;
+    return Name + ":" + Sources.front().defines;
+}
+
+void PassGraph::Submit(const std::vector<Pass> &Passes, const ParamsStruct &P, const std::string &FovDefines,
+                       ShaderUtils::Precompiler *Background)
+{
+    if (Background == nullptr || !Background->IsAsync())
+        return;
+    for (size_t Idx = 0; Idx + 1 < Passes.size(); Idx++)
+    {
+        const bool bDropped = DropsBuffers(P) && Passes[Idx].bFoveated; // reduced resolution ones aren't (Parse)
+        const std::vector<ShaderUtils::Shader> Sources = BufferSources(Passes[Idx], P, bDropped ? FovDefines : "");
+        Background->Submit(BufferJob(Sources), Sources); // nothing if it's queued already
+    }
+}
+
+void PassGraph::Precompile(const std::string &Path, const ParamsStruct &P, const std::string &FovDefines,
+                           ShaderUtils::Precompiler *Background)
+{
+    // quietly, Load reports the errors if it's picked
+    std::vector<Pass> Passes;
+    if (NumViews(P) == 1 && IsMultipass(Path) && Parse(Path, Passes, false))
+        Submit(Passes, P, FovDefines, Background);
+}
+
+bool PassGraph::Load(const std::string &Path, const ParamsStruct &P, const std::string &FovDefines,
+                     ShaderUtils::Precompiler *Background)
+{
+    Clear();
+    Dir = Path; // even if this fails, so it isn't retried every frame
+    bDrops = DropsBuffers(P);
+    Views = NumViews(P);
+    if (!IsMultipass(Dir))
+        return false;
+    const std::string Ini = (std::filesystem::path(Dir) / "passes.ini").string();
+    if (Views > 1)
+    {
+        std::cerr << "\"" << Ini << "\": multipass shaders render a single view (views=1)" << std::endl;
+        return false;
+    }
+    if (!Parse(Dir, Passes, true))
+    {
+        Passes.clear();
+        return false;
+    }
+
+    // the buffer programs (the image is Main's) build in the background, all at once unless PrecompileAll queued
+    // them already, and are taken like MainProgram::Select does
+    Submit(Passes, P, FovDefines, Background);
+    for (int Idx = 0; Idx < NumBuffers(); Idx++)
+    {
+        Pass &B = Passes[Idx];
+        const std::vector<ShaderUtils::Shader> Sources = BufferSources(B, P, IsDropped(Idx) ? FovDefines : "");
+        B.Prog = std::make_unique<ShaderUtils::Program>();
+        B.Prog->SetPrecompiler(Background);
+        if (!B.Prog->LoadPrecompiled(Sources, BufferJob(Sources)))
+        {
+            std::cerr << "\"" << Ini << "\": can't build [" << B.Name << "]" << std::endl;
+            Passes.clear();
+            return false;
+        }
+    }
+
+    std::cout << "Multipass shader \"" << Dir << "\":";
+    for (const Pass &B : Passes)
+    {
+        std::cout << " [" << B.Name << "]";
+        if (B.Level > 0)
+            std::cout << " 1/" << (1 << B.Level);
+        if (B.bFoveated)
+            std::cout << (bDrops ? " foveated" : " (not foveated)");
+        if (B.bFeedback)
+            std::cout << " feedback";
+    }
+    std::cout << std::endl;
+    return true;
+}
+
+void PassGraph::Clear()
+{
+    Free();
+    Passes.clear();
+    Dir.clear();
+    Parity = 0;
+}
+
+bool PassGraph::IsCurrent(const std::string &Path, const ParamsStruct &P) const
+{
+    return !Dir.empty() && Dir == Path && bDrops == DropsBuffers(P) && Views == NumViews(P);
+}
+
+int PassGraph::NumBuffers() const
+{
+    return IsLoaded() ? static_cast<int>(Passes.size()) - 1 : 0;
+}
+
+PassGraph::Pass &PassGraph::Buffer(const int Idx)
+{
+    assert(Idx < NumBuffers());
+    return Passes[Idx];
+}
+
+bool PassGraph::IsDropped(const int Idx) const
+{
+    return bDrops && Passes[Idx].bFoveated && Passes[Idx].Level == 0;
+}
+
+bool PassGraph::HasDropped() const
+{
+    for (int Idx = 0; Idx < NumBuffers(); Idx++)
+    {
+        if (IsDropped(Idx))
+            return true;
+    }
+    return false;
+}
+
+void PassGraph::Allocate(const int W, const int H)
+{
+    if (!IsLoaded() || (!Pool.empty() && W == PoolW && H == PoolH))
+        return;
+    Free();
+    PoolW = W;
+    PoolH = H;
+
+    // assign targets in pass order, a target is taken by the next pass (of the same size) once its last reader
+    // rendered. Feedback pairs are never handed on, and a foveated pass only needs its scratch while it renders
+    std::vector<bool> Busy;
+    const auto Acquire = [&](const int TW, const int TH) {
+        for (size_t T = 0; T < Pool.size(); T++)
+        {
+            if (!Busy[T] && Pool[T].W == TW && Pool[T].H == TH)
+            {
+                Busy[T] = true;
+                return static_cast<int>(T);
+            }
+        }
+        Pool.push_back({0, 0, TW, TH});
+        Busy.push_back(true);
+        return static_cast<int>(Pool.size()) - 1;
+    };
+    size_t Unaliased = 0; // bytes if every pass had targets of its own
+    for (int Idx = 0; Idx < NumBuffers(); Idx++)
+    {
+        Pass &B = Passes[Idx];
+        const int TW = std::max(W >> B.Level, 1), TH = std::max(H >> B.Level, 1);
+        B.Target[0] = Acquire(TW, TH);
+        B.Target[1] = B.bFeedback ? Acquire(TW, TH) : B.Target[0];
+        B.Scratch = IsDropped(Idx) ? Acquire(W, H) : -1;
+        Unaliased += size_t(TW) * TH * (B.bFeedback ? 2 : 1) + (IsDropped(Idx) ? size_t(W) * H : 0);
+        if (B.Scratch >= 0)
+            Busy[B.Scratch] = false;
+        for (int Read = 0; Read <= Idx; Read++)
+        {
+            if (!Passes[Read].bFeedback && std::max(Passes[Read].LastReader, Read) == Idx)
+                Busy[Passes[Read].Target[0]] = false; // read for the last time (or never)
+        }
+    }
+
+    size_t Bytes = 0;
+    for (Target &T : Pool)
+    {
+        // half floats, so feedback can accumulate past 1 & below 1/255
+        glGenTextures(1, &T.Tex);
+        glBindTexture(GL_TEXTURE_2D, T.Tex);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, T.W, T.H, 0, GL_RGBA, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glGenFramebuffers(1, &T.FBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, T.FBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, T.Tex, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cerr << "can't initialize a " << T.W << "x" << T.H << " buffer target" << std::endl;
+        glClearColor(0.f, 0.f, 0.f, 0.f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        Bytes += size_t(T.W) * T.H * 8;
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    std::cout << "Multipass targets at (" << W << " x " << H << "): " << Pool.size() << " for " << NumBuffers()
+              << " buffers, " << Bytes / (1024 * 1024) << "MB (" << Unaliased * 8 / (1024 * 1024)
+              << "MB without sharing)" << std::endl;
+}
+
+void PassGraph::Free()
+{
+    for (const Target &T : Pool)
+    {
+        glDeleteFramebuffers(1, &T.FBO);
+        glDeleteTextures(1, &T.Tex);
+    }
+    Pool.clear();
+    PoolW = PoolH = 0;
+}
+
+GLuint PassGraph::Framebuffer(const int T) const
+{
+    return Pool.at(T).FBO;
+}
+
+GLuint PassGraph::Texture(const int T) const
+{
+    return Pool.at(T).Tex;
+}
+
+int PassGraph::Output(const int Idx) const
+{
+    return Passes[Idx].Target[Passes[Idx].bFeedback ? Parity : 0];
+}
+
+void PassGraph::BindChannels(const ShaderUtils::Program &P, const int Idx) const
+{
+    if (!IsLoaded() || Pool.empty())
+        return;
+    // the sampler units are fixed per link (Program::CacheUniforms)
+    float Resolution[NumChannels * 2] = {};
+    for (int C = 0; C < NumChannels; C++)
+    {
+        const int Read = Passes[Idx].Channels[C];
+        if (Read < 0)
+            continue;
+        const Pass &B = Passes[Read];
+        const int T = (B.bFeedback && Read >= Idx) ? B.Target[1 - Parity] : Output(Read);
+        glActiveTexture(GL_TEXTURE1 + C);
+        glBindTexture(GL_TEXTURE_2D, Pool[T].Tex);
+        Resolution[C * 2] = static_cast<float>(Pool[T].W);
+        Resolution[C * 2 + 1] = static_cast<float>(Pool[T].H);
+    }
+    glActiveTexture(GL_TEXTURE0);
+    glUniform2fv(P.GetUniform(ShaderUtils::UniformChannelResolution), NumChannels, Resolution);
+}
+
+void PassGraph::EndFrame()
+{
+    Parity = 1 - Parity;
+}
+
+void PassGraph::SetDefines(const std::string &D)
+{
+    for (int Idx = 0; Idx < NumBuffers(); Idx++)
+    {
+        if (IsDropped(Idx))
+            Passes[Idx].Prog->SetDefines(D);
+    }
+}
+
+void PassGraph::Prebuild(const std::string &D)
+{
+    for (int Idx = 0; Idx < NumBuffers(); Idx++)
+    {
+        if (IsDropped(Idx))
+            Passes[Idx].Prog->Prebuild(D);
+    }
+}
+
+bool PassGraph::IsBuilt(const std::string &D)
+{
+    for (int Idx = 0; Idx < NumBuffers(); Idx++)
+    {
+        if (IsDropped(Idx) && !Passes[Idx].Prog->IsBuilt(D))
+            return false;
+    }
+    return true;
+}
+
+bool PassGraph::HotReload(const std::string &Path)
+{
+    // a graph that failed to load is retried on any change in its directory
+    if (Dir.empty() || !IsMultipass(Dir))
+        return true;
+    if (sameFile(Path, (std::filesystem::path(Dir) / "passes.ini").string()) ||
+        (!IsLoaded() && sameFile(std::filesystem::path(Path).parent_path().string(), Dir)))
+        return false;
+    for (int Idx = 0; Idx < NumBuffers(); Idx++)
+    {
+        if (Passes[Idx].Prog->DependsOn(Path))
+            Passes[Idx].Prog->ReloadAsync();
+    }
+    return true;
+}
+
+void PassGraph::PollReload()
+{
+    for (int Idx = 0; Idx < NumBuffers(); Idx++)
+        Passes[Idx].Prog->PollReload();
+}
@@ -0,0 +1,97 @@
+#ifndef PASS_GRAPH_H
+#define PASS_GRAPH_H
+
+#include "gl_headers.h"
+#include "shader_utils.h"
+#include "utils.h"
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+// ShaderToy style multipass main shaders. A directory in fragment_shaders (in place of a .glsl) holds the image
+// pass (image.glsl, the main shader proper) and a passes.ini declaring the buffer passes that render before it,
+// in order. Every buffer writes its own target and reads the others through iChannel0-3, a buffer read before it
+// renders (by itself or an earlier pass) gets a ping-pong pair and is read as of the last frame (feedback).
+// Buffers can be foveated (dropped by the drop shader & reconstructed like the image) or rendered at a reduced
+// resolution. Their targets come from a pool: a target is free again once its last reader rendered, so passes
+// whose lifetimes don't overlap share one.
+class PassGraph
+{
+  public:
+    static constexpr int NumChannels = 4;
+    static const char *const ImageShader; // file of the image pass in the directory
+    static bool IsMultipass(const std::string &Path); // a directory with a passes.ini
+    static bool DropsBuffers(const ParamsStruct &P);  // whether foveated buffers are dropped (else rendered full)
+
+    struct Pass
+    {
+        std::string Name;
+        std::string Path;                             // fragment shader (defines expensive_main)
+        int Channels[NumChannels] = {-1, -1, -1, -1}; // buffer read by each iChannel, -1 for none
+        int Level = 0;                                // full (0), half (1) or quarter (2) resolution
+        bool bFoveated = false;                       // dropped & reconstructed (full resolution only)
+        bool bFeedback = false;                       // read as of the last frame, keeps two targets
+        int LastReader = -1;                          // last pass reading this frame's output
+        int Target[2] = {-1, -1};                     // pool targets written, on even & odd frames
+        int Scratch = -1;                             // pool target the dropped pixels render into
+        std::unique_ptr<ShaderUtils::Program> Prog;   // null for the image (Main)
+    };
+
+    // parses Path/passes.ini & builds the buffer programs (with FovDefines) of the main shader at Path, false (and
+    // nothing loaded) for a single .glsl or on errors. The programs are taken from Background if Precompile queued
+    // them, the rest are queued & taken at once
+    bool Load(const std::string &Path, const ParamsStruct &P, const std::string &FovDefines,
+              ShaderUtils::Precompiler *Background);
+    // queues the buffer programs Load would build in the background, nothing for a single .glsl
+    static void Precompile(const std::string &Path, const ParamsStruct &P, const std::string &FovDefines,
+                           ShaderUtils::Precompiler *Background);
+    void Clear();
+    bool IsLoaded() const { return !Passes.empty(); }
+    bool IsCurrent(const std::string &Path, const ParamsStruct &P) const; // Load was called for Path & P
+
+    int NumBuffers() const; // the image is pass NumBuffers()
+    Pass &Buffer(int Idx);
+    bool IsDropped(int Idx) const; // whether buffer Idx renders through the drop shader
+    bool HasDropped() const;
+
+    void Allocate(int W, int H); // the targets for this framebuffer size, no-op unless it changed
+    void Free();                 // every target, the feedback starts over (black) once reallocated
+    GLuint Framebuffer(int Target) const;
+    GLuint Texture(int Target) const;
+    int Output(int Idx) const; // target buffer Idx writes this frame
+    void BindChannels(const ShaderUtils::Program &P, int Idx) const; // of pass Idx, on texture units 1-4
+    void EndFrame(); // this frame's feedback is read by the next one
+
+    void SetDefines(const std::string &D); // the foveation variant of the dropped buffers
+    void Prebuild(const std::string &D);
+    bool IsBuilt(const std::string &D);
+    bool HotReload(const std::string &Path); // false if the graph itself changed (passes.ini), reload it then
+    void PollReload();
+
+  private:
+    struct Target
+    {
+        GLuint FBO = 0, Tex = 0;
+        int W = 0, H = 0;
+    };
+
+    // the passes of Dir/passes.ini (buffers, then the image) with their channels resolved, false on errors. Prints
+    // the errors & warnings if bReport
+    static bool Parse(const std::string &Dir, std::vector<Pass> &Passes, bool bReport);
+    // the sources of buffer B, D the foveation defines if it's dropped (empty otherwise)
+    static std::vector<ShaderUtils::Shader> BufferSources(const Pass &B, const ParamsStruct &P, const std::string &D);
+    static std::string BufferJob(const std::vector<ShaderUtils::Shader> &Sources); // its Precompiler job
+    static void Submit(const std::vector<Pass> &Passes, const ParamsStruct &P, const std::string &FovDefines,
+                       ShaderUtils::Precompiler *Background);
+
+    std::string Dir;          // main shader Load was last called for
+    bool bDrops = false;      // DropsBuffers as loaded
+    int Views = 1;            // NumViews as loaded
+    std::vector<Pass> Passes; // the buffers in order, then the image
+    std::vector<Target> Pool;
+    int PoolW = 0, PoolH = 0; // framebuffer size the pool was allocated for
+    int Parity = 0;           // which target of the feedback pairs is written this frame
+};
+
+#endif
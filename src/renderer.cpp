@@ -1,23 +1,64 @@
 #include "renderer.h"
+#include "benchmark.h"
+#include "cpu_backend.h"
+#include "timeline.h"
+#include <cmath>
 #include <fstream>
 #include <iostream>
 #include <sstream>
 
+// GL 4.3 entry points of the compute reconstruction, loaded at runtime (see LoadCompute)
+typedef void (*DispatchComputeFn)(GLuint, GLuint, GLuint);
+typedef void (*BindImageTextureFn)(GLuint, GLuint, GLint, GLboolean, GLint, GLenum, GLenum);
+typedef void (*MemoryBarrierFn)(GLbitfield);
+static DispatchComputeFn DispatchComputeGL = nullptr;
+static BindImageTextureFn BindImageTextureGL = nullptr;
+static MemoryBarrierFn MemoryBarrierGL = nullptr;
+
+// pixels per side of the tile of a compute workgroup (tile_size in reconstruction_compute.glsl)
+static constexpr int ComputeTile = 32;
+// the reconstruction is linked into the compute program without its fragment entry point
+static const std::string ComputeDefines = "#define FOV_COMPUTE 1\n";
+
+static bool LoadCompute()
+{
+    GLint Major = 0, Minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &Major);
+    glGetIntegerv(GL_MINOR_VERSION, &Minor);
+    if (Major * 10 + Minor < 43)
+        return false;
+    DispatchComputeGL = reinterpret_cast<DispatchComputeFn>(glfwGetProcAddress("glDispatchCompute"));
+    BindImageTextureGL = reinterpret_cast<BindImageTextureFn>(glfwGetProcAddress("glBindImageTexture"));
+    MemoryBarrierGL = reinterpret_cast<MemoryBarrierFn>(glfwGetProcAddress("glMemoryBarrier"));
+    return DispatchComputeGL != nullptr && BindImageTextureGL != nullptr && MemoryBarrierGL != nullptr;
+}
+
 Renderer::Renderer(int argc, char *argv[])
 {
 
     Params.FilePath = (argc > 1) ? argv[1] : "../params/params.ini";
-    Params.ParseFile();
+    Params.ParseFile(&FileParams);
 }
 
 bool Renderer::CreateWindow()
 {
-    WindowW = Params.WindowParams.X0;
-    WindowH = Params.WindowParams.Y0;
+    const bool bBenchmark = Params.BenchParams.bEnable;
+    WindowW = bBenchmark ? Params.BenchParams.width : Params.WindowParams.X0;
+    WindowH = bBenchmark ? Params.BenchParams.height : Params.WindowParams.Y0;
 
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    if (bBenchmark)
+    {
+        // the benchmark renders offscreen, so the window only needs to provide a GL context
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        if (Params.BenchParams.bHeadless)
+        {
+            const bool bOSMesa = (Params.BenchParams.context_api == "osmesa");
+            glfwWindowHint(GLFW_CONTEXT_CREATION_API, bOSMesa ? GLFW_OSMESA_CONTEXT_API : GLFW_EGL_CONTEXT_API);
+        }
+    }
 
     const auto T0 = "Loading shaders..."; // initial title
     window = glfwCreateWindow(WindowW, WindowH, T0, nullptr, nullptr);
@@ -28,6 +69,12 @@ bool Renderer::CreateWindow()
     }
     // Makes the window context current
     glfwMakeContextCurrent(window);
+    if (bBenchmark)
+    {
+        // fixed resolution, independent of the (invisible) window's framebuffer
+        glViewport(0, 0, WindowW, WindowH);
+        return GenerateOutputTarget();
+    }
     // Enable the viewport
     glfwGetFramebufferSize(window, &WindowW, &WindowH);
     glViewport(0, 0, WindowW, WindowH);
@@ -36,70 +83,339 @@ bool Renderer::CreateWindow()
 
 void Renderer::WindowCallbacks()
 {
-    // callback on framebuffer/window size
-    glfwGetFramebufferSize(window, &WindowW, &WindowH);
+    const Timeline::Span Span("WindowCallbacks");
+    // the latest framebuffer size & cursor the input thread polled (the recorded ones when replaying)
+    Input.Read(Inputs);
+    if (!IsReplaying())
+    {
+        WindowW = Inputs.W;
+        WindowH = Inputs.H;
+    }
+    else if (Replay[ReplayIdx].W > 0 && Replay[ReplayIdx].H > 0)
+    {
+        WindowW = Replay[ReplayIdx].W;
+        WindowH = Replay[ReplayIdx].H;
+    }
     if (WindowW != LastWindowW || WindowH != LastWindowH)
     {
+        const Timeline::Span Resize("resize", std::to_string(WindowW) + "x" + std::to_string(WindowH));
         std::cout << "Detected FB size change from "
                   << "(" << LastWindowW << " x " << LastWindowH << ") to (" << WindowW << " x " << WindowH << ")"
                   << std::endl;
-#ifdef __APPLE__
-        /// HACK: special case for MacOS hiDPI monitors which exactly 2x or 1/2x the dpi between hi and lo dpi displays
-        int ExpectedWindowW, ExpectedWindowH;
-        glfwGetWindowSize(window, &ExpectedWindowW, &ExpectedWindowH);
-        if (ExpectedWindowH == WindowH / 2 && ExpectedWindowW == WindowW / 2)
-        {
-            std::cout << "Detected hiDPI display" << std::endl;
-            bIsHiDPI = true;
-        }
-        else
-            bIsHiDPI = false;
-
-#endif
         LastWindowW = WindowW;
         LastWindowH = WindowH;
+        RecordFrame.W = WindowW;
+        RecordFrame.H = WindowH;
 
         glViewport(0, 0, WindowW, WindowH);
 
-        if (Params.bEnablePostProcessing)
+        // regenerate the offscreen targets (even if postprocessing is currently toggled off)
+        GenerateFBO();
+    }
+
+    // callback on Mouse coordinates
+    if (IsReplaying())
+    {
+        MouseX = Replay[ReplayIdx].MouseX * WindowW;
+        MouseY = Replay[ReplayIdx].MouseY * WindowH;
+        return;
+    }
+    MouseX = Inputs.MouseX;
+    MouseY = Inputs.MouseY;
+    RecordFrame.MouseX = static_cast<float>(MouseX / WindowW);
+    RecordFrame.MouseY = static_cast<float>(MouseY / WindowH);
+    if (GazeInput != nullptr)
+        GazeInput->Cursor(Inputs.Time, static_cast<float>(InView(MouseX) / ViewW()),
+                          static_cast<float>(MouseY / WindowH));
+}
+
+bool Renderer::GenerateFBO()
+{
+    // (re)create the pair of offscreen render targets at the current framebuffer size
+    glDeleteFramebuffers(2, FBO);
+    glDeleteTextures(2, Tex);
+    glDeleteRenderbuffers(1, &MaskRBO);
+    glGenFramebuffers(2, FBO);
+    glGenTextures(2, Tex);
+
+    // both targets share one stencil buffer so the mask survives the ping-pong
+    glGenRenderbuffers(1, &MaskRBO);
+    glBindRenderbuffer(GL_RENDERBUFFER, MaskRBO);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, WindowW, WindowH);
+    bMaskValid = false;
+
+    for (int i = 0; i < 2; i++)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO[i]);
+        // create texture map for FBO
+        glBindTexture(GL_TEXTURE_2D, Tex[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, WindowW, WindowH, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        // link the texture map with the FBO
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, Tex[i], 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, MaskRBO);
+        // check for problems
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
         {
-            // glDeleteBuffers(1, &FBO);
-            glDeleteTextures(1, &Tex);
+            std::cerr << "can't initialize FBO" << std::endl;
+            glfwTerminate();
+            return false;
+        }
+    }
 
-            // generate new FB texture for postprocessing
-            GenerateFBO();
+    // reduced resolution levels for the multires strategy (level 1 is half, level 2 quarter resolution)
+    glDeleteFramebuffers(2, LevelFBO);
+    glDeleteTextures(2, LevelTex);
+    glGenFramebuffers(2, LevelFBO);
+    glGenTextures(2, LevelTex);
+    for (int i = 0; i < 2; i++)
+    {
+        const int Level = i + 1;
+        glBindFramebuffer(GL_FRAMEBUFFER, LevelFBO[i]);
+        glBindTexture(GL_TEXTURE_2D, LevelTex[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, std::max(WindowW >> Level, 1), std::max(WindowH >> Level, 1), 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        // linear filtering performs the (bilinear) upsample in the composite
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, LevelTex[i], 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            std::cerr << "can't initialize multires FBO" << std::endl;
+            glfwTerminate();
+            return false;
         }
     }
 
-    // callback on Mouse coordinates
-    glfwGetCursorPos(window, &MouseX, &MouseY);
-    if (bIsHiDPI)
+    // history for temporal reconstruction, starts out black (clamped to the neighbourhood, so it fades in)
+    glDeleteFramebuffers(2, HistoryFBO);
+    glDeleteTextures(2, HistoryTex);
+    glGenFramebuffers(2, HistoryFBO);
+    glGenTextures(2, HistoryTex);
+    for (int i = 0; i < 2; i++)
     {
-        MouseX *= 2;
-        MouseY *= 2;
+        glBindFramebuffer(GL_FRAMEBUFFER, HistoryFBO[i]);
+        glBindTexture(GL_TEXTURE_2D, HistoryTex[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, WindowW, WindowH, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, HistoryTex[i], 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            std::cerr << "can't initialize history FBO" << std::endl;
+            glfwTerminate();
+            return false;
+        }
+        glClearColor(0.f, 0.f, 0.f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
     }
+
+    // image the compute reconstruction writes, blitted to the output (the default framebuffer isn't an image)
+    glDeleteFramebuffers(1, &ComputeFBO);
+    glDeleteTextures(1, &ComputeTex);
+    ComputeFBO = ComputeTex = 0;
+    if (bComputeReconstruction)
+    {
+        glGenFramebuffers(1, &ComputeFBO);
+        glGenTextures(1, &ComputeTex);
+        glBindFramebuffer(GL_FRAMEBUFFER, ComputeFBO);
+        glBindTexture(GL_TEXTURE_2D, ComputeTex);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, WindowW, WindowH, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, ComputeTex, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            std::cerr << "can't initialize the compute reconstruction target" << std::endl;
+            glfwTerminate();
+            return false;
+        }
+    }
+    return true;
 }
 
-bool Renderer::GenerateFBO()
+bool Renderer::MaskState::operator==(const MaskState &Other) const
 {
-    // create frame buffer object
-    glGenFramebuffers(1, &FBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
-    // create texture map for FBO
-    glGenTextures(1, &Tex);
-    glBindTexture(GL_TEXTURE_2D, Tex);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, WindowW, WindowH, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    // link the texture map with the FBO
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, Tex, 0);
-    // check for problems
+    return Stride == Other.Stride && W == Other.W && H == Other.H && Phases == Other.Phases &&
+           GazeCells == Other.GazeCells && Radii == Other.Radii && Keep == Other.Keep && Aspects == Other.Aspects;
+}
+
+bool Renderer::UseTemporal() const
+{
+    return Params.bEnableFovRender && Params.FRParams.Strategy == FovStrategy::Checkerboard &&
+           Params.FRParams.Reconstruction == ReconstructionMode::Temporal;
+}
+
+int Renderer::NumPhases() const
+{
+    return UseTemporal() ? 4 : 1;
+}
+
+void Renderer::DropPhase(const int Idx, int Phase[2]) const
+{
+    // shifts (in pixels) of the drop pattern, one quad apart so that every pixel lands in the (always kept)
+    // top left quad once per cycle. Consecutive phases are diagonal to each other to spread out the shading
+    const int Quad = Fov.stride / 2;
+    const int Shifts[4][2] = {{0, 0}, {Quad, Quad}, {Quad, 0}, {0, Quad}};
+    Phase[0] = Shifts[Idx % NumPhases()][0];
+    Phase[1] = Shifts[Idx % NumPhases()][1];
+}
+
+bool Renderer::UseStencilMask() const
+{
+    return Params.bEnableFovRender && Params.FRParams.Strategy == FovStrategy::Checkerboard &&
+           Params.FRParams.bStencilMask;
+}
+
+Renderer::MaskState Renderer::CurrentMaskState() const
+{
+    // the drop pattern only depends on the stride-aligned gaze cells (not the exact gaze), stride & profiles
+    const int Stride = Fov.stride;
+    MaskState Mask;
+    Mask.Stride = Stride;
+    Mask.W = WindowW;
+    Mask.H = WindowH;
+    Mask.Phases = NumPhases();
+    for (int View = 0; View < NumViews(Params); View++)
+    {
+        const FRShaderParams &P = ViewFov(View);
+        Mask.GazeCells.push_back(static_cast<int>(std::floor(GazeX[View] / Stride)));
+        Mask.GazeCells.push_back(static_cast<int>(std::floor((WindowH - GazeY[View]) / Stride)));
+        Mask.Radii.insert(Mask.Radii.end(), P.radii.begin(), P.radii.end());
+        Mask.Keep.insert(Mask.Keep.end(), P.keep.begin(), P.keep.end());
+        Mask.Aspects.push_back(P.aspect);
+    }
+    return Mask;
+}
+
+void Renderer::UpdateStencilMask()
+{
+    const MaskState Mask = CurrentMaskState();
+    if (bMaskValid && Mask == LastMask)
+        return;
+
+    // mark every dropped pixel of phase i with stencil bit i (the mask shader discards the kept ones),
+    // so all the phases of temporal reconstruction are cached at once
+    MaskProg.SetDefines(FovVariant);
+    Profiler.BeginPass(GpuProfiler::MaskPass);
+    glStencilMask(0xFF);
+    glClearStencil(0);
+    glClear(GL_STENCIL_BUFFER_BIT);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glEnable(GL_STENCIL_TEST);
+    glStencilFunc(GL_ALWAYS, 0xFF, 0xFF);
+    glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+    glUseProgram(MaskProg.GetProgram());
+    glBindVertexArray(VAO);
+    for (int i = 0; i < Mask.Phases; i++)
+    {
+        int Phase[2];
+        DropPhase(i, Phase);
+        glUniform2iv(MaskProg.GetUniform(ShaderUtils::UniformMaskPhase), 1, Phase);
+        glStencilMask(1 << i);
+        glDrawArrays(GL_TRIANGLES, 0, 6); // 2 (3 vertex) triangles for rect
+    }
+    glStencilMask(0xFF);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glDisable(GL_STENCIL_TEST);
+    Profiler.EndPass(GpuProfiler::MaskPass);
+
+    LastMask = Mask;
+    bMaskValid = true;
+}
+
+void Renderer::UpdateTiles()
+{
+    // the classification changes with the drop pattern, which is static most of the time
+    const MaskState State = CurrentMaskState();
+    if (bTilesValid && State == LastTiles)
+        return;
+    LastTiles = State;
+    bTilesValid = true;
+
+    // tiles of a few blocks at small strides keep the instance count down
+    const int Stride = Fov.stride;
+    const int Blocks = std::max(16 / Stride, 1);
+    const int Size = Stride * Blocks;
+    const int Views = NumViews(Params);
+    const int W = ViewW();
+    FovReference::Pattern P[MaxViews];
+    for (int View = 0; View < Views; View++)
+    {
+        P[View] = CurrentPattern(View);
+        FullBox[View][0] = FullBox[View][1] = INT16_MAX;
+        FullBox[View][2] = FullBox[View][3] = 0;
+    }
+    // the reconstruction computes the level itself near the radii, ex. where the GPU rounds differently
+    const float Slack = 0.5f;
+    std::vector<int16_t> Tiles; // bottom left pixel, width, height & kept sixteenths per run of tiles
+    for (int y = 0; y < WindowH; y += Size)
+    {
+        // the tiles are classified in view pixels, and end at the edge of their view
+        for (int View = 0; View < Views; View++)
+        {
+            for (int x = 0; x < W; x += Size)
+            {
+                int Keep = FovReference::BlockKeep(P[View], WindowH, x / Stride, y / Stride, Slack);
+                for (int by = y / Stride; by < (y + Size) / Stride; by++)
+                {
+                    for (int bx = x / Stride; bx < (x + Size) / Stride; bx++)
+                    {
+                        if (FovReference::BlockKeep(P[View], WindowH, bx, by, Slack) != Keep)
+                            Keep = -1;
+                    }
+                }
+                const int X = View * W + x;
+                const int TileW = std::min(Size, W - x);
+                if (Keep == 16)
+                {
+                    // full quality, copied as is
+                    int *Box = FullBox[View];
+                    Box[0] = std::min(Box[0], X);
+                    Box[1] = std::min(Box[1], y);
+                    Box[2] = std::max(Box[2], X + TileW);
+                    Box[3] = std::max(Box[3], std::min(y + Size, WindowH));
+                    continue;
+                }
+                // neighbours in a row at the same level are drawn as one quad (even across views, the shader
+                // picks the view per pixel)
+                const size_t Last = Tiles.size() - 5;
+                if (!Tiles.empty() && Tiles[Last + 1] == y && Tiles[Last] + Tiles[Last + 2] == X &&
+                    Tiles[Last + 4] == Keep)
+                    Tiles[Last + 2] += TileW;
+                else
+                    Tiles.insert(Tiles.end(), {static_cast<int16_t>(X), static_cast<int16_t>(y),
+                                               static_cast<int16_t>(TileW), static_cast<int16_t>(Size),
+                                               static_cast<int16_t>(Keep)});
+            }
+        }
+    }
+    NumTiles = static_cast<int>(Tiles.size() / 5);
+    glBindBuffer(GL_ARRAY_BUFFER, TileVBO);
+    glBufferData(GL_ARRAY_BUFFER, Tiles.size() * sizeof(int16_t), Tiles.data(), GL_DYNAMIC_DRAW);
+}
+
+bool Renderer::GenerateOutputTarget()
+{
+    // offscreen replacement for the default framebuffer
+    glGenFramebuffers(1, &OutputFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, OutputFBO);
+    glGenTextures(1, &OutputTex);
+    glBindTexture(GL_TEXTURE_2D, OutputTex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, WindowW, WindowH, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, OutputTex, 0);
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
     {
-        std::cerr << "can't initialize FBO" << std::endl;
-        glfwTerminate();
+        std::cerr << "can't initialize offscreen output target" << std::endl;
         return false;
     }
     return true;
@@ -107,199 +423,699 @@ bool Renderer::GenerateFBO()
 
 void Renderer::DisplayFps()
 {
+    const Timeline::Span Span("DisplayFps");
     assert(window != nullptr);
     const double DeltaT = glfwGetTime() - LastTimeFps;
     NumFrames++;
+
+    CollectGpuTimings();
+
     if (DeltaT > 1.f) // more than a second ago
     {
         const double Fps = double(NumFrames) / DeltaT;
-        const double FragTime = TimeFragmentShaderSec / NumFrames;
-        const double RecTime = TimeReconstructShaderSec / NumFrames;
         std::stringstream ss;
         if (Params.bEnableDebugMode)
-            ss << "[FPS: " << Fps << " FRAG: " << FragTime << " REC: " << RecTime << "]";
+        {
+            const int N = std::max(GpuPassFrames, 1);
+            ss << "[FPS: " << Fps << " DROP: " << GpuPassMs[GpuProfiler::DropPass] / N
+               << "ms REC: " << GpuPassMs[GpuProfiler::ReconstructionPass] / N << "ms]";
+        }
         else
             ss << "[FPS: " << Fps << "]";
-        glfwSetWindowTitle(window, ss.str().c_str());
+        if (Params.AdaptiveParams.bEnable)
+            ss << " [" << Adaptive.Stats(Params.AdaptiveParams, Params.FRParams.stride) << "]";
+        Input.SetTitle(ss.str());
         NumFrames = 0;
-        TimeFragmentShaderSec = 0.f;
-        TimeReconstructShaderSec = 0.f;
+        std::fill(std::begin(GpuPassMs), std::end(GpuPassMs), 0.0);
+        GpuPassFrames = 0;
         LastTimeFps = glfwGetTime();
+        SyncGpuClock(); // the clocks drift apart
     }
 }
 
-void Renderer::CheckInputs()
+void Renderer::SyncGpuClock()
+{
+    // puts the GPU passes on the timeline's clock
+    if (!Timeline::IsOn() || !Profiler.IsActive())
+        return;
+    GLint64 GpuNs = 0;
+    glGetInteger64v(GL_TIMESTAMP, &GpuNs);
+    Timeline::SyncGpuClock(GpuNs);
+}
+
+void Renderer::CollectGpuTimings()
 {
-    // check for closing window
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+    // accumulate whichever GPU timings have arrived (a few frames late) since the last call
+    const AdaptiveParamsStruct &A = Params.AdaptiveParams;
+    // the controller takes a step once its programs are built (queued here if they weren't ahead, ex. two steps)
+    const auto IsStepBuilt = [this](const int Offset) {
+        const std::string Variant = VariantOf(Params, Offset);
+        PrebuildVariant(Params, Variant);
+        return IsVariantBuilt(Params, Variant);
+    };
+    for (const auto &T : Profiler.Collect())
     {
-        glfwSetWindowShouldClose(window, true);
+        for (int P = 0; P < GpuProfiler::NumPasses; P++)
+        {
+            if (T.bMeasured[P])
+                Timeline::AddGpu(GpuProfiler::PassName(static_cast<GpuProfiler::Pass>(P)), T.BeginNs[P],
+                                 T.EndNs[P], T.FrameId);
+        }
+        double FrameMs = 0.0;
+        for (int P = 0; P < GpuProfiler::NumPasses; P++)
+        {
+            GpuPassMs[P] += T.Ms[P];
+            FrameMs += T.Ms[P];
+        }
+        GpuPassFrames++;
+        // replays & the benchmark measure fixed profiles
+        if (A.bEnable && !IsReplaying() && !Params.BenchParams.bEnable &&
+            Adaptive.Add(T.FrameId, FrameMs, FrameCount, A, Params.FRParams.stride, IsStepBuilt))
+            std::cout << Adaptive.Stats(A, Params.FRParams.stride) << std::endl;
+        if (!Replay.empty() && T.FrameId < Replay.size())
+        {
+            for (int P = 0; P < GpuProfiler::NumPasses; P++)
+                ReplayResult.PassMs[P][T.FrameId] = T.Ms[P];
+        }
     }
+}
 
-    // check for reloading shaders
-    if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS && !bReloadPressed)
+void Renderer::CheckInputs()
+{
+    const Timeline::Span Span("CheckInputs");
+    // the input thread catches the key presses (and closes the window on escape), replays only take the
+    // recorded actions
+    InputTrace::Action A;
+    while (Input.PopAction(A))
     {
-        std::cout << "Reloading..." << std::endl;
-        bReloadPressed = true;
-        Params.ParseFile();  // reload global params
-        Main.Reload(Params); // reload main param & shaders
-        PostProc.Reload();   // reload postprocessing shaders
+        if (!IsReplaying())
+            ApplyAction(A);
     }
-    else if (glfwGetKey(window, GLFW_KEY_R) == GLFW_RELEASE)
+    if (IsReplaying())
     {
-        bReloadPressed = false;
+        for (const InputTrace::Action A : Replay[ReplayIdx].Actions)
+            ApplyAction(A);
     }
+}
 
-    // previous shader
-    const bool bPressPrev =
-        (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS);
-    const bool bReleasePrev =
-        (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_RELEASE && glfwGetKey(window, GLFW_KEY_A) == GLFW_RELEASE);
-    if (bPressPrev && !bPrevPressed)
+void Renderer::ApplyAction(const InputTrace::Action A)
+{
+    switch (A)
     {
+    case InputTrace::Action::Reload:
+        std::cout << "Reloading..." << std::endl;
+        ReloadParams(); // the params that changed in the file
+        // every shader is re-read & rebuilt in the background, each one swapped in once it links (HotReload)
+        Main.ReloadAsync(Params);
+        PostProc.ReloadAsync();
+        MaskProg.ReloadAsync();
+        Composite.ReloadAsync();
+        Temporal.ReloadAsync();
+        if (bComputeReconstruction)
+            ComputeProg.ReloadAsync();
+        Graph.Clear(); // reloaded (passes.ini too) by the next frame
+        bMaskValid = false;
+        bTilesValid = false;
+        break;
+    case InputTrace::Action::PrevShader:
         std::cout << "Previous shader..." << std::endl;
-        bPrevPressed = true;
-        Params.ParseFile();      // reload global params
-        Main.PrevShader(Params); // previous main param & shaders
-        PostProc.Reload();       // reload postprocessing shaders
+        ReloadParams();          // reload global params
+        Main.PrevShader(Params); // previous main param & shaders (already compiled in the background)
+        break;
+    case InputTrace::Action::NextShader:
+        std::cout << "Right shader..." << std::endl;
+        ReloadParams();          // reload global params
+        Main.NextShader(Params); // right main param & shaders (already compiled in the background)
+        break;
+    case InputTrace::Action::StrideUp:
+    {
+        int old = Params.FRParams.stride;
+        int current = std::min(Params.FRParams.stride * 2, 256);
+        Params.FRParams.stride = current;
+        std::cout << "Increasing block size from " << old << " to " << current << std::endl;
+        break;
     }
-    else if (bReleasePrev)
+    case InputTrace::Action::StrideDown:
     {
-        bPrevPressed = false;
+        int old = Params.FRParams.stride;
+        int current = std::max(Params.FRParams.stride / 4 * 2, 2); // stays even
+        Params.FRParams.stride = current;
+        std::cout << "Decreasing block size from " << old << " to " << current << std::endl;
+        break;
+    }
+    case InputTrace::Action::TogglePostprocessing:
+        std::cout << "Toggling postprocessing shader..." << std::endl;
+        Params.bEnablePostProcessing = !Params.bEnablePostProcessing;
+        break;
+    case InputTrace::Action::TogglePause:
+        bTickClock = !bTickClock;
+        if (!bTickClock)
+            std::cout << "Freezing clock @ " << CurrentTime << std::endl;
+        else
+            std::cout << "Resuming clock @ " << CurrentTime << std::endl;
+        break;
+    case InputTrace::Action::ToggleCapture:
+        if (Capture.IsActive())
+            Capture.Stop();
+        else
+            Capture.Start(Params.CaptureParams);
+        break;
+    case InputTrace::Action::DumpTimeline:
+        Timeline::RequestDump("on demand");
+        break;
+    case InputTrace::Action::NumActions:
+        break;
     }
+    if (Recorder.IsOpen())
+        RecordFrame.Actions.push_back(A);
+}
+
+int Renderer::ViewW() const
+{
+    return std::max(WindowW / NumViews(Params), 1);
+}
 
-    // next shader
-    const bool bPressNext =
-        (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS);
-    const bool bReleaseNext =
-        (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_RELEASE && glfwGetKey(window, GLFW_KEY_D) == GLFW_RELEASE);
-    if (bPressNext && !bNextPressed)
+double Renderer::InView(const double X) const
+{
+    // the cursor points at the same spot of every view
+    return (NumViews(Params) > 1) ? std::fmod(std::max(X, 0.0), ViewW()) : X;
+}
+
+const FRShaderParams &Renderer::ViewFov(const int View) const
+{
+    return (View == 0) ? Fov : RightFov;
+}
+
+void Renderer::UpdateGaze()
+{
+    const Timeline::Span Span("UpdateGaze");
+    // center the fovea where the gaze is expected to be once this frame is scanned out. The gaze of each view is
+    // in its own pixels, samples of a stereo tracker carry the eye they belong to
+    const int Views = NumViews(Params);
+    const int W = ViewW();
+    for (int View = 0; View < Views; View++)
     {
-        std::cout << "Right shader..." << std::endl;
-        bNextPressed = true;
-        Params.ParseFile();      // reload global params
-        Main.NextShader(Params); // right main param & shaders
-        PostProc.Reload();       // reload postprocessing shaders
+        GazeX[View] = InView(MouseX);
+        GazeY[View] = MouseY;
+        if (IsReplaying())
+        {
+            // a single gaze is recorded, the left view's
+            GazeX[View] = Replay[ReplayIdx].GazeX * W;
+            GazeY[View] = Replay[ReplayIdx].GazeY * WindowH;
+        }
     }
-    else if (bReleaseNext)
+    if (IsReplaying())
+        return;
+    if (GazeInput != nullptr)
     {
-        bNextPressed = false;
+        const GazeParamsStruct &G = Params.GazeParams;
+        Gaze::Sample S;
+        while (GazeInput->Poll(S))
+        {
+            for (int View = 0; View < MaxViews; View++)
+            {
+                if (S.View < 0 || S.View == View)
+                    GazePredict[View].Add(S, G);
+            }
+        }
+        for (int View = 0; View < Views; View++)
+        {
+            float X, Y;
+            if (GazePredict[View].Predict(Gaze::Now() + 0.001 * G.latency_ms, G, X, Y))
+            {
+                GazeX[View] = X * W;
+                GazeY[View] = Y * WindowH;
+            }
+        }
     }
+    RecordFrame.GazeX = static_cast<float>(GazeX[0] / W);
+    RecordFrame.GazeY = static_cast<float>(GazeY[0] / WindowH);
+}
+
+bool Renderer::IsReplaying() const
+{
+    return ReplayIdx < Replay.size();
+}
+
+int Renderer::ShaderFrame() const
+{
+    // NumFrames restarts with the fps counter, which would make replays depend on the speed of the machine
+    return IsReplaying() ? static_cast<int>(ReplayIdx) : NumFrames;
+}
 
-    // double the stride size
-    const bool bPressUp =
-        (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS);
-    const bool bReleaseUp =
-        (glfwGetKey(window, GLFW_KEY_UP) == GLFW_RELEASE && glfwGetKey(window, GLFW_KEY_W) == GLFW_RELEASE);
-    if (bPressUp && !bUpPressed)
+bool Renderer::StartTrace()
+{
+    const TraceParamsStruct &T = Params.TraceParams;
+    if (!T.replay.empty())
     {
-        int old = Params.FRParams.stride;
-        int current = std::min(Params.FRParams.stride * 2, 256);
-        Params.FRParams.stride = current;
-        std::cout << "Increasing block size from " << old << " to " << current << std::endl;
-        bUpPressed = true;
+        InputTrace::Header H;
+        if (!InputTrace::Load(T.replay, H, Replay))
+            return false;
+        // start from the recorded state
+        bool bFound = false;
+        for (size_t i = 0; i < Main.NumShaders() && !bFound; i++)
+        {
+            if (std::filesystem::path(Main.GetShaderPath(i)).filename() == H.Shader)
+            {
+                bFound = true;
+                Main.SetShader(Params, i);
+            }
+        }
+        if (!bFound)
+            std::cerr << "can't find the recorded shader \"" << H.Shader << "\", replaying with the current one"
+                      << std::endl;
+        // a hand-edited or corrupt header fails the replay instead of rendering with a broken profile
+        Params.FRParams.stride = H.Stride;
+        Params.FRParams.radii = H.Radii;
+        if (!H.Keep.empty()) // only recorded since version 2
+        {
+            Params.FRParams.keep = H.Keep;
+            Params.FRParams.aspect = H.Aspect;
+        }
+        if (!CheckFovProfile(Params.FRParams) || !CheckViews(Params))
+            return false;
+        Params.bEnableFovRender = H.bFovRender;
+        Params.bEnablePostProcessing = H.bPostProcessing;
+
+        ReplayIdx = 0;
+        FrameCount = 0; // tags the GPU timings with the replayed frame
+        ReplayResult = {};
+        ReplayResult.Cfg.Shader = Main.GetShaderPath(Main.CurrentShader());
+        ReplayResult.Cfg.bFoveated = Params.bEnableFovRender;
+        ReplayResult.Cfg.Strategy = Params.FRParams.Strategy;
+        ReplayResult.Cfg.Reconstruction = Params.FRParams.Reconstruction;
+        ReplayResult.Cfg.Stride = Params.FRParams.stride;
+        ReplayResult.Cfg.Thresholds = H.Radii;
+        for (int P = 0; P < GpuProfiler::NumPasses; P++)
+        {
+            ReplayResult.PassNames.push_back(GpuProfiler::PassName(static_cast<GpuProfiler::Pass>(P)));
+            ReplayResult.PassMs.push_back(std::vector<double>(Replay.size(), 0.0));
+        }
+        std::cout << "Replaying \"" << T.replay << "\"" << std::endl;
+        return true;
     }
-    else if (bReleaseUp)
+
+    if (!T.record.empty())
     {
-        bUpPressed = false;
+        InputTrace::Header H;
+        H.Shader = std::filesystem::path(Main.GetShaderPath(Main.CurrentShader())).filename().string();
+        H.Stride = Params.FRParams.stride;
+        H.Radii = Params.FRParams.radii;
+        H.Keep = Params.FRParams.keep;
+        H.Aspect = Params.FRParams.aspect;
+        H.bFovRender = Params.bEnableFovRender;
+        H.bPostProcessing = Params.bEnablePostProcessing;
+        return Recorder.Open(T.record, H);
     }
+    return true;
+}
 
-    // half the stride size
-    const bool bPressDown =
-        (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS);
-    const bool bReleaseDown =
-        (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_RELEASE && glfwGetKey(window, GLFW_KEY_S) == GLFW_RELEASE);
-    if (bPressDown && !bDownPressed)
+void Renderer::ReloadParams()
+{
+    // only the keys whose value changed in the file are applied, so ex. a stride picked with the keys stays
+    // until the file's own changes
+    std::vector<std::pair<std::string, std::string>> Pairs, Changes;
+    if (!ReadParamsFile(Params.FilePath, Pairs))
     {
-        int old = Params.FRParams.stride;
-        int current = std::max(Params.FRParams.stride / 2, 2);
-        Params.FRParams.stride = current;
-        std::cout << "Decreasing block size from " << old << " to " << current << std::endl;
-        bDownPressed = true;
+        std::cerr << "can't read \"" << Params.FilePath << "\", keeping the current params" << std::endl;
+        return;
     }
-    else if (bReleaseDown)
+    for (const auto &Pair : Pairs)
     {
-        bDownPressed = false;
+        std::string &Last = FileParams[Pair.first];
+        if (Last != Pair.second)
+            Changes.push_back(Pair);
+        Last = Pair.second;
     }
+    if (!Changes.empty())
+        SetParams(Changes);
+}
 
-    // toggle postprocessing (reconstruction) shader
-    const bool bPressPPToggle =
-        (glfwGetKey(window, GLFW_KEY_TAB) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_ENTER) == GLFW_PRESS);
-    const bool bReleasePPToggle =
-        (glfwGetKey(window, GLFW_KEY_TAB) == GLFW_RELEASE && glfwGetKey(window, GLFW_KEY_ENTER) == GLFW_RELEASE);
-    if (bPressPPToggle && !bPPTogglePressed)
+void Renderer::SetParams(const std::vector<std::pair<std::string, std::string>> &Changes)
+{
+    // on top of the staged params, if some are still waiting for their program
+    const ParamsStruct &Base = bParamsPending ? PendingParams : Params;
+    ParamsStruct Next = Base;
+    unsigned Stages = StageLive;
+    for (const auto &Change : Changes)
     {
-        std::cout << "Toggling postprocessing shader..." << std::endl;
-        Params.bEnablePostProcessing = !Params.bEnablePostProcessing;
-        bPPTogglePressed = true;
+        unsigned Stage = StageLive;
+        if (!Next.Set(Change.first, Change.second, &Stage))
+            continue;
+        std::cout << "Set " << Change.first << "=" << Change.second
+                  << ((Stage == StageRestart) ? " (only read at startup)" : "") << std::endl;
+        Stages |= Stage;
     }
-    else if (bReleasePPToggle)
+    if (!CheckFovProfile(Next.FRParams) || !CheckViews(Next))
     {
-        bPPTogglePressed = false;
+        std::cerr << "keeping the previous foveation profile" << std::endl;
+        Next.FRParams.radii = Base.FRParams.radii;
+        Next.FRParams.keep = Base.FRParams.keep;
+        Next.FRParams.aspect = Base.FRParams.aspect;
+        Next.FRParams.stride = Base.FRParams.stride;
+        Next.ViewParams = Base.ViewParams;
     }
+    PendingParams = Next;
+    PendingStages |= Stages;
+    bParamsPending = true;
+    TakePendingParams(); // right away unless a program has to be built first
 }
 
-void Renderer::TickClock()
+void Renderer::TakePendingParams()
 {
-    assert(window != nullptr);
-    // check for toggling time shaders
-    if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS && !bPausePressed)
+    if (!bParamsPending)
+        return;
+    // the variant the staged profile selects, nothing is rebuilt that's linked already (or queued)
+    const std::string Variant = VariantOf(PendingParams);
+    PrebuildVariant(PendingParams, Variant);
+    if (!IsVariantBuilt(PendingParams, Variant))
+        return;
+    const ParamsStruct Previous = Params;
+    const unsigned Stages = PendingStages;
+    Params = PendingParams;
+    bParamsPending = false;
+    PendingStages = 0;
+    ApplyParams(Previous, Stages);
+}
+
+void Renderer::ApplyParams(const ParamsStruct &Previous, const unsigned Stages)
+{
+    // everything else is read from Params as it's used
+    if (Params.bEnableVsync != Previous.bEnableVsync && !IsReplaying())
     {
-        bTickClock = !bTickClock;
-        if (!bTickClock)
-            std::cout << "Freezing clock @ " << glfwGetTime() << std::endl;
-        else
-            std::cout << "Resuming clock @ " << glfwGetTime() << std::endl;
-        bPausePressed = true;
+        bEnableVsync = Params.bEnableVsync;
+        glfwSwapInterval(bEnableVsync);
     }
-    else if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_RELEASE)
+    if ((Params.bEnableDebugMode || Params.AdaptiveParams.bEnable) && !Profiler.IsActive() && !Profiler.Init())
+        std::cerr << "unable to create GPU timer queries, continuing without GPU timings" << std::endl;
+
+    // the targets follow the window's size (WindowCallbacks)
+    if ((Stages & StageTargets) &&
+        (Params.WindowParams.X0 != Previous.WindowParams.X0 || Params.WindowParams.Y0 != Previous.WindowParams.Y0))
+        Input.SetWindowSize(Params.WindowParams.X0, Params.WindowParams.Y0);
+
+    if (Stages & StagePrograms)
+    {
+        // the main program was built ahead (TakePendingParams), the others are rebuilt in the background if
+        // their files changed
+        Main.Refresh(Params);
+        const auto SamePaths = [](const ShaderUtils::Shader &a, const ShaderUtils::Shader &b) {
+            return a.file_path == b.file_path;
+        };
+        for (ShaderUtils::Program *P : {&PostProc, &MaskProg, &Composite, &Temporal, &ComputeProg})
+        {
+            if (P == &ComputeProg && !bComputeReconstruction)
+                continue;
+            const auto Old = ProgramSources(*P, Previous, ""), New = ProgramSources(*P, Params, "");
+            if (std::equal(Old.begin(), Old.end(), New.begin(), New.end(), SamePaths))
+                continue;
+            P->ReloadAsync(New);
+            if (Params.bHotReload && !IsReplaying())
+            {
+                for (const ShaderUtils::Shader &S : New)
+                    Watcher.Watch(S.file_path);
+            }
+        }
+        if (Params.bHotReload && !IsReplaying())
+        {
+            for (const std::string &Path :
+                 {Params.MainParams.vertex_shader_path, Params.MainParams.non_fr_fragment_shader_path,
+                  Params.FRParams.drop_shader, Params.FRParams.common_shader})
+                Watcher.Watch(Path);
+        }
+    }
+    bMaskValid = false;
+    bTilesValid = false;
+}
+
+void Renderer::PollParams()
+{
+    const Timeline::Span Span("PollParams");
+    const auto Changes = ParamInput.Poll();
+    if (!Changes.empty())
+        SetParams(Changes);
+    TakePendingParams();
+}
+
+std::vector<ShaderUtils::Shader> Renderer::ProgramSources(const ShaderUtils::Program &Prog, const ParamsStruct &P,
+                                                          const std::string &Defines) const
+{
+    const std::string &Vertex = P.MainParams.vertex_shader_path;
+    const FRShaderParams &FR = P.FRParams;
+    if (&Prog == &PostProc)
+        return {
+            ShaderUtils::Shader(FR.tile_shader, "tile", GL_VERTEX_SHADER, Defines),
+            ShaderUtils::Shader(FR.reconstruction_shader, "reconstruct", GL_FRAGMENT_SHADER, Defines),
+            ShaderUtils::Shader(FR.common_shader, "common", GL_FRAGMENT_SHADER, Defines),
+        };
+    if (&Prog == &MaskProg)
+        return {
+            ShaderUtils::Shader(Vertex, "vertex", GL_VERTEX_SHADER, Defines),
+            ShaderUtils::Shader(FR.mask_shader, "mask", GL_FRAGMENT_SHADER, Defines),
+            ShaderUtils::Shader(FR.common_shader, "common", GL_FRAGMENT_SHADER, Defines),
+        };
+    if (&Prog == &Composite) // not specialized
+        return {
+            ShaderUtils::Shader(Vertex, "vertex", GL_VERTEX_SHADER),
+            ShaderUtils::Shader(FR.multires_shader, "composite", GL_FRAGMENT_SHADER),
+        };
+    if (&Prog == &Temporal)
+        return {
+            ShaderUtils::Shader(Vertex, "vertex", GL_VERTEX_SHADER, Defines),
+            ShaderUtils::Shader(FR.temporal_shader, "temporal", GL_FRAGMENT_SHADER, Defines),
+            ShaderUtils::Shader(FR.common_shader, "common", GL_FRAGMENT_SHADER, Defines),
+        };
+    assert(&Prog == &ComputeProg);
+    return {
+        ShaderUtils::Shader(FR.compute_shader, "compute", GL_COMPUTE_SHADER, Defines),
+        ShaderUtils::Shader(FR.reconstruction_shader, "reconstruct", GL_COMPUTE_SHADER, Defines),
+        ShaderUtils::Shader(FR.common_shader, "common", GL_COMPUTE_SHADER, Defines),
+    };
+}
+
+void Renderer::HotReload()
+{
+    const Timeline::Span Span("HotReload");
+    // changed programs are rebuilt in the background, each one is swapped in only once its rebuild links
+    for (const std::string &Path : Watcher.Poll())
     {
-        bPausePressed = false;
+        std::cout << "Changed on disk: \"" << Path << "\"" << std::endl;
+        if (sameFile(Path, Params.FilePath))
+        {
+            ReloadParams();
+            continue;
+        }
+        for (ShaderUtils::Program *P : {&PostProc, &MaskProg, &Composite, &Temporal, &ComputeProg})
+        {
+            if (P->DependsOn(Path))
+                P->ReloadAsync();
+        }
+        Main.HotReload(Params, Path);
+        if (!Graph.HotReload(Path))
+            Graph.Clear(); // reloaded by the next frame
     }
 
+    for (ShaderUtils::Program *P : {&PostProc, &Composite, &Temporal, &ComputeProg})
+        P->PollReload();
+    if (MaskProg.PollReload())
+        bMaskValid = false;
+    Main.PollReload();
+    Graph.PollReload();
+}
+
+void Renderer::TickClock()
+{
+    assert(window != nullptr);
+    // replays run on the recorded (or a fixed) clock, independent of how long frames take now
+    double DeltaT = glfwGetTime() - LastTime;
+    if (IsReplaying())
+        DeltaT = (Params.TraceParams.time_step > 0.f) ? Params.TraceParams.time_step : Replay[ReplayIdx].Dt;
+    RecordFrame.Dt = static_cast<float>(DeltaT);
     if (bTickClock)
-        CurrentTime += glfwGetTime() - LastTime; // using deltas to continue where left off
+        CurrentTime += DeltaT; // using deltas to continue where left off
     LastTime = glfwGetTime();
 }
 
-void Renderer::TalkWithProgram(int ProgramIdx)
+void Renderer::TraceFrame()
 {
-    // send data to the active shader program
+    const Timeline::Span Span("TraceFrame");
+    if (Recorder.IsOpen())
+    {
+        Recorder.Write(RecordFrame);
+        RecordFrame = {};
+    }
+    if (!IsReplaying())
+        return;
 
-    // send iTime
-    glUniform1f(glGetUniformLocation(ProgramIdx, "iTime"), CurrentTime);
+    glFinish(); // frame boundary, like the benchmark
+    ReplayResult.FrameMs.push_back(1000.0 * (glfwGetTime() - ReplayFrameStart));
+    if (++ReplayIdx < Replay.size())
+        return;
 
-    // send iFrame
-    glUniform1i(glGetUniformLocation(ProgramIdx, "iFrame"), NumFrames);
+    // last frame, the GPU timings of the last few frames are still in flight
+    Profiler.Flush();
+    CollectGpuTimings();
+    ReplayResult.Summarize();
+    std::cout << "Replayed " << Replay.size() << " frames, mean: " << ReplayResult.Mean << "ms p50: "
+              << ReplayResult.P50 << "ms p95: " << ReplayResult.P95 << "ms p99: " << ReplayResult.P99 << "ms";
+    for (size_t P = 0; P < ReplayResult.PassNames.size(); P++)
+        std::cout << " " << ReplayResult.PassNames[P] << ": " << ReplayResult.PassMean[P] << "ms";
+    std::cout << std::endl;
+    bReplayWritten = Benchmark::WriteResults(Params.TraceParams.output_prefix, {ReplayResult});
+    glfwSetWindowShouldClose(window, true);
+}
 
-    // send iResolution
-    float ScreenSize[] = {static_cast<float>(WindowW), static_cast<float>(WindowH)};
-    glUniform2fv(glGetUniformLocation(ProgramIdx, "iResolution"), 1, ScreenSize);
+void Renderer::SelectVariant()
+{
+    // every pass switches to the programs specialized for this frame's profile right before using them
+    const bool bStereo = NumViews(Params) > 1;
+    const std::string Defines = ShaderUtils::FoveationDefines(Fov, bStereo ? &RightFov : nullptr);
+    if (Defines == FovVariant)
+        return;
+    FovVariant = Defines;
 
-    // send iMouse
-    float mouse_pos_f[] = {static_cast<float>(MouseX), static_cast<float>(MouseY)};
-    if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS)
+    // the strides the keys switch to next, and the adaptive controller's next step either way, are built in the
+    // background meanwhile
+    ParamsStruct Next = Params;
+    for (const int Stride : {Params.FRParams.stride * 2, Params.FRParams.stride / 4 * 2})
     {
-        // only capture mouse pos when (left) pressed
-        glUniform2fv(glGetUniformLocation(ProgramIdx, "iMouse"), 1, mouse_pos_f);
+        if (Stride < 2 || Stride > 256)
+            continue;
+        Next.FRParams.stride = Stride;
+        PrebuildVariant(Params, VariantOf(Next));
     }
-    // pass in to "Mouse" regardless of click+drag (only need move)
-    glUniform2fv(glGetUniformLocation(ProgramIdx, "Mouse"), 1, mouse_pos_f);
+    if (!Params.AdaptiveParams.bEnable)
+        return;
+    for (const int Offset : {1, -1})
+        PrebuildVariant(Params, VariantOf(Params, Offset));
+}
+
+std::string Renderer::VariantOf(const ParamsStruct &P, const int Offset) const
+{
+    FRShaderParams Left, Right;
+    Adaptive.Apply(P.FRParams, P.AdaptiveParams, Left, Offset);
+    Adaptive.Apply(ViewProfile(P.FRParams, P.ViewParams, 1), P.AdaptiveParams, Right, Offset);
+    return ShaderUtils::FoveationDefines(Left, NumViews(P) > 1 ? &Right : nullptr);
+}
 
-    // communicate foveated render params
-    glUniform1i(glGetUniformLocation(ProgramIdx, "stride"), Params.FRParams.stride);
-    const float diag = 0.5f * (WindowW + WindowH);
-    assert(Params.FRParams.thresh1 < Params.FRParams.thresh2 && Params.FRParams.thresh2 < Params.FRParams.thresh3);
-    const float thresh1 = Params.FRParams.thresh1 * diag;
-    const float thresh2 = Params.FRParams.thresh2 * diag;
-    const float thresh3 = Params.FRParams.thresh3 * diag;
-    glUniform1f(glGetUniformLocation(ProgramIdx, "thresh1"), thresh1);
-    glUniform1f(glGetUniformLocation(ProgramIdx, "thresh2"), thresh2);
-    glUniform1f(glGetUniformLocation(ProgramIdx, "thresh3"), thresh3);
+std::vector<ShaderUtils::Program *> Renderer::VariantPrograms(const ParamsStruct &P)
+{
+    const bool bCheckerboard = P.bEnableFovRender && P.FRParams.Strategy == FovStrategy::Checkerboard;
+    std::vector<ShaderUtils::Program *> Progs;
+    if (bCheckerboard && P.FRParams.bStencilMask)
+        Progs.push_back(&MaskProg);
+    if (Graph.HasDropped() && (!P.bEnablePostProcessing || bComputeReconstruction))
+        Progs.push_back(&PostProc); // reconstructs the dropped buffers (pushed below for the image anyway)
+    if (!P.bEnablePostProcessing)
+        return Progs;
+    if (bCheckerboard && P.FRParams.Reconstruction == ReconstructionMode::Temporal)
+        Progs.push_back(&Temporal);
+    else if (bComputeReconstruction)
+        Progs.push_back(&ComputeProg);
+    else
+        Progs.push_back(&PostProc);
+    return Progs;
+}
+
+void Renderer::PrebuildVariant(const ParamsStruct &P, const std::string &D)
+{
+    Main.Prebuild(P, D);
+    Graph.Prebuild(D);
+    for (ShaderUtils::Program *Prog : VariantPrograms(P))
+        Prog->Prebuild(Prog == &ComputeProg ? D + ComputeDefines : D);
+}
+
+bool Renderer::IsVariantBuilt(const ParamsStruct &P, const std::string &D)
+{
+    if (!Main.IsBuilt(P, D) || !Graph.IsBuilt(D))
+        return false;
+    for (ShaderUtils::Program *Prog : VariantPrograms(P))
+    {
+        if (!Prog->IsBuilt(Prog == &ComputeProg ? D + ComputeDefines : D))
+            return false;
+    }
+    return true;
+}
+
+void Renderer::UpdateFrameState()
+{
+    const Timeline::Span Span("UpdateFrameState");
+    // everything the foveation shaders need this frame, uploaded once and shared by every program
+    Adaptive.Apply(Params.FRParams, Params.AdaptiveParams, Fov);
+    Adaptive.Apply(ViewProfile(Params.FRParams, Params.ViewParams, 1), Params.AdaptiveParams, RightFov);
+    SelectVariant();
+    ShaderUtils::FrameState &State = Frame;
+    State.iResolution[0] = static_cast<float>(ViewW());
+    State.iResolution[1] = static_cast<float>(WindowH);
+    DropPhase(static_cast<int>(FrameCount % NumPhases()), State.phase); // always zero unless temporal
+    State.iTime = static_cast<float>(CurrentTime);
+    State.iFrame = ShaderFrame();
+    State.stride = Fov.stride;
+    State.levels = static_cast<int>(Fov.keep.size());
+    State.views = NumViews(Params);
+    const float diag = 0.5f * (ViewW() + WindowH);
+    for (int View = 0; View < State.views; View++)
+    {
+        const FRShaderParams &FR = ViewFov(View);
+        assert(FR.keep.size() == FR.radii.size() + 1 && FR.keep.size() == Fov.keep.size());
+        ShaderUtils::FovView &V = State.view[View];
+        V.Mouse[0] = static_cast<float>(GazeX[View]);
+        V.Mouse[1] = static_cast<float>(GazeY[View]);
+        V.aspect_w = 1.f / (FR.aspect * FR.aspect);
+        for (int i = 0; i < MaxFovLevels; i++)
+        {
+            // past the last level repeat its radius, the multires composite always reads three
+            const size_t Level = std::min<size_t>(i, FR.keep.size() - 1);
+            V.radius[i] = FR.radii.empty() ? 0.f : FR.radii[std::min(Level, FR.radii.size() - 1)] * diag;
+            V.keep[i] = KeepSixteenths(FR.keep[Level]);
+        }
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, FrameUBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(State), &State);
+
+    // only capture mouse pos (iMouse) when (left) pressed
+    bMouseDown = IsReplaying() ? Replay[ReplayIdx].bMouseDown : Inputs.bMouseDown;
+    RecordFrame.bMouseDown = bMouseDown;
+}
+
+void Renderer::TalkWithProgram(const ShaderUtils::Program &P, const int Level, const int Pass)
+{
+    // send the ShaderToy inputs to the (active) main program, everything else lives in the FrameState block
+    // (reduced resolution levels see a correspondingly scaled down resolution & mouse, side by side views their
+    // own)
+    const float Scale = 1.f / (1 << Level);
+    glUniform1f(P.GetUniform(ShaderUtils::UniformTime), CurrentTime);
+    glUniform1i(P.GetUniform(ShaderUtils::UniformFrame), ShaderFrame());
+    glUniform2f(P.GetUniform(ShaderUtils::UniformResolution), std::max(ViewW() >> Level, 1),
+                std::max(WindowH >> Level, 1));
+    if (bMouseDown)
+        glUniform2f(P.GetUniform(ShaderUtils::UniformMouse), InView(MouseX) * Scale, MouseY * Scale);
+    Graph.BindChannels(P, Pass < 0 ? Graph.NumBuffers() : Pass); // the buffers of a multipass shader
 }
 
 bool Renderer::Init()
 {
+    if (!CheckFovProfile(Params.FRParams) || !CheckViews(Params))
+        return false;
+
+    // shading on the CPU needs no window or GL context at all
+    if (Params.CpuParams.bEnable)
+    {
+        if (!Params.BenchParams.bEnable)
+        {
+            std::cerr << "the CPU backend only runs the benchmark (enable_benchmark=true)" << std::endl;
+            return false;
+        }
+        std::cout << "Renderer: CPU" << std::endl << std::endl;
+        return true;
+    }
+
+    if (Params.TimelineParams.bEnable)
+        Timeline::Start(Params.TimelineParams);
+
+    if (Params.BenchParams.bEnable && Params.BenchParams.bHeadless)
+        glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL); // no display server required
+
     // Initialize the lib
     if (!glfwInit())
     {
@@ -318,9 +1134,15 @@ bool Renderer::Init()
     const GLubyte *version = glGetString(GL_VERSION);
     std::cout << "Renderer: " << renderer << std::endl;
     std::cout << "OpenGL version supported: " << version << std::endl << std::endl;
+    ShaderUtils::BinaryCache::Init(Params.MainParams.cache_dir);
+
+    // start out with the programs specialized for the configured profile
+    Adaptive.Apply(Params.FRParams, Params.AdaptiveParams, Fov);
+    Adaptive.Apply(ViewProfile(Params.FRParams, Params.ViewParams, 1), Params.AdaptiveParams, RightFov);
+    FovVariant = ShaderUtils::FoveationDefines(Fov, NumViews(Params) > 1 ? &RightFov : nullptr);
 
     Main = ShaderUtils::MainProgram{};
-    bool status = Main.loadShaders(Params);
+    bool status = Main.loadShaders(Params, FovVariant);
 
     if (!status)
     {
@@ -330,10 +1152,7 @@ bool Renderer::Init()
     }
 
     PostProc = ShaderUtils::Program{};
-    status = PostProc.loadShaders({
-        ShaderUtils::Shader(Params.MainParams.vertex_shader_path, "vertex", GL_VERTEX_SHADER),
-        ShaderUtils::Shader(Params.FRParams.reconstruction_shader, "reconstruct", GL_FRAGMENT_SHADER),
-    });
+    status = PostProc.loadShaders(ProgramSources(PostProc, Params, FovVariant));
 
     if (!status)
     {
@@ -342,6 +1161,92 @@ bool Renderer::Init()
         return false;
     }
 
+    MaskProg = ShaderUtils::Program{};
+    status = MaskProg.loadShaders(ProgramSources(MaskProg, Params, FovVariant));
+
+    if (!status)
+    {
+        std::cerr << "can't load the shaders to initiate the mask program" << std::endl;
+        glfwTerminate();
+        return false;
+    }
+
+    Composite = ShaderUtils::Program{};
+    status = Composite.loadShaders(ProgramSources(Composite, Params, ""));
+
+    if (!status)
+    {
+        std::cerr << "can't load the shaders to initiate the multires composite program" << std::endl;
+        glfwTerminate();
+        return false;
+    }
+
+    Temporal = ShaderUtils::Program{};
+    status = Temporal.loadShaders(ProgramSources(Temporal, Params, FovVariant));
+
+    if (!status)
+    {
+        std::cerr << "can't load the shaders to initiate the temporal reconstruction program" << std::endl;
+        glfwTerminate();
+        return false;
+    }
+
+    // the spatial reconstruction runs as a compute shader when the context has it, else as a fragment pass.
+    // CPU rasterizers run compute shaders several times slower than fragments (3-5x on llvmpipe), auto skips them
+    ComputeProg = ShaderUtils::Program{};
+    ReconstructionEngine Engine = Params.FRParams.Engine;
+    const std::string RendererName = reinterpret_cast<const char *>(renderer);
+    if (Engine == ReconstructionEngine::Auto &&
+        (RendererName.find("llvmpipe") != std::string::npos || RendererName.find("softpipe") != std::string::npos ||
+         RendererName.find("SwiftShader") != std::string::npos))
+        Engine = ReconstructionEngine::Fragment;
+    if (Engine != ReconstructionEngine::Fragment && !Params.FRParams.compute_shader.empty())
+    {
+        if (!LoadCompute())
+            std::cout << "No GL 4.3 compute shaders, reconstructing with the fragment pass" << std::endl;
+        else
+        {
+            bComputeReconstruction =
+                ComputeProg.loadShaders(ProgramSources(ComputeProg, Params, FovVariant + ComputeDefines));
+            if (!bComputeReconstruction)
+                std::cerr << "can't load the compute reconstruction, using the fragment pass" << std::endl;
+        }
+    }
+    else if (Engine == ReconstructionEngine::Compute)
+        std::cerr << "no fr_compute_shader, reconstructing with the fragment pass" << std::endl;
+    if (bComputeReconstruction)
+        std::cout << "Reconstructing with the compute shader" << std::endl;
+
+    // compile every other main shader (and hot reloads) in the background so switching doesn't stall
+    // (not when benchmarking or replaying, the compiles would compete with the measured frames)
+    const bool bMeasuring = Params.BenchParams.bEnable || !Params.TraceParams.replay.empty();
+    if ((Params.MainParams.bPrecompile || Params.bHotReload) && !bMeasuring)
+    {
+        if (!ShaderUtils::Precompiler::HasParallelCompile())
+        {
+            glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+            WorkerWindow = glfwCreateWindow(1, 1, "", nullptr, window);
+        }
+        Precompile.Init(WorkerWindow);
+        for (ShaderUtils::Program *P : {&PostProc, &MaskProg, &Composite, &Temporal, &ComputeProg})
+            P->SetPrecompiler(&Precompile);
+        Main.SetPrecompiler(&Precompile);
+        Main.PrecompileAll(Params);
+    }
+
+    if (Params.bHotReload && !bMeasuring)
+    {
+        Watcher.Init();
+        Watcher.Watch(Params.FilePath);
+        Watcher.Watch(Params.MainParams.fragment_shader_dir);
+        for (const std::string &Path :
+             {Params.MainParams.vertex_shader_path, Params.MainParams.non_fr_fragment_shader_path,
+              Params.FRParams.drop_shader, Params.FRParams.reconstruction_shader, Params.FRParams.mask_shader,
+              Params.FRParams.multires_shader, Params.FRParams.temporal_shader, Params.FRParams.common_shader,
+              Params.FRParams.compute_shader, Params.FRParams.tile_shader})
+            Watcher.Watch(Path);
+    }
+
     // glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
     const float CanvasVerts[] = {
@@ -358,6 +1263,11 @@ bool Renderer::Init()
     // create frame buffer object
     if (!GenerateFBO())
         return false;
+    // per-frame state shared by every program (bound once, see ShaderUtils::FrameStateBinding)
+    glGenBuffers(1, &FrameUBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, FrameUBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(ShaderUtils::FrameState), NULL, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, ShaderUtils::FrameStateBinding, FrameUBO);
     // create vertex buffer object
     glGenBuffers(1, &VBO); // generate 1 vertex buffer object
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
@@ -373,103 +1283,663 @@ bool Renderer::Init()
     glVertexAttribPointer(0, stride, GL_FLOAT, bNoramalize, stride * sizeof(float), offset);
     glEnableVertexAttribArray(0);
 
-    // disable vsync
-    bEnableVsync = Params.bEnableVsync;
+    // the reconstruction's tiles: the same corners, instanced once per tile (see UpdateTiles)
+    glGenBuffers(1, &TileVBO);
+    glGenVertexArrays(1, &TileVAO);
+    glBindVertexArray(TileVAO);
+    glVertexAttribPointer(0, stride, GL_FLOAT, bNoramalize, stride * sizeof(float), offset); // still VBO
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, TileVBO);
+    glVertexAttribIPointer(1, 4, GL_SHORT, 5 * sizeof(int16_t), offset);
+    glVertexAttribIPointer(2, 1, GL_SHORT, 5 * sizeof(int16_t), (void *)(4 * sizeof(int16_t)));
+    for (const int Attrib : {1, 2})
+    {
+        glEnableVertexAttribArray(Attrib);
+        glVertexAttribDivisor(Attrib, 1);
+    }
+    glBindVertexArray(VAO);
+
+    // disable vsync (always when replaying, it would only measure the refresh rate)
+    bEnableVsync = Params.bEnableVsync && !bMeasuring;
     glfwSwapInterval(bEnableVsync);
 
+    // GPU timings are only needed for the debug title, the adaptive foveation, benchmark & timeline
+    if ((Params.bEnableDebugMode || Params.AdaptiveParams.bEnable || bMeasuring || Timeline::IsOn()) &&
+        !Profiler.Init())
+        std::cerr << "unable to create GPU timer queries, continuing without GPU timings" << std::endl;
+    SyncGpuClock();
+
+    if (Params.CaptureParams.bEnable && !Capture.Start(Params.CaptureParams))
+        std::cerr << "continuing without capturing frames" << std::endl;
+
+    if (!Params.BenchParams.bEnable && !StartTrace())
+    {
+        std::cerr << "can't start the input trace" << std::endl;
+        return false;
+    }
+
+    // the benchmark keeps a fixed foveal center, replays the recorded one
+    if (!bMeasuring)
+    {
+        GazeInput = Gaze::MakeProvider(Params.GazeParams);
+        if (!GazeInput->Start())
+        {
+            std::cerr << "continuing with the gaze from the mouse" << std::endl;
+            GazeInput = std::make_unique<Gaze::MouseProvider>();
+            GazeInput->Start();
+        }
+        if (!Params.params_socket.empty() && !ParamInput.Open(Params.params_socket))
+            std::cerr << "continuing without the params socket" << std::endl;
+    }
+
     return true;
 }
 
 void Renderer::RenderPass()
 {
-    const double TimeStart = glfwGetTime();
+    const Timeline::Span Span("RenderPass");
+    if (UseMultiRes())
+    {
+        MultiResPass();
+        return;
+    }
+
+    Main.SetDefines(Params, FovVariant);
     int MainProgram = Main.GetProgram();
 
-    // first, render to default framebuffer
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    // the stencil mask lives in the offscreen targets, so masked frames always render there
+    const bool bStencilMask = UseStencilMask();
+    if (Params.bEnablePostProcessing || bStencilMask)
+    {
+        // render into the offscreen target that the previous frame was *not* written to, so this
+        // frame doesn't have to wait on the previous reconstruction pass still sampling it
+        TargetIdx = 1 - TargetIdx;
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO[TargetIdx]);
+    }
+    else
+    {
+        // without reconstruction the main pass is the final image
+        glBindFramebuffer(GL_FRAMEBUFFER, OutputFBO);
+    }
 
-    // Clear canvas
+    // Clear canvas (dropped pixels stay cleared)
     glClearColor(0.f, 0.f, 0.f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
 
+    if (bStencilMask)
+    {
+        UpdateStencilMask(); // no-op unless the drop pattern changed
+        // only shade where this frame's phase bit is unset (kept pixels)
+        glEnable(GL_STENCIL_TEST);
+        glStencilFunc(GL_EQUAL, 0, 1 << (FrameCount % NumPhases()));
+        glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+    }
+
     // Draw main shader
     glUseProgram(MainProgram);
-    TalkWithProgram(MainProgram);
+    TalkWithProgram(Main);
     glBindVertexArray(VAO);
 
     // peform the drawing
+    Profiler.BeginPass(GpuProfiler::DropPass);
     glDrawArrays(GL_TRIANGLES, 0, 6); // 2 (3 vertex) triangles for rect
+    Profiler.EndPass(GpuProfiler::DropPass);
+
+    if (bStencilMask)
+    {
+        glDisable(GL_STENCIL_TEST);
+        if (!Params.bEnablePostProcessing)
+        {
+            // debug view of the raw drop pattern (no reconstruction), needs to reach the output
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO[TargetIdx]);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, OutputFBO);
+            glBlitFramebuffer(0, 0, WindowW, WindowH, 0, 0, WindowW, WindowH, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        }
+    }
+}
+
+void Renderer::BufferPasses()
+{
+    const Timeline::Span Span("BufferPasses");
+    // follows the main shader (and the foveation its buffers were built for)
+    const std::string &Path = Main.GetShaderPath(Main.CurrentShader());
+    if (!Graph.IsCurrent(Path, Params))
+    {
+        Graph.Load(Path, Params, FovVariant, &Precompile); // nothing for a single .glsl
+        if (PassGraph::IsMultipass(Path) && Params.bHotReload && !IsReplaying())
+            Watcher.Watch(Path);
+    }
+    if (!Graph.IsLoaded())
+        return;
+    Graph.Allocate(WindowW, WindowH); // no-op unless the window was resized
+    Graph.SetDefines(FovVariant);
+
+    // every pixel of a target is written (the drop shader clears the dropped ones), no need to clear them
+    Profiler.BeginPass(GpuProfiler::BufferPass);
+    for (int Idx = 0; Idx < Graph.NumBuffers(); Idx++)
+    {
+        const PassGraph::Pass &B = Graph.Buffer(Idx);
+        const int Output = Graph.Output(Idx);
+        const bool bDropped = Graph.IsDropped(Idx);
+        glBindFramebuffer(GL_FRAMEBUFFER, Graph.Framebuffer(bDropped ? B.Scratch : Output));
+        glViewport(0, 0, std::max(WindowW >> B.Level, 1), std::max(WindowH >> B.Level, 1));
+        glUseProgram(B.Prog->GetProgram());
+        TalkWithProgram(*B.Prog, B.Level, Idx);
+        glBindVertexArray(VAO);
+        glDrawArrays(GL_TRIANGLES, 0, 6); // 2 (3 vertex) triangles for rect
+        if (!bDropped)
+            continue;
+
+        // reconstructed like the image (PostprocessingPass), the full quality box copied & the rest infilled
+        PostProc.SetDefines(FovVariant);
+        UpdateTiles(); // no-op unless the drop pattern changed
+        glBindTexture(GL_TEXTURE_2D, Graph.Texture(B.Scratch));
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, Graph.Framebuffer(B.Scratch));
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, Graph.Framebuffer(Output));
+        const int *Box = FullBox[0]; // a single view
+        if (Box[0] < Box[2])
+            glBlitFramebuffer(Box[0], Box[1], Box[2], Box[3], Box[0], Box[1], Box[2], Box[3], GL_COLOR_BUFFER_BIT,
+                              GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, Graph.Framebuffer(Output));
+        glUseProgram(PostProc.GetProgram());
+        glBindVertexArray(TileVAO);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, 6, NumTiles); // 2 (3 vertex) triangles per tile
+    }
+    Profiler.EndPass(GpuProfiler::BufferPass);
+    glViewport(0, 0, WindowW, WindowH);
+}
+
+bool Renderer::UseMultiRes() const
+{
+    return Params.bEnableFovRender && Params.FRParams.Strategy == FovStrategy::MultiRes;
+}
+
+void Renderer::MultiResPass()
+{
+    // render the expensive shader once per level, each restricted to the box that the composite samples
+    int MainProgram = Main.GetProgram();
+    const float Extent[3] = {
+        Frame.view[0].radius[1], // full resolution until fully blended into half resolution
+        Frame.view[0].radius[2], // half resolution until fully blended into quarter resolution
+        0.f,                     // quarter resolution everywhere
+    };
+    const float Aspect = Fov.aspect; // the rings are that much wider than tall
+    const float CenterX = GazeX[0]; // multires only renders a single view
+    const float CenterY = WindowH - GazeY[0]; // GL window coordinates are bottom-up
+    TargetIdx = 1 - TargetIdx;
 
-    if (Params.bEnableDebugMode)
+    glUseProgram(MainProgram);
+    glBindVertexArray(VAO);
+    glClearColor(0.f, 0.f, 0.f, 1.0f);
+    Profiler.BeginPass(GpuProfiler::DropPass);
+    for (int Level = 0; Level < 3; Level++)
     {
-        // measure total runtime of this pass
-        glFinish(); // wait until GPU pipelining is done for this frame
-        // this is costly as it effectively incurs a flush and limits parallelism
+        const int LevelW = std::max(WindowW >> Level, 1);
+        const int LevelH = std::max(WindowH >> Level, 1);
+        glBindFramebuffer(GL_FRAMEBUFFER, Level == 0 ? FBO[TargetIdx] : LevelFBO[Level - 1]);
+        glViewport(0, 0, LevelW, LevelH);
+        if (Level < 2)
+        {
+            // (level-space) bounding box of the ring, with a pixel of margin for the bilinear upsample
+            const float Scale = 1.f / (1 << Level);
+            const int X0 = static_cast<int>(std::floor((CenterX - Aspect * Extent[Level]) * Scale)) - 1;
+            const int Y0 = static_cast<int>(std::floor((CenterY - Extent[Level]) * Scale)) - 1;
+            const int X1 = static_cast<int>(std::ceil((CenterX + Aspect * Extent[Level]) * Scale)) + 1;
+            const int Y1 = static_cast<int>(std::ceil((CenterY + Extent[Level]) * Scale)) + 1;
+            glEnable(GL_SCISSOR_TEST);
+            glScissor(X0, Y0, std::max(X1 - X0, 0), std::max(Y1 - Y0, 0));
+        }
+        glClear(GL_COLOR_BUFFER_BIT);
+        TalkWithProgram(Main, Level);
+        glDrawArrays(GL_TRIANGLES, 0, 6); // 2 (3 vertex) triangles for rect
+        glDisable(GL_SCISSOR_TEST);
+    }
+    Profiler.EndPass(GpuProfiler::DropPass);
+    glViewport(0, 0, WindowW, WindowH);
+}
 
-        TimeFragmentShaderSec += glfwGetTime() - TimeStart;
+void Renderer::CompositePass()
+{
+    int CompositeProgram = Composite.GetProgram();
+    const GLuint LevelTextures[3] = {Tex[TargetIdx], LevelTex[0], LevelTex[1]};
+
+    glBindFramebuffer(GL_FRAMEBUFFER, OutputFBO); // render on default (or offscreen output) framebuffer
+    glUseProgram(CompositeProgram);
+    for (int Level = 0; Level < 3; Level++)
+    {
+        // sampler "level<i>" reads texture unit i
+        glActiveTexture(GL_TEXTURE0 + Level);
+        glBindTexture(GL_TEXTURE_2D, LevelTextures[Level]);
     }
+    glActiveTexture(GL_TEXTURE0);
+    glBindVertexArray(VAO);
+    Profiler.BeginPass(GpuProfiler::ReconstructionPass);
+    glDrawArrays(GL_TRIANGLES, 0, 6); // 2 (3 vertex) triangles for rect
+    Profiler.EndPass(GpuProfiler::ReconstructionPass);
+}
+
+void Renderer::TemporalPass()
+{
+    // reconstruct into the history target the previous frame did not write, reading the other one
+    Temporal.SetDefines(FovVariant);
+    int TemporalProgram = Temporal.GetProgram();
+    const int NextIdx = 1 - HistoryIdx;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, HistoryFBO[NextIdx]);
+    glUseProgram(TemporalProgram);
+    glActiveTexture(GL_TEXTURE0); // sampler "tex"
+    glBindTexture(GL_TEXTURE_2D, Tex[TargetIdx]);
+    glActiveTexture(GL_TEXTURE1); // sampler "history"
+    glBindTexture(GL_TEXTURE_2D, HistoryTex[HistoryIdx]);
+    glActiveTexture(GL_TEXTURE0);
+    glBindVertexArray(VAO);
+    Profiler.BeginPass(GpuProfiler::ReconstructionPass);
+    glDrawArrays(GL_TRIANGLES, 0, 6); // 2 (3 vertex) triangles for rect
+    // the default framebuffer can't be sampled next frame, so the history is copied out instead
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, HistoryFBO[NextIdx]);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, OutputFBO);
+    glBlitFramebuffer(0, 0, WindowW, WindowH, 0, 0, WindowW, WindowH, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    Profiler.EndPass(GpuProfiler::ReconstructionPass);
+    HistoryIdx = NextIdx;
+}
+
+void Renderer::ComputeReconstructionPass()
+{
+    // every workgroup infills a tile of the dropped frame from shared memory, into an image that is then blitted
+    ComputeProg.SetDefines(FovVariant + ComputeDefines);
+    glUseProgram(ComputeProg.GetProgram());
+    glBindTexture(GL_TEXTURE_2D, Tex[TargetIdx]); // sampler "tex"
+    BindImageTextureGL(0, ComputeTex, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+    Profiler.BeginPass(GpuProfiler::ReconstructionPass);
+    DispatchComputeGL((WindowW + ComputeTile - 1) / ComputeTile, (WindowH + ComputeTile - 1) / ComputeTile, 1);
+    MemoryBarrierGL(GL_FRAMEBUFFER_BARRIER_BIT); // the image stores have to land before the blit reads them
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, ComputeFBO);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, OutputFBO);
+    glBlitFramebuffer(0, 0, WindowW, WindowH, 0, 0, WindowW, WindowH, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    Profiler.EndPass(GpuProfiler::ReconstructionPass);
 }
 
 void Renderer::PostprocessingPass()
 {
+    const Timeline::Span Span("PostprocessingPass");
+    if (UseMultiRes())
+    {
+        CompositePass(); // the levels always need compositing, regardless of the postprocessing toggle
+        return;
+    }
+
+    if (Params.bEnablePostProcessing && UseTemporal())
+    {
+        TemporalPass();
+        return;
+    }
+
+    if (Params.bEnablePostProcessing && bComputeReconstruction)
+    {
+        ComputeReconstructionPass();
+        return;
+    }
+
     if (Params.bEnablePostProcessing)
     {
-        const double TimeStart = glfwGetTime();
+        PostProc.SetDefines(FovVariant);
         int ReconstructionProgram = PostProc.GetProgram();
-        // copy framebuffer (current rendered buffer) to FBO (& its texture)
-        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
-        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
-        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, FBO);
-        glBlitFramebuffer(0, 0, WindowW, WindowH, 0, 0, WindowW, WindowH, GL_COLOR_BUFFER_BIT, GL_LINEAR);
-        glBindTexture(GL_TEXTURE_2D, Tex); // bind texture to current active texture
-
-        glBindFramebuffer(GL_FRAMEBUFFER, 0); // render on default framebuffer
-        glUseProgram(ReconstructionProgram);
-        TalkWithProgram(ReconstructionProgram);
-        glBindVertexArray(VAO);
-        // peform the drawing
-        glDrawArrays(GL_TRIANGLES, 0, 6); // 2 (3 vertex) triangles for rect
-        if (Params.bEnableDebugMode)
+        UpdateTiles(); // no-op unless the drop pattern changed
+        // sample the offscreen target the main pass just rendered to
+        glBindTexture(GL_TEXTURE_2D, Tex[TargetIdx]); // bind texture to current active texture
+
+        Profiler.BeginPass(GpuProfiler::ReconstructionPass);
+        // the full quality tiles (around the gaze of each view) are copied, then the rest of every view is
+        // infilled tile by tile in one draw
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO[TargetIdx]);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, OutputFBO);
+        for (int View = 0; View < NumViews(Params); View++)
         {
-            glFinish();
-            // accumulate the time to run this pass
-            TimeReconstructShaderSec += glfwGetTime() - TimeStart;
+            const int *Box = FullBox[View];
+            if (Box[0] < Box[2])
+                glBlitFramebuffer(Box[0], Box[1], Box[2], Box[3], Box[0], Box[1], Box[2], Box[3], GL_COLOR_BUFFER_BIT,
+                                  GL_NEAREST);
         }
+        glBindFramebuffer(GL_FRAMEBUFFER, OutputFBO); // render on default (or offscreen output) framebuffer
+        glUseProgram(ReconstructionProgram);
+        glBindVertexArray(TileVAO);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, 6, NumTiles); // 2 (3 vertex) triangles per tile
+        Profiler.EndPass(GpuProfiler::ReconstructionPass);
     }
 }
 
 bool Renderer::Run()
 {
+    if (Params.CpuParams.bEnable)
+        return CpuBackend::RunBenchmark(Params);
     assert(window != nullptr);
+    if (Params.BenchParams.bEnable)
+        return RunBenchmark();
+
+    // events & keys are polled on this thread, the frames render on their own
+    return Input.Run(window, [this] { return RenderFrames(); });
+}
+
+bool Renderer::RenderFrames()
+{
+    Timeline::NameThread("render");
     while (!glfwWindowShouldClose(window))
     {
-        WindowCallbacks(); // check for frame buffer size change
+        ReplayFrameStart = glfwGetTime();
+        const int64_t FrameStart = Timeline::Now();
+
+        WaitForFrameSlot(); // don't queue more than frames_in_flight frames, they'd only add latency
+
+        WindowCallbacks(); // latest frame buffer size & cursor from the input thread
+
+        UpdateGaze(); // latched right before the frame is submitted, extrapolated to scan-out
+
+        Profiler.BeginFrame(FrameCount++);
+
+        UpdateFrameState(); // upload the shared per-frame uniforms
+
+        BufferPasses(); // the buffers the main shader reads (multipass shaders only)
 
         RenderPass(); // perform main draw pass
 
         PostprocessingPass(); // perform postprocessing effects
 
-        glfwPollEvents(); // Poll for and process events
+        Graph.EndFrame(); // the feedback buffers of this frame are read by the next
+
+        Profiler.EndFrame(); // non-blocking, reads back timings of earlier frames
+
+        Capture.Capture(OutputFBO, WindowW, WindowH); // non-blocking, written a few frames later
+
+        Precompile.Poll(); // non-blocking, picks up finished background compiles
 
-        CheckInputs(); // check for miscellaneous input actions
+        HotReload(); // non-blocking, rebuilds whatever changed on disk
+
+        PollParams(); // non-blocking, applies the params sent over the socket
+
+        CheckInputs(); // the key actions taken since the last frame
 
         TickClock(); // tick forward (unless paused) the internal clock
 
+        TraceFrame(); // record the inputs of this frame, or measure the replayed one
+
         DisplayFps(); // display fps in title
 
-        glfwSwapBuffers(window); // Swap front and back buffers
+        {
+            const Timeline::Span Span("SwapBuffers");
+            glfwSwapBuffers(window); // Swap front and back buffers
+        }
+
+        if (Params.frames_in_flight > 0)
+            FrameFences.push_back(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+
+        Timeline::EndFrame(FrameCount - 1, FrameStart, Params.TimelineParams); // dumps after a spike
     }
 
-    return true;
+    for (GLsync Fence : FrameFences)
+        glDeleteSync(Fence);
+    FrameFences.clear();
+    return bReplayWritten;
+}
+
+void Renderer::WaitForFrameSlot()
+{
+    const Timeline::Span Span("WaitForFrameSlot");
+    // the driver would let the CPU run a few frames ahead, each of them rendered with an older gaze
+    while (!FrameFences.empty() && FrameFences.size() >= static_cast<size_t>(std::max(Params.frames_in_flight, 1)))
+    {
+        glClientWaitSync(FrameFences.front(), GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull); // a second at most
+        glDeleteSync(FrameFences.front());
+        FrameFences.pop_front();
+    }
+}
+
+bool Renderer::RunBenchmark()
+{
+    const BenchmarkParamsStruct &B = Params.BenchParams;
+
+    // fixed foveal center for reproducible runs, or the gaze path of a recorded session (one frame per frame)
+    std::vector<InputTrace::Frame> Trace;
+    InputTrace::Header TraceHeader;
+    if (!B.trace.empty() && !InputTrace::Load(B.trace, TraceHeader, Trace))
+        return false;
+    const int NumMeasured = Trace.empty() ? B.num_frames : static_cast<int>(Trace.size());
+    MouseX = 0.5 * WindowW;
+    MouseY = 0.5 * WindowH;
+    std::fill(std::begin(GazeX), std::end(GazeX), 0.5 * ViewW());
+    std::fill(std::begin(GazeY), std::end(GazeY), 0.5 * WindowH);
+
+    std::cout << "Benchmarking " << Main.NumShaders() << " shaders at (" << WindowW << " x " << WindowH << ") for "
+              << NumMeasured << " frames each" << std::endl;
+
+    std::vector<Benchmark::Result> Results;
+    std::string LoadedShader = ""; // force a reload for the first configuration
+    FovReference::Image Truth;     // last frame of the full quality run of TruthShader
+    std::string TruthShader = "";
+    for (size_t ShaderIdx = 0; ShaderIdx < Main.NumShaders(); ShaderIdx++)
+    {
+        for (const Benchmark::Config &C : Benchmark::BuildSweep(B, Main.GetShaderPath(ShaderIdx)))
+        {
+            // full quality runs use the pass-through shader without reconstruction
+            const bool bNeedsReload = (C.Shader != LoadedShader || C.bFoveated != Params.bEnableFovRender ||
+                                       C.Strategy != Params.FRParams.Strategy);
+            Params.bEnableFovRender = C.bFoveated;
+            Params.bEnablePostProcessing = C.bFoveated;
+            Params.FRParams.Strategy = C.Strategy;
+            Params.FRParams.Reconstruction = C.Reconstruction;
+            if (bNeedsReload)
+            {
+                LoadedShader = "";
+                if (!Main.SetShader(Params, ShaderIdx))
+                {
+                    std::cerr << "skipping \"" << C.Shader << "\" (" << C.Mode() << "), failed to load" << std::endl;
+                    continue;
+                }
+                LoadedShader = C.Shader;
+            }
+            if (C.bFoveated)
+            {
+                if (C.Stride > 0)
+                    Params.FRParams.stride = C.Stride;
+                Params.FRParams.radii = C.Thresholds;
+                if (!CheckFovProfile(Params.FRParams) || !CheckViews(Params))
+                {
+                    std::cerr << "skipping the radii " << Benchmark::ThresholdsName(C.Thresholds) << std::endl;
+                    continue;
+                }
+            }
+
+            Benchmark::Result R;
+            R.Cfg = C;
+            Graph.Free(); // feedback buffers start over (black), like the simulated time
+            glFinish(); // don't measure any leftover (compilation) work
+            for (int Frame = 0; Frame < B.num_warmup_frames + NumMeasured; Frame++)
+            {
+                // fixed simulated time step so every configuration renders the same frames
+                CurrentTime = Frame * B.time_step;
+                NumFrames = Frame;
+                FrameCount = Frame; // drop pattern phase
+                if (!Trace.empty())
+                {
+                    // the warmup runs through the start of the trace as well
+                    const int Idx = (Frame < B.num_warmup_frames) ? Frame : Frame - B.num_warmup_frames;
+                    const InputTrace::Frame &T = Trace[Idx % Trace.size()];
+                    std::fill(std::begin(GazeX), std::end(GazeX), T.GazeX * ViewW());
+                    std::fill(std::begin(GazeY), std::end(GazeY), T.GazeY * WindowH);
+                }
+
+                const double TimeStart = glfwGetTime();
+                Profiler.BeginFrame(Frame);
+                UpdateFrameState();
+                BufferPasses();
+                RenderPass();
+                PostprocessingPass();
+                Graph.EndFrame();
+                Profiler.EndFrame();
+                Capture.Capture(OutputFBO, WindowW, WindowH);
+                glFinish(); // frame boundary, wait for the GPU to retire all of this frame's work
+                if (Frame >= B.num_warmup_frames)
+                    R.FrameMs.push_back(1000.0 * (glfwGetTime() - TimeStart));
+            }
+
+            // per-pass GPU timings of the measured frames
+            Profiler.Flush();
+            for (int P = 0; P < GpuProfiler::NumPasses; P++)
+            {
+                R.PassNames.push_back(GpuProfiler::PassName(static_cast<GpuProfiler::Pass>(P)));
+                R.PassMs.push_back(std::vector<double>(R.FrameMs.size(), 0.0));
+            }
+            for (const auto &T : Profiler.Collect())
+            {
+                if (T.FrameId < static_cast<uint64_t>(B.num_warmup_frames))
+                    continue;
+                for (int P = 0; P < GpuProfiler::NumPasses; P++)
+                    R.PassMs[P].at(T.FrameId - B.num_warmup_frames) = T.Ms[P];
+            }
+            // every run ends on the same simulated time, so the last frames are directly comparable
+            if (B.bQuality)
+            {
+                FovReference::Image Last;
+                ReadPixels(OutputFBO, Last);
+                if (!C.bFoveated)
+                {
+                    Truth = Last;
+                    TruthShader = C.Shader;
+                }
+                R.bHasQuality = (TruthShader == C.Shader);
+                if (R.bHasQuality)
+                    R.Quality = ImageQuality::Compare(Truth, Last, CurrentPattern());
+            }
+            if (B.bVerify && C.bFoveated && C.Strategy == FovStrategy::Checkerboard &&
+                C.Reconstruction == ReconstructionMode::Spatial)
+                VerifyReconstruction();
+
+            R.Summarize();
+            std::cout << "[" << C.Mode() << " stride=" << C.Stride
+                      << " thresh=" << Benchmark::ThresholdsName(C.Thresholds) << "] mean: " << R.Mean
+                      << "ms p50: " << R.P50 << "ms p95: " << R.P95 << "ms p99: " << R.P99 << "ms";
+            for (size_t P = 0; P < R.PassNames.size(); P++)
+                std::cout << " " << R.PassNames[P] << ": " << R.PassMean[P] << "ms";
+            std::cout << std::endl;
+            Results.push_back(R);
+        }
+    }
+
+    Benchmark::ComputeSpeedups(Results);
+    Benchmark::PrintComparison(Results);
+    Benchmark::PrintPareto(Results);
+    const bool bWritten = Benchmark::WriteResults(B.output_prefix, Results);
+    return Benchmark::CheckQuality(B, Results) && bWritten;
+}
+
+FovReference::Pattern Renderer::CurrentPattern(const int View) const
+{
+    const ShaderUtils::FovView &V = Frame.view[View];
+    FovReference::Pattern P;
+    P.Stride = Frame.stride;
+    P.NumLevels = Frame.levels;
+    P.AspectW = V.aspect_w;
+    for (int i = 0; i < FovReference::MaxLevels; i++)
+    {
+        P.Radius[i] = V.radius[i];
+        P.Keep[i] = V.keep[i];
+    }
+    P.GazeX = V.Mouse[0];
+    P.GazeY = V.Mouse[1];
+    P.Phase[0] = Frame.phase[0];
+    P.Phase[1] = Frame.phase[1];
+    return P;
+}
+
+void Renderer::ReadPixels(const GLuint Framebuffer, FovReference::Image &Img, const int X, const int W)
+{
+    Img.Resize(W < 0 ? WindowW - X : W, WindowH);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, Framebuffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(X, 0, Img.W, Img.H, GL_RGBA, GL_UNSIGNED_BYTE, Img.Pixels.data());
+}
+
+void Renderer::VerifyReconstruction()
+{
+    // the drop pass output of the last frame is still in its offscreen target, reconstruct it on the CPU.
+    // Every view is a frame of its own to the reference
+    const int Views = NumViews(Params);
+    for (int View = 0; View < Views; View++)
+    {
+        FovReference::Image Dropped, Gpu;
+        ReadPixels(FBO[TargetIdx], Dropped, View * ViewW(), ViewW());
+        ReadPixels(OutputFBO, Gpu, View * ViewW(), ViewW());
+
+        const FovReference::Pattern P = CurrentPattern(View);
+
+        // every pixel the reference drops must have been cleared by the drop pass
+        int MaskErrors = 0;
+        for (int y = 0; y < Dropped.H; y++)
+        {
+            for (int x = 0; x < Dropped.W; x++)
+            {
+                const uint8_t *Px = Dropped.At(x, y);
+                if (!FovReference::Kept(P, Dropped.H, x, y) && (Px[0] | Px[1] | Px[2]) != 0)
+                    MaskErrors++;
+            }
+        }
+
+        std::cout << "[verify" << (Views > 1 ? " view " + std::to_string(View) : "") << "] mask errors: " << MaskErrors;
+        for (const auto B :
+             {FovReference::Backend::Reference, FovReference::Backend::Scalar, FovReference::Backend::Simd})
+        {
+            FovReference::Image Cpu;
+            const double Start = glfwGetTime();
+            FovReference::Reconstruct(P, Dropped, Cpu, B);
+            const double Ms = 1000.0 * (glfwGetTime() - Start);
+
+            // rounding may differ by one between GPU & CPU
+            int MaxDiff = 0, NumOff = 0;
+            for (size_t i = 0; i < Cpu.Pixels.size(); i++)
+            {
+                const int Diff = std::abs(int(Cpu.Pixels[i]) - int(Gpu.Pixels[i]));
+                MaxDiff = std::max(MaxDiff, Diff);
+                NumOff += (Diff > 1);
+            }
+            std::cout << " " << FovReference::BackendName(B) << ": " << Ms << "ms (max diff " << MaxDiff << ", "
+                      << NumOff << " off by more than 1)";
+        }
+        std::cout << std::endl;
+    }
 }
 
 bool Renderer::Exit()
 {
     std::cout << std::endl << "Goodbye!" << std::endl;
+    if (Params.CpuParams.bEnable)
+        return true;
     glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &FBO);
-    glDeleteTextures(1, &Tex);
+    glDeleteBuffers(1, &FrameUBO);
+    glDeleteFramebuffers(2, FBO);
+    glDeleteTextures(2, Tex);
+    glDeleteRenderbuffers(1, &MaskRBO);
+    glDeleteFramebuffers(2, LevelFBO);
+    glDeleteTextures(2, LevelTex);
+    glDeleteFramebuffers(2, HistoryFBO);
+    glDeleteTextures(2, HistoryTex);
+    glDeleteFramebuffers(1, &OutputFBO);
+    glDeleteTextures(1, &OutputTex);
+    glDeleteFramebuffers(1, &ComputeFBO);
+    glDeleteTextures(1, &ComputeTex);
+    glDeleteBuffers(1, &TileVBO);
+    glDeleteVertexArrays(1, &TileVAO);
     glDeleteVertexArrays(1, &VAO);
+    Capture.Stop();
+    Recorder.Close();
+    if (GazeInput != nullptr)
+        GazeInput->Stop();
+    ParamInput.Close();
+    Graph.Clear();
+    Timeline::Stop();
+    Profiler.Destroy();
+    Watcher.Destroy();
+    Precompile.Destroy();
+    if (WorkerWindow != nullptr)
+        glfwDestroyWindow(WorkerWindow);
     glfwTerminate();
     return true;
 }
\ No newline at end of file
@@ -1,72 +1,193 @@
 #ifndef RENDERER_H
 #define RENDERER_H
 
-#ifdef __APPLE__
-#define GL_SILENCE_DEPRECATION
-#define GLFW_INCLUDE_GLCOREARB
-#include <GLFW/glfw3.h>
-#else
-#include <GL/gl.h>
-#include <GL/glut.h>
-#endif
-
+#include "benchmark.h"
+#include "file_watcher.h"
+#include "frame_capture.h"
+#include "fov_controller.h"
+#include "fov_reference.h"
+#include "gaze.h"
+#include "gl_headers.h"
+#include "gpu_profiler.h"
+#include "input_thread.h"
+#include "input_trace.h"
+#include "param_socket.h"
+#include "pass_graph.h"
+#include "shader_cache.h"
 #include "shader_utils.h"
 #include "utils.h"
+#include <deque>
 
 class Renderer
 {
   private:
     bool CreateWindow();
     void DisplayFps();
-    void TalkWithProgram(int ProgramIdx);
-    void CheckInputs();
+    void CollectGpuTimings();
+    void SyncGpuClock(); // of the timeline
+    void UpdateFrameState();
+    void SelectVariant(); // specializes the foveation programs for Fov
+    // FoveationDefines of P's profiles with the adaptive steps taken (and Offset more)
+    std::string VariantOf(const ParamsStruct &P, int Offset = 0) const;
+    std::vector<ShaderUtils::Program *> VariantPrograms(const ParamsStruct &P); // specialized ones P renders with
+    void PrebuildVariant(const ParamsStruct &P, const std::string &D); // every program P renders with, for D
+    bool IsVariantBuilt(const ParamsStruct &P, const std::string &D);
+    void TalkWithProgram(const ShaderUtils::Program &P, int Level = 0, int Pass = -1); // Pass of Graph, -1 the image
+    void CheckInputs(); // applies the key actions taken since the last frame
+    void ApplyAction(InputTrace::Action A); // from a key press or the replayed trace
+    void UpdateGaze();
+    int ViewW() const;               // width of a view, the window holds NumViews of them side by side
+    double InView(double X) const;   // window x (of the cursor) to the same point in a view
+    const FRShaderParams &ViewFov(int View) const;
+    void HotReload();
+    void ReloadParams(); // re-reads the params file, applying the keys whose value changed
+    // applies changed keys (params file or socket), keeping the last valid foveation profile
+    void SetParams(const std::vector<std::pair<std::string, std::string>> &Changes);
+    void TakePendingParams(); // swaps in the staged params once the programs for them are built
+    void ApplyParams(const ParamsStruct &Previous, unsigned Stages); // redoes what depends on the changed params
+    void PollParams(); // the params socket & the staged params, never blocks
+    // sources of the programs other than Main for P
+    std::vector<ShaderUtils::Shader> ProgramSources(const ShaderUtils::Program &Prog, const ParamsStruct &P,
+                                                    const std::string &Defines) const;
     void TickClock();
+    bool StartTrace(); // opens the recording or loads the replay
+    void TraceFrame(); // end of frame, writes the recorded inputs or measures the replayed frame
+    bool IsReplaying() const;
+    int ShaderFrame() const; // iFrame
     bool GenerateFBO();
+    bool GenerateOutputTarget();
+    bool UseStencilMask() const;
+    void UpdateStencilMask();
+    void UpdateTiles(); // classifies the reconstruction's tiles
+    bool UseTemporal() const;
+    int NumPhases() const;
+    void DropPhase(int Idx, int Phase[2]) const;
 
     // callbacks
     void WindowCallbacks();
 
     // render thread
+    bool RenderFrames(); // until the window closes
+    void WaitForFrameSlot(); // keeps at most frames_in_flight frames queued on the GPU
+    void BufferPasses();     // of a multipass main shader, before the image (RenderPass)
     void RenderPass();
     void PostprocessingPass();
+    bool UseMultiRes() const;
+    void MultiResPass();
+    void CompositePass();
+    void TemporalPass();
+    void ComputeReconstructionPass();
+
+    // headless benchmark
+    bool RunBenchmark();
+    FovReference::Pattern CurrentPattern(int View = 0) const; // a view's drop pattern in the last FrameState
+    void ReadPixels(GLuint Framebuffer, FovReference::Image &Img, int X = 0, int W = -1); // W -1 to the right
+    void VerifyReconstruction(); // CPU reference vs the last frame's reconstruction
 
     ParamsStruct Params;
+    std::map<std::string, std::string> FileParams; // every key of the params file as last read, to diff rereads
+    // changes that need a main program that isn't built yet, rendering goes on with Params until it is
+    ParamsStruct PendingParams;
+    unsigned PendingStages = 0; // ParamStage flags of the staged changes
+    bool bParamsPending = false;
+    ParamSocket ParamInput; // live key=value updates (params_socket)
+    FRShaderParams Fov;     // foveation params of this frame, Params.FRParams with the adaptive steps taken
+    FRShaderParams RightFov; // the right view's (views), with the same steps taken
+    FovController Adaptive; // holds the GPU frame time budget by stepping Fov (adaptive)
+    std::string FovVariant; // #define preamble the foveation programs are specialized with for Fov
 
     // buffer objects
-    GLuint FBO, VBO, VAO, Tex;
+    GLuint VBO, VAO;
+    GLuint FrameUBO = 0; // ShaderUtils::FrameState, uploaded once per frame
+    ShaderUtils::FrameState Frame = {}; // what was last uploaded to FrameUBO
+    // ping-pong pair of offscreen targets the drop pass renders into (sampled by the reconstruction)
+    GLuint FBO[2] = {0, 0}, Tex[2] = {0, 0};
+    int TargetIdx = 0; // target written by the current frame
+    // half & quarter resolution targets of the multires strategy (full resolution uses FBO/Tex)
+    GLuint LevelFBO[2] = {0, 0}, LevelTex[2] = {0, 0};
+    // depth-stencil attachment shared by both targets, holds the drop mask
+    GLuint MaskRBO = 0;
+    // ping-pong pair of reconstructed frames for temporal reconstruction (previous one is the history)
+    GLuint HistoryFBO[2] = {0, 0}, HistoryTex[2] = {0, 0};
+    int HistoryIdx = 0; // history written by the last frame
+    // target of the compute reconstruction (reconstruction_engine), blitted to the output
+    GLuint ComputeFBO = 0, ComputeTex = 0;
+    bool bComputeReconstruction = false;
+
+    // everything the stencil mask depends on, it is only regenerated when this changes
+    struct MaskState
+    {
+        int Stride, W, H, Phases;
+        std::vector<int> GazeCells;              // x & y of every view's
+        std::vector<float> Radii, Keep, Aspects; // of every view, one after the other
+        bool operator==(const MaskState &Other) const;
+    };
+    MaskState CurrentMaskState() const;
+    MaskState LastMask;
+    bool bMaskValid = false;
+    // tiles of the spatial reconstruction that need infilling (instanced quads), classified for LastTiles
+    GLuint TileVAO = 0, TileVBO = 0;
+    int NumTiles = 0;
+    // bounding box (x0, y0, x1, y1) of the full quality tiles of every view, copied instead
+    int FullBox[MaxViews][4] = {};
+    MaskState LastTiles;
+    bool bTilesValid = false;
+    // final render target, the default framebuffer (0) unless rendering offscreen
+    GLuint OutputFBO = 0, OutputTex = 0;
 
     // window params
     int WindowW, WindowH;
-    int LastWindowW, LastWindowH; // checking for window resize
+    int LastWindowW = 0, LastWindowH = 0; // checking for window resize
     bool bEnableVsync = false;
-    bool bIsHiDPI = false; // assume not hiDPI, check on window resize
+    std::deque<GLsync> FrameFences; // end of every frame still in flight, oldest first
 
     // other
     double CurrentTime = 0.0;
     double LastTime = 0.0;
     double LastTimeFps = 0.0; // last time but only refreshed for the fps counter
     int NumFrames = 0;
-    double TimeFragmentShaderSec = 0.f;    // cumulative time that the fragment shader took
-    double TimeReconstructShaderSec = 0.f; // cumulative time that the reconstruction shader took
-    bool bTickClock = true;                // start ticking
+    uint64_t FrameCount = 0; // total frames rendered, tags the (late arriving) GPU timings
+    bool bTickClock = true;  // start ticking
+
+    // GPU timer queries (debug mode & benchmark)
+    GpuProfiler Profiler;
+    FrameCapture Capture; // final frames, streamed out through PBOs (capture)
+    double GpuPassMs[GpuProfiler::NumPasses] = {}; // cumulative GPU time (ms) per pass since last fps update
+    int GpuPassFrames = 0;                         // number of frames accumulated in GpuPassMs
 
     // input params
+    InputThread Input;  // polls the window's events on the main thread, the frames render on their own
+    InputState Inputs;  // window size & cursor as last latched from Input
     double MouseX, MouseY;
-    // button press rising-edge actions
-    bool bPausePressed = false;
-    bool bReloadPressed = false;
-    bool bPrevPressed = false;
-    bool bNextPressed = false;
-    bool bUpPressed = false;
-    bool bDownPressed = false;
-    bool bPPTogglePressed = false;
+    // foveal center of every view (view pixels, y down), the predicted gaze or the mouse
+    double GazeX[MaxViews] = {}, GazeY[MaxViews] = {};
+    std::unique_ptr<Gaze::Provider> GazeInput;
+    Gaze::Predictor GazePredict[MaxViews];
+
+    // input trace (trace_record & trace_replay)
+    InputTrace::Writer Recorder;
+    InputTrace::Frame RecordFrame;         // inputs of the current frame
+    std::vector<InputTrace::Frame> Replay; // every frame of the replayed session
+    size_t ReplayIdx = 0;                  // frame being replayed (Replay.size() once done)
+    Benchmark::Result ReplayResult;        // timings of the replayed frames
+    double ReplayFrameStart = 0.0;
+    bool bReplayWritten = true;
+    bool bMouseDown = false; // left button, latched once per frame
 
     // window
     GLFWwindow *window = nullptr;
+    GLFWwindow *WorkerWindow = nullptr; // hidden, shares objects with window for background shader compiles
 
     // shader programs
     ShaderUtils::MainProgram Main;
     ShaderUtils::Program PostProc;
+    ShaderUtils::Program MaskProg;
+    ShaderUtils::Program Composite;
+    ShaderUtils::Program Temporal;
+    ShaderUtils::Program ComputeProg;
+    PassGraph Graph; // buffer passes of the main shader if it's a multipass one
+    ShaderUtils::Precompiler Precompile;
+    FileWatcher Watcher; // shader sources & params file (hot_reload)
 
   public:
     Renderer(int argc, char *argv[]);
@@ -0,0 +1,393 @@
+#include "shader_cache.h"
+#include "timeline.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+namespace ShaderUtils
+{
+
+namespace BinaryCache
+{
+
+static bool bEnabled = false;
+static std::filesystem::path CacheDir;
+static std::string Driver; // renderer & version, binaries are only valid for the exact same driver
+
+bool Init(const std::string &Dir)
+{
+    bEnabled = false;
+    if (Dir.empty())
+        return false;
+
+    GLint NumFormats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &NumFormats);
+    if (NumFormats <= 0)
+    {
+        std::cout << "Driver doesn't support program binaries, not caching shaders" << std::endl;
+        return false;
+    }
+
+    std::error_code Err;
+    std::filesystem::create_directories(Dir, Err);
+    if (Err)
+    {
+        std::cerr << "can't create shader cache \"" << Dir << "\": " << Err.message() << std::endl;
+        return false;
+    }
+    CacheDir = Dir;
+    Driver = std::string(reinterpret_cast<const char *>(glGetString(GL_RENDERER))) + "|" +
+             reinterpret_cast<const char *>(glGetString(GL_VERSION));
+    bEnabled = true;
+    std::cout << "Caching program binaries in \"" << Dir << "\"" << std::endl;
+    return true;
+}
+
+static void Hash(uint64_t &H, const void *Data, const size_t Size)
+{
+    // 64 bit FNV-1a
+    const unsigned char *Bytes = static_cast<const unsigned char *>(Data);
+    for (size_t i = 0; i < Size; i++)
+    {
+        H ^= Bytes[i];
+        H *= 0x100000001b3ull;
+    }
+}
+
+uint64_t Key(const std::vector<Shader> &Shaders)
+{
+    uint64_t H = 0xcbf29ce484222325ull;
+    Hash(H, Driver.data(), Driver.size());
+    for (const Shader &S : Shaders)
+    {
+        Hash(H, &S.type, sizeof(S.type));
+        Hash(H, S.source.data(), S.source.size());
+    }
+    return H;
+}
+
+static std::filesystem::path EntryPath(const uint64_t Key)
+{
+    std::stringstream ss;
+    ss << std::hex << Key << ".bin";
+    return CacheDir / ss.str();
+}
+
+bool Load(const uint64_t Key, const GLuint Program)
+{
+    if (!bEnabled)
+        return false;
+    std::ifstream In(EntryPath(Key), std::ios::binary);
+    if (!In.is_open())
+        return false;
+
+    // entry layout: binary format (GLenum) followed by the binary itself
+    GLenum Format = 0;
+    if (!In.read(reinterpret_cast<char *>(&Format), sizeof(Format)))
+        return false; // truncated, the program gets compiled (and the entry rewritten)
+    const std::vector<char> Binary((std::istreambuf_iterator<char>(In)), std::istreambuf_iterator<char>());
+    if ((!In.good() && !In.eof()) || Binary.empty())
+        return false;
+    glProgramBinary(Program, Format, Binary.data(), static_cast<GLsizei>(Binary.size()));
+
+    // the driver may still reject it (ex. after an update that kept the version string)
+    GLint bLinked = GL_FALSE;
+    glGetProgramiv(Program, GL_LINK_STATUS, &bLinked);
+    return bLinked == GL_TRUE;
+}
+
+void Save(const uint64_t Key, const GLuint Program)
+{
+    if (!bEnabled)
+        return;
+    GLint Length = 0;
+    glGetProgramiv(Program, GL_PROGRAM_BINARY_LENGTH, &Length);
+    if (Length <= 0)
+        return;
+    std::vector<char> Binary(Length);
+    GLenum Format = 0;
+    glGetProgramBinary(Program, Length, nullptr, &Format, Binary.data());
+
+    // write then rename so a concurrent reader never sees a partial entry. The temporary is per process & thread,
+    // the precompile worker and the render thread (or another instance) may save the same entry at once
+    const std::filesystem::path Path = EntryPath(Key);
+    std::stringstream Suffix;
+    Suffix << "." << getpid() << "." << std::this_thread::get_id() << ".tmp";
+    std::filesystem::path Tmp = Path;
+    Tmp += Suffix.str();
+    std::error_code Err;
+    {
+        std::ofstream Out(Tmp, std::ios::binary);
+        Out.write(reinterpret_cast<const char *>(&Format), sizeof(Format));
+        Out.write(Binary.data(), Binary.size());
+        if (!Out.good())
+        {
+            Out.close();
+            std::filesystem::remove(Tmp, Err);
+            return;
+        }
+    }
+    std::filesystem::rename(Tmp, Path, Err);
+}
+
+} // namespace BinaryCache
+
+bool Precompiler::HasParallelCompile()
+{
+    return glfwExtensionSupported("GL_KHR_parallel_shader_compile") ||
+           glfwExtensionSupported("GL_ARB_parallel_shader_compile");
+}
+
+bool Precompiler::Init(GLFWwindow *Context)
+{
+    if (HasParallelCompile())
+    {
+        // let the driver pick how many of its compiler threads to use
+        typedef void (*MaxThreadsFn)(GLuint);
+        auto MaxThreads = reinterpret_cast<MaxThreadsFn>(glfwGetProcAddress("glMaxShaderCompilerThreadsKHR"));
+        if (MaxThreads == nullptr)
+            MaxThreads = reinterpret_cast<MaxThreadsFn>(glfwGetProcAddress("glMaxShaderCompilerThreadsARB"));
+        if (MaxThreads != nullptr)
+            MaxThreads(0xFFFFFFFF);
+        M = Mode::Parallel;
+        std::cout << "Precompiling shaders with parallel shader compile" << std::endl;
+    }
+    else if (Context != nullptr)
+    {
+        WorkerContext = Context;
+        bStop = false;
+        Worker = std::thread(&Precompiler::WorkerLoop, this);
+        M = Mode::Worker;
+        std::cout << "Precompiling shaders on a worker thread" << std::endl;
+    }
+    else
+    {
+        M = Mode::Sync;
+        std::cout << "No parallel shader compile or worker context, compiling shaders on demand" << std::endl;
+    }
+    return M != Mode::Sync;
+}
+
+void Precompiler::Destroy()
+{
+    if (Worker.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> L(Lock);
+            bStop = true;
+        }
+        QueueChanged.notify_all();
+        Worker.join();
+    }
+    Discard();
+    M = Mode::Sync;
+}
+
+void Precompiler::Start(Job &J)
+{
+    // only hands the job to the driver's compiler threads in parallel mode
+    const Timeline::Span Span("compile", J.Shaders.empty() ? "" : J.Shaders.back().file_path);
+    J.bStarted = true;
+    for (Shader &S : J.Shaders)
+    {
+        if (S.source.empty() && !ReadSource(S, S.source))
+        {
+            J.bDone = true; // failed, Take() gets 0 and the caller keeps its program
+            return;
+        }
+    }
+    J.Key = BinaryCache::Key(J.Shaders);
+    J.Program = glCreateProgram();
+    if (BinaryCache::Load(J.Key, J.Program))
+    {
+        J.bDone = J.bLinked = true;
+        return;
+    }
+
+    // none of these wait for the compiler when the driver compiles in parallel
+    for (Shader &S : J.Shaders)
+    {
+        const char *Source = S.source.c_str();
+        S.ShaderID = glCreateShader(S.type);
+        glShaderSource(S.ShaderID, 1, &Source, NULL);
+        glCompileShader(S.ShaderID);
+        glAttachShader(J.Program, S.ShaderID);
+    }
+    glProgramParameteri(J.Program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(J.Program);
+}
+
+void Precompiler::Finish(Job &J)
+{
+    if (J.bDone)
+        return;
+    const Timeline::Span Span("link", J.Shaders.empty() ? "" : J.Shaders.back().file_path);
+    char ErrorMessage[1024] = {};
+    int bSuccess = {};
+    for (Shader &S : J.Shaders)
+    {
+        glGetShaderiv(S.ShaderID, GL_COMPILE_STATUS, &bSuccess);
+        if (!bSuccess)
+        {
+            glGetShaderInfoLog(S.ShaderID, 1024, NULL, ErrorMessage);
+            std::cerr << "Shader compilation error (" << S.file_path << "): " << ErrorMessage << std::endl;
+        }
+    }
+    glGetProgramiv(J.Program, GL_LINK_STATUS, &bSuccess);
+    J.bLinked = bSuccess;
+    if (J.bLinked)
+        BinaryCache::Save(J.Key, J.Program);
+    else
+    {
+        glGetProgramInfoLog(J.Program, 1024, NULL, ErrorMessage);
+        std::cerr << "Shader linking error: " << ErrorMessage << std::endl;
+        glDeleteProgram(J.Program);
+        J.Program = 0;
+    }
+    for (Shader &S : J.Shaders)
+        glDeleteShader(S.ShaderID);
+    J.bDone = true;
+}
+
+bool Precompiler::IsAsync() const
+{
+    return M != Mode::Sync;
+}
+
+void Precompiler::Submit(const std::string &Name, const std::vector<Shader> &Shaders)
+{
+    if (M == Mode::Sync)
+        return;
+    std::unique_lock<std::mutex> L(Lock);
+    if (Jobs.count(Name) > 0)
+        return;
+    Job &J = Jobs[Name];
+    J.Shaders = Shaders;
+    if (M == Mode::Parallel)
+        Start(J);
+    else
+    {
+        Queue.push_back(Name);
+        L.unlock();
+        QueueChanged.notify_one();
+    }
+}
+
+void Precompiler::Poll()
+{
+    if (M != Mode::Parallel)
+        return; // the worker finishes its own jobs
+    const Timeline::Span Span("Precompiler::Poll");
+    for (auto &It : Jobs)
+    {
+        Job &J = It.second;
+        GLint bComplete = GL_FALSE;
+        if (!J.bDone)
+            glGetProgramiv(J.Program, GL_COMPLETION_STATUS_KHR, &bComplete);
+        if (bComplete)
+            Finish(J);
+    }
+}
+
+bool Precompiler::IsDone(const std::string &Name)
+{
+    std::lock_guard<std::mutex> L(Lock);
+    auto It = Jobs.find(Name);
+    if (It == Jobs.end())
+        return true; // Take() won't wait either
+    Job &J = It->second;
+    if (M == Mode::Parallel && !J.bDone)
+    {
+        GLint bComplete = GL_FALSE;
+        glGetProgramiv(J.Program, GL_COMPLETION_STATUS_KHR, &bComplete);
+        if (bComplete)
+            Finish(J);
+    }
+    return J.bDone;
+}
+
+GLuint Precompiler::Take(const std::string &Name)
+{
+    std::unique_lock<std::mutex> L(Lock);
+    auto It = Jobs.find(Name);
+    if (It == Jobs.end())
+        return 0;
+
+    Job J = It->second;
+    if (M == Mode::Worker)
+    {
+        if (!J.bStarted)
+        {
+            // the worker hasn't picked it up yet, building it right here is quicker than queueing behind others
+            Queue.erase(std::find(Queue.begin(), Queue.end(), Name));
+            Jobs.erase(It);
+            L.unlock();
+            Start(J);
+            Finish(J);
+            return J.Program;
+        }
+        JobDone.wait(L, [&]() { return Jobs.at(Name).bDone; });
+        J = Jobs.at(Name);
+    }
+    else
+        Finish(J); // blocks until the driver is done
+
+    Jobs.erase(Name);
+    return J.Program;
+}
+
+void Precompiler::Discard()
+{
+    std::unique_lock<std::mutex> L(Lock);
+    JobDone.wait(L, [&]() { return Running.empty(); });
+    Queue.clear();
+    for (auto &It : Jobs)
+    {
+        Job &J = It.second;
+        if (J.bStarted && !J.bDone)
+        {
+            for (Shader &S : J.Shaders)
+                glDeleteShader(S.ShaderID);
+        }
+        glDeleteProgram(J.Program);
+    }
+    Jobs.clear();
+}
+
+void Precompiler::WorkerLoop()
+{
+    Timeline::NameThread("shader compiles");
+    glfwMakeContextCurrent(WorkerContext);
+    std::unique_lock<std::mutex> L(Lock);
+    while (true)
+    {
+        QueueChanged.wait(L, [&]() { return bStop || !Queue.empty(); });
+        if (bStop)
+            break;
+        Running = Queue.front();
+        Queue.pop_front();
+        Jobs.at(Running).bStarted = true;
+        Job J = Jobs.at(Running);
+
+        L.unlock();
+        Start(J);
+        Finish(J);
+        glFinish(); // the render context may only use the program once it is complete
+        L.lock();
+
+        Jobs.at(Running) = J;
+        Running.clear();
+        JobDone.notify_all();
+    }
+    glfwMakeContextCurrent(nullptr);
+}
+
+} // namespace ShaderUtils
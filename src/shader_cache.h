@@ -0,0 +1,84 @@
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+#include "gl_headers.h"
+#include "shader_utils.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ShaderUtils
+{
+
+// On-disk cache of linked program binaries. Entries are keyed by a hash of every shader source plus the
+// GL renderer & version strings, so an edited shader or an updated driver simply misses the cache.
+namespace BinaryCache
+{
+bool Init(const std::string &Dir);                // needs a current context, an empty Dir disables the cache
+uint64_t Key(const std::vector<Shader> &Shaders); // expects the sources to be read already
+bool Load(uint64_t Key, GLuint Program);          // true if Program got linked from the cached binary
+void Save(uint64_t Key, GLuint Program);          // Program must have been linked as retrievable
+} // namespace BinaryCache
+
+// Compiles & links programs off the critical path: with GL_KHR_parallel_shader_compile the driver does
+// it on its own threads (the GL calls return immediately and are polled), otherwise a worker thread
+// does it in its own context that shares objects with the render context. With neither, Take() simply
+// compiles on the spot.
+class Precompiler
+{
+  public:
+    static bool HasParallelCompile(); // needs a current context
+
+    bool Init(GLFWwindow *WorkerContext = nullptr); // only used without parallel compile, may be null
+    void Destroy();
+
+    bool IsAsync() const; // false if Submit() is ignored (nothing to compile in the background with)
+    void Submit(const std::string &Name, const std::vector<Shader> &Shaders); // ignored if already queued
+    void Poll();                                                              // never blocks
+    bool IsDone(const std::string &Name);                                     // never blocks
+    GLuint Take(const std::string &Name); // waits for Name, 0 if unknown or it failed. Caller owns the program
+    void Discard();                       // drops every queued/finished program
+
+  private:
+    enum class Mode
+    {
+        Sync,     // compile in Take()
+        Parallel, // GL_KHR_parallel_shader_compile
+        Worker,   // shared context on a worker thread
+    };
+
+    struct Job
+    {
+        std::vector<Shader> Shaders;
+        uint64_t Key = 0; // binary cache key
+        GLuint Program = 0;
+        bool bStarted = false;
+        bool bDone = false;
+        bool bLinked = false;
+    };
+
+    static void Start(Job &J);  // reads, compiles & links (only blocking without parallel compile)
+    static void Finish(Job &J); // checks the results, saves the binary and cleans up the shaders
+    void WorkerLoop();
+
+    Mode M = Mode::Sync;
+    std::map<std::string, Job> Jobs;
+
+    // worker mode only
+    GLFWwindow *WorkerContext = nullptr;
+    std::thread Worker;
+    std::mutex Lock; // guards Jobs, Queue & bStop while the worker runs
+    std::condition_variable QueueChanged, JobDone;
+    std::deque<std::string> Queue;
+    std::string Running; // job the worker is building right now (empty if idle)
+    bool bStop = false;
+};
+
+} // namespace ShaderUtils
+
+#endif
@@ -1,19 +1,88 @@
 /// NOTE: this code was modified from https://github.com/k0pernicus/opengl-explorer
 
-#ifdef __APPLE__
-/* Defined before OpenGL and GLUT includes to avoid deprecation messages */
-#define GL_SILENCE_DEPRECATION
-#include <GLFW/glfw3.h>
-#endif
-
+#include "gl_headers.h"
+#include "pass_graph.h"
+#include "shader_cache.h"
 #include "shader_utils.h"
+#include "timeline.h"
 #include "utils.h"
+#include <algorithm>
 #include <filesystem>
 #include <iostream>
 #include <optional>
+#include <sstream>
 
 namespace ShaderUtils
 {
+const char *const FrameStateBlock = "// a view's gaze & profile, radii are in pixels\n"
+                                    "struct FovView\n"
+                                    "{\n"
+                                    "    vec2 Mouse;     // gaze in the view, y down\n"
+                                    "    float aspect_w; // weight of the horizontal distance (1 / aspect^2)\n"
+                                    "    vec4 radius[2]; // outer radius of level i in radius[i / 4][i % 4], the last "
+                                    "level has none\n"
+                                    "    ivec4 keep[2];  // kept sixteenths of level i in keep[i / 4][i % 4]\n"
+                                    "};\n"
+                                    "// per-frame renderer state shared by every program (ShaderUtils::FrameState)\n"
+                                    "layout(std140) uniform FrameState\n"
+                                    "{\n"
+                                    "    vec2 iResolution; // of a view\n"
+                                    "    ivec2 phase;      // per-frame shift of the drop pattern, in pixels\n"
+                                    "    float iTime;\n"
+                                    "    int iFrame;\n"
+                                    "    int stride;       // width (in pixels) of a block of 4 quads\n"
+                                    "    int levels;       // foveation levels in use (up to 8, the same in every "
+                                    "view)\n"
+                                    "    int views;        // 1, or 2 side by side\n"
+                                    "    FovView view[2];\n"
+                                    "} Frame;\n";
+
+bool ReadSource(const Shader &S, std::string &Source)
+{
+    if (!readFile(S.file_path, Source))
+        return false;
+    if (S.type == GL_COMPUTE_SHADER && Source.compare(0, 17, "#version 330 core") == 0)
+        Source.replace(0, 17, "#version 430 core"); // shared sources (ex. fov_common.glsl) linked into compute
+    // #version has to stay first, #line keeps the line numbers of compile errors pointing into the file
+    size_t Pos = Source.find("#version");
+    std::string Preamble = S.defines + FrameStateBlock;
+    if (Pos != std::string::npos)
+    {
+        Pos = Source.find('\n', Pos);
+        if (Pos == std::string::npos)
+        {
+            Pos = Source.size();
+            Preamble = "\n" + Preamble;
+        }
+        else
+            Pos++;
+    }
+    else
+        Pos = 0;
+    const int NextLine = static_cast<int>(std::count(Source.begin(), Source.begin() + Pos, '\n')) + 1;
+    Source.insert(Pos, Preamble + "#line " + std::to_string(NextLine) + "\n");
+    return true;
+}
+
+std::string FoveationDefines(const FRShaderParams &P, const FRShaderParams *Right)
+{
+    const auto Sparse = [](const FRShaderParams &V) { return !V.keep.empty() && KeepSixteenths(V.keep.back()) < 4; };
+    std::stringstream ss;
+    // power of two strides (every one the keys pick) turn the block & quad math into shifts & masks
+    if (P.stride >= 2 && (P.stride & (P.stride - 1)) == 0)
+    {
+        int Shift = 0;
+        while ((1 << Shift) < P.stride)
+            Shift++;
+        ss << "#define FOV_STRIDE_SHIFT " << Shift << "\n";
+    }
+    ss << "#define FOV_LEVELS " << P.keep.size() << "\n";
+    ss << "#define FOV_SPARSE " << (Sparse(P) || (Right != nullptr && Sparse(*Right))) << "\n";
+    ss << "#define FOV_TEMPORAL " << (P.Reconstruction == ReconstructionMode::Temporal) << "\n";
+    ss << "#define FOV_VIEWS " << (Right != nullptr ? 2 : 1) << "\n";
+    return ss.str();
+}
+
 Program::Program()
 {
 }
@@ -21,42 +90,173 @@ Program::Program()
 Program::~Program()
 {
     glDeleteProgram(program);
+    for (const auto &It : Variants)
+        glDeleteProgram(It.second);
 }
 
 bool Program::Reload()
 {
-    // delete the current program
-    glDeleteProgram(GetProgram());
-
-    // load Shaders new
+    if (!PendingReload.empty())
+    {
+        // superseded by this rebuild
+        glDeleteProgram(Background->Take(PendingReload));
+        PendingReload.clear();
+        bReloadAgain = false;
+    }
+    // load Shaders new (the current program stays if that fails), the other variants are rebuilt on demand
+    DropVariants();
     return loadShaders(Shaders);
 }
 
+std::string Program::VariantJob(const std::string &D) const
+{
+    return "variant:" + std::to_string(reinterpret_cast<uintptr_t>(this)) + ":" + std::to_string(Generation) + ":" + D;
+}
+
+void Program::DropVariants()
+{
+    for (const auto &It : Variants)
+        glDeleteProgram(It.second);
+    Variants.clear();
+    Generation++;
+}
+
+bool Program::SetDefines(const std::string &D)
+{
+    if (D == Defines || Shaders.empty())
+        return true;
+    std::vector<Shader> Sources = Shaders;
+    for (Shader &S : Sources)
+    {
+        S.defines = D;
+        S.source.clear();
+        S.ShaderID = -1;
+    }
+
+    GLuint Ready = 0;
+    const auto It = Variants.find(D);
+    if (It != Variants.end())
+    {
+        Ready = It->second;
+        Variants.erase(It);
+    }
+    else if (Background != nullptr)
+        Ready = Background->Take(VariantJob(D)); // 0 unless it was prebuilt
+    if (Ready == 0)
+    {
+        // compile right here, the current program stays if that fails
+        const int Current = program;
+        const std::vector<Shader> CurrentShaders = Shaders;
+        program = 0;
+        if (!loadShaders(Sources))
+        {
+            Shaders = CurrentShaders;
+            program = Current;
+            return false;
+        }
+        Ready = program;
+        program = Current;
+    }
+    Variants[Defines] = program;
+    Shaders = Sources;
+    Defines = D;
+    program = Ready;
+    CacheUniforms();
+    return true;
+}
+
+void Program::Prebuild(const std::string &D)
+{
+    if (D == Defines || Variants.count(D) > 0 || Shaders.empty() || Background == nullptr || !Background->IsAsync())
+        return;
+    std::vector<Shader> Sources = Shaders;
+    for (Shader &S : Sources)
+    {
+        S.defines = D;
+        S.source.clear();
+        S.ShaderID = -1;
+    }
+    Background->Submit(VariantJob(D), Sources);
+}
+
+bool Program::IsBuilt(const std::string &D)
+{
+    // without background compiles nothing ever gets built ahead
+    if (D == Defines || Variants.count(D) > 0 || Shaders.empty() || Background == nullptr || !Background->IsAsync())
+        return true;
+    return Background->IsDone(VariantJob(D));
+}
+
 bool Program::loadShaders(const std::vector<Shader> &ShaderStructList)
 {
     std::cout << std::endl;
-    Shaders = ShaderStructList;
+    std::vector<Shader> Sources = ShaderStructList;
+    for (auto &ShaderStruct : Sources)
+    {
+        if (!ReadSource(ShaderStruct, ShaderStruct.source))
+            return false; // a failed build, the current program stays
+    }
+    Shaders = Sources;
+
+    // build into a new program, the current one is only replaced once this one linked
+    const int LastProgram = program;
+    program = glCreateProgram();
+
+    // skip compiling altogether if this exact program was linked before
+    const uint64_t Key = BinaryCache::Key(Shaders);
+    if (BinaryCache::Load(Key, program))
+    {
+        glDeleteProgram(LastProgram);
+        CacheUniforms();
+        return true;
+    }
+
     for (auto &ShaderStruct : Shaders)
     {
         if (!registerShader(ShaderStruct))
         {
             std::cerr << "failed to register the " << ShaderStruct.title << " shader..." << std::endl;
+            DeleteShaders();
+            glDeleteProgram(program);
+            program = LastProgram;
             return false;
         }
     }
     if (!registerProgram())
     {
         std::cerr << "failed to register the program..." << std::endl;
+        DeleteShaders();
+        glDeleteProgram(program);
+        program = LastProgram;
         return false;
     }
+    glDeleteProgram(LastProgram);
+    BinaryCache::Save(Key, program);
+    return true;
+}
+
+bool Program::LoadPrecompiled(const std::vector<Shader> &ShaderStructList, const std::string &Job)
+{
+    const GLuint Ready = (Background != nullptr) ? Background->Take(Job) : 0;
+    if (Ready == 0 && !loadShaders(ShaderStructList))
+        return false;
+    if (Ready != 0)
+    {
+        glDeleteProgram(program);
+        Shaders = ShaderStructList;
+        program = Ready;
+        CacheUniforms();
+    }
+    // SetDefines with the same defines is a no-op then
+    Defines = ShaderStructList.empty() ? "" : ShaderStructList.front().defines;
     return true;
 }
 
 bool Program::registerShader(Shader &S)
 {
-    // first read the file
-    const std::string shader_src_str = readFile(S.file_path);
-    const char *shader_source = shader_src_str.c_str();
+    const Timeline::Span Span("compile", S.file_path);
+    // source was read by loadShaders
+    const char *shader_source = S.source.c_str();
 
     // then create the shader and compile
     int success = {};
@@ -71,6 +271,7 @@ bool Program::registerShader(Shader &S)
     {
         glGetShaderInfoLog(shader, 1024, NULL, errorMessage);
         std::cerr << "Shader compilation error : " << errorMessage << std::endl;
+        glDeleteShader(shader);
         return false;
     }
     S.ShaderID = shader;
@@ -79,15 +280,15 @@ bool Program::registerShader(Shader &S)
 
 bool Program::registerProgram()
 {
+    const Timeline::Span Span("link");
     int success = {};
     char errorMessage[1024] = {};
 
-    program = glCreateProgram();
-
     for (auto &Shader : Shaders)
     {
         glAttachShader(program, Shader.ShaderID);
     }
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE); // for the binary cache
     glLinkProgram(program);
 
     glGetProgramiv(program, GL_LINK_STATUS, &success);
@@ -100,32 +301,197 @@ bool Program::registerProgram()
 
     // We can now delete our other shaders
     DeleteShaders();
+    CacheUniforms();
     return true;
 }
 
+void Program::CacheUniforms()
+{
+    // resolve everything by name once per link, so the render loop never looks up strings
+    const char *UniformNames[NumUniforms] = {"iTime",  "iFrame",     "iResolution",
+                                             "iMouse", "mask_phase", "iChannelResolution"};
+    for (int U = 0; U < NumUniforms; U++)
+        UniformLocs[U] = glGetUniformLocation(program, UniformNames[U]);
+
+    const GLuint BlockIdx = glGetUniformBlockIndex(program, "FrameState");
+    if (BlockIdx != GL_INVALID_INDEX)
+        glUniformBlockBinding(program, BlockIdx, FrameStateBinding);
+
+    // samplers always read from the same texture units, the renderer binds its textures accordingly
+    const struct
+    {
+        const char *Name;
+        int Unit;
+    } Samplers[] = {{"tex", 0},       {"history", 1},   {"level0", 0},    {"level1", 1},   {"level2", 2},
+                    {"iChannel0", 1}, {"iChannel1", 2}, {"iChannel2", 3}, {"iChannel3", 4}}; // multipass
+    glUseProgram(program);
+    for (const auto &Sampler : Samplers)
+    {
+        const GLint Loc = glGetUniformLocation(program, Sampler.Name);
+        if (Loc >= 0)
+            glUniform1i(Loc, Sampler.Unit);
+    }
+    glUseProgram(0);
+}
+
 int Program::GetProgram() const
 {
     return program;
 }
 
+GLint Program::GetUniform(const Uniform U) const
+{
+    return UniformLocs[U];
+}
+
 void Program::DeleteShaders()
 {
     for (auto &Shader : Shaders)
     {
-        glDeleteShader(Shader.ShaderID);
+        if (Shader.ShaderID >= 0)
+            glDeleteShader(Shader.ShaderID);
+        Shader.ShaderID = -1;
+    }
+}
+
+void Program::SetPrecompiler(Precompiler *B)
+{
+    Background = B;
+}
+
+bool Program::DependsOn(const std::string &Path) const
+{
+    return std::any_of(Shaders.begin(), Shaders.end(), [&](const Shader &S) { return sameFile(S.file_path, Path); });
+}
+
+void Program::ReloadAsync()
+{
+    if (Background == nullptr || !Background->IsAsync())
+    {
+        Reload();
+        return;
+    }
+    if (!PendingReload.empty())
+    {
+        // restart once the rebuild in flight is done (it might have read the sources mid-edit)
+        bReloadAgain = true;
+        return;
+    }
+    std::vector<Shader> Sources = Shaders;
+    for (Shader &S : Sources)
+    {
+        S.source.clear(); // re-read from disk
+        S.ShaderID = -1;
+    }
+    PendingReload = "reload:" + std::to_string(reinterpret_cast<uintptr_t>(this));
+    ReloadTarget = program;
+    Background->Submit(PendingReload, Sources);
+}
+
+void Program::ReloadAsync(const std::vector<Shader> &Sources)
+{
+    // every shader of a program is built with the same preamble, the active one's
+    const std::string D = Shaders.empty() ? "" : Shaders.front().defines;
+    Shaders = Sources;
+    for (Shader &S : Shaders)
+        S.defines = D;
+    DropVariants(); // built from the old files
+    ReloadAsync();
+}
+
+GLuint Program::TakeReload()
+{
+    if (PendingReload.empty() || !Background->IsDone(PendingReload))
+        return 0;
+    const GLuint NewProgram = Background->Take(PendingReload);
+    PendingReload.clear();
+    if (NewProgram == 0)
+        std::cerr << "keeping the last working program" << std::endl;
+
+    if (bReloadAgain)
+    {
+        bReloadAgain = false;
+        ReloadAsync();
+    }
+    return NewProgram;
+}
+
+bool Program::PollReload()
+{
+    const int Target = ReloadTarget;
+    const GLuint NewProgram = TakeReload();
+    if (NewProgram == 0)
+        return false;
+    // every variant was built from the old sources
+    DropVariants();
+    if (program != Target)
+    {
+        // switched to another variant while rebuilding, which needs its own rebuild
+        glDeleteProgram(NewProgram);
+        ReloadAsync();
+        return false;
     }
+    glDeleteProgram(program);
+    program = NewProgram;
+    CacheUniforms();
+    return true;
+}
+
+static const std::string &FoveationShaderPath(const ParamsStruct &P)
+{
+    // with a stencil mask the dropped pixels never reach the fragment shader, and multires never drops
+    // pixels at all (lower resolution targets instead), so the pass-through suffices for both
+    const bool bDropInShader =
+        P.bEnableFovRender && P.FRParams.Strategy == FovStrategy::Checkerboard && !P.FRParams.bStencilMask;
+    return bDropInShader ? P.FRParams.drop_shader : P.MainParams.non_fr_fragment_shader_path;
+}
+
+MainProgram::~MainProgram()
+{
+    for (const auto &It : Linked)
+        glDeleteProgram(It.second.Program);
+    program = 0; // owned by Linked
+}
+
+static std::string MainDefines(const ParamsStruct &P, const std::string &D)
+{
+    // only the drop shader is specialized, the pass-through is the same for every profile
+    return (FoveationShaderPath(P) == P.FRParams.drop_shader) ? D : "";
 }
 
-bool MainProgram::loadShaders(const ParamsStruct &P)
+static std::string ViewDefines(const ParamsStruct &P)
 {
-    Shaders.clear();
-    Shaders = {
+    // side by side views, the main shader sees the pixel within its view (iResolution is a view's)
+    return (NumViews(P) > 1) ? "#define gl_FragCoord vec4(mod(gl_FragCoord.x, iResolution.x), gl_FragCoord.yzw)\n" : "";
+}
+
+static std::string MainSource(const std::string &Path)
+{
+    // a multipass shader is a directory, its image pass is the main shader (the buffers are PassGraph's)
+    return PassGraph::IsMultipass(Path) ? (std::filesystem::path(Path) / PassGraph::ImageShader).string() : Path;
+}
+
+std::string MainProgram::VariantName(const ParamsStruct &P, const size_t Idx, const std::string &D) const
+{
+    return OtherShaderPaths[Idx] + "+" + FoveationShaderPath(P) + "+" + MainDefines(P, D) + ViewDefines(P);
+}
+
+std::vector<Shader> MainProgram::VariantShaders(const ParamsStruct &P, const size_t Idx, const std::string &D) const
+{
+    const std::string Defines = MainDefines(P, D);
+    std::vector<Shader> Shaders = {
         ShaderUtils::Shader(P.MainParams.vertex_shader_path, "vertex", GL_VERTEX_SHADER),
-        ShaderUtils::Shader(P.MainParams.fragment_shader_dir + P.MainParams.fragment_shader_name, "main",
-                            GL_FRAGMENT_SHADER),
-        ShaderUtils::Shader(P.bEnableFovRender ? P.FRParams.drop_shader : P.MainParams.non_fr_fragment_shader_path,
-                            "fragment", GL_FRAGMENT_SHADER),
+        ShaderUtils::Shader(MainSource(OtherShaderPaths[Idx]), "main", GL_FRAGMENT_SHADER, Defines + ViewDefines(P)),
+        ShaderUtils::Shader(FoveationShaderPath(P), "fragment", GL_FRAGMENT_SHADER, Defines),
     };
+    if (FoveationShaderPath(P) == P.FRParams.drop_shader)
+        Shaders.push_back(ShaderUtils::Shader(P.FRParams.common_shader, "common", GL_FRAGMENT_SHADER, Defines));
+    return Shaders;
+}
+
+bool MainProgram::loadShaders(const ParamsStruct &P, const std::string &FovDefines)
+{
+    Defines = FovDefines;
     // read all the shaders in the FragmentShaderPath
     for (const auto &file : std::filesystem::directory_iterator(P.MainParams.fragment_shader_dir))
     {
@@ -133,38 +499,253 @@ bool MainProgram::loadShaders(const ParamsStruct &P)
         std::cout << "Found shader: \"" << path << "\"" << std::endl;
         OtherShaderPaths.push_back(path);
     }
+    std::sort(OtherShaderPaths.begin(), OtherShaderPaths.end()); // directory order is unspecified
     std::cout << std::endl;
 
-    // call parent load
-    return Program::loadShaders(Shaders);
+    // start on the requested shader
+    const std::string StartPath = P.MainParams.fragment_shader_dir + P.MainParams.fragment_shader_name;
+    const auto Start = std::find_if(OtherShaderPaths.begin(), OtherShaderPaths.end(), [&](const std::string &Path) {
+        std::error_code Err;
+        return std::filesystem::equivalent(Path, StartPath, Err);
+    });
+    if (Start == OtherShaderPaths.end())
+    {
+        std::cerr << "can't find \"" << StartPath << "\"" << std::endl;
+        return false;
+    }
+    ShaderIdx = Start - OtherShaderPaths.begin();
+    return Select(P);
+}
+
+bool MainProgram::Select(const ParamsStruct &P)
+{
+    // every linked variant is kept around, so switching back & forth is just a swap
+    const std::string Name = VariantName(P, ShaderIdx, Defines);
+    const std::vector<Shader> Sources = VariantShaders(P, ShaderIdx, Defines);
+    auto It = Linked.find(Name);
+    if (It == Linked.end())
+    {
+        GLuint Ready = (Background != nullptr) ? Background->Take(Name) : 0;
+        if (Ready == 0)
+        {
+            // not precompiled (or it failed there), compile right here
+            const int Current = program;
+            const std::vector<Shader> CurrentShaders = Shaders;
+            program = 0; // owned by Linked, mustn't be replaced by loadShaders
+            if (!Program::loadShaders(Sources))
+            {
+                Shaders = CurrentShaders; // stay on whatever was running
+                program = Current;
+                return false;
+            }
+            Ready = program;
+        }
+        Variant V;
+        V.Program = Ready;
+        for (const Shader &S : Sources)
+            V.Paths.push_back(S.file_path);
+        It = Linked.emplace(Name, V).first;
+    }
+    Shaders = Sources;
+    program = It->second.Program;
+    CacheUniforms();
+    return true;
+}
+
+void MainProgram::PrecompileAll(const ParamsStruct &P)
+{
+    if (Background == nullptr || !Background->IsAsync() || !P.MainParams.bPrecompile)
+        return;
+    // next & previous first, those are the likeliest to be picked
+    const size_t N = OtherShaderPaths.size();
+    for (size_t i = 1; i <= N / 2 + 1 && i < N; i++)
+    {
+        for (const size_t Idx : {(ShaderIdx + i) % N, (ShaderIdx + N - i) % N})
+        {
+            if (Linked.count(VariantName(P, Idx, Defines)) == 0)
+                Background->Submit(VariantName(P, Idx, Defines), VariantShaders(P, Idx, Defines));
+            PassGraph::Precompile(OtherShaderPaths[Idx], P, Defines, Background); // the buffers of multipass ones
+        }
+    }
 }
 
 bool MainProgram::Reload(const ParamsStruct &P)
 {
-    // expects an up-to-date ParamsStruct instance
-    if (OtherShaderPaths.size() > 0)
+    // expects an up-to-date ParamsStruct instance, sources might have changed so nothing linked is reused
+    // (the binary cache still skips compiling every unchanged shader). The running program is only
+    // replaced if the new one links
+    if (Background != nullptr)
+        Background->Discard();
+    PendingReload.clear();
+    bReloadAgain = false;
+    const int Current = program;
+    std::map<std::string, Variant> Last; // the running variant, restored if the rebuild fails
+    for (const auto &It : Linked)
+    {
+        if (static_cast<int>(It.second.Program) == Current)
+            Last.insert(It);
+        else
+            glDeleteProgram(It.second.Program);
+    }
+    Linked.clear();
+
+    program = 0;
+    const bool bSuccess = Select(P);
+    if (bSuccess)
+        glDeleteProgram(Current);
+    else
+    {
+        std::cerr << "keeping the last working program" << std::endl;
+        Linked = Last;
+        program = Current;
+    }
+    PrecompileAll(P);
+    return bSuccess;
+}
+
+void MainProgram::ReloadAsync(const ParamsStruct &P)
+{
+    if (Background == nullptr || !Background->IsAsync())
+    {
+        Reload(P);
+        return;
+    }
+    // any source may have changed: the inactive variants are dropped (and precompiled again), the active one
+    // is swapped for its rebuild once that links
+    for (auto It = Linked.begin(); It != Linked.end();)
+    {
+        if (static_cast<int>(It->second.Program) != program)
+        {
+            glDeleteProgram(It->second.Program);
+            It = Linked.erase(It);
+        }
+        else
+            ++It;
+    }
+    Program::ReloadAsync();
+    PrecompileAll(P);
+}
+
+bool MainProgram::SetDefines(const ParamsStruct &P, const std::string &D)
+{
+    if (D == Defines)
+        return true;
+    const std::string Current = Defines;
+    Defines = D;
+    if (Select(P))
+        return true;
+    Defines = Current;
+    return false;
+}
+
+void MainProgram::Prebuild(const ParamsStruct &P, const std::string &D)
+{
+    const std::string Name = VariantName(P, ShaderIdx, D);
+    if (Background != nullptr && Background->IsAsync() && Linked.count(Name) == 0)
+        Background->Submit(Name, VariantShaders(P, ShaderIdx, D));
+}
+
+bool MainProgram::IsBuilt(const ParamsStruct &P, const std::string &D)
+{
+    // without background compiles nothing ever gets built ahead
+    const std::string Name = VariantName(P, ShaderIdx, D);
+    return Linked.count(Name) > 0 || Background == nullptr || !Background->IsAsync() || Background->IsDone(Name);
+}
+
+bool MainProgram::Refresh(const ParamsStruct &P)
+{
+    const bool bSuccess = Select(P);
+    PrecompileAll(P);
+    return bSuccess;
+}
+
+void MainProgram::HotReload(const ParamsStruct &P, const std::string &Path)
+{
+    // inactive variants built from Path are dropped (and recompiled in the background), the active one is
+    // rebuilt in the background and swapped in once it links
+    bool bActive = false;
+    for (auto It = Linked.begin(); It != Linked.end();)
     {
-        Shaders.clear();
-        Shaders = {
-            ShaderUtils::Shader(P.MainParams.vertex_shader_path, "vertex", GL_VERTEX_SHADER),
-            ShaderUtils::Shader(OtherShaderPaths[ShaderIdx], "main", GL_FRAGMENT_SHADER),
-            ShaderUtils::Shader(P.bEnableFovRender ? P.FRParams.drop_shader : P.MainParams.non_fr_fragment_shader_path,
-                                "fragment", GL_FRAGMENT_SHADER),
-        };
+        const bool bUses = std::any_of(It->second.Paths.begin(), It->second.Paths.end(),
+                                       [&](const std::string &Source) { return sameFile(Source, Path); });
+        if (bUses && static_cast<int>(It->second.Program) == program)
+            bActive = true;
+        if (bUses && static_cast<int>(It->second.Program) != program)
+        {
+            glDeleteProgram(It->second.Program);
+            It = Linked.erase(It);
+        }
+        else
+            ++It;
     }
-    // call parent reload
-    return Program::Reload();
+    if (bActive && Background != nullptr && Background->IsAsync())
+        Program::ReloadAsync();
+    else if (bActive)
+        Reload(P); // no background compiles, rebuild right away (still keeps the running one on failure)
+    PrecompileAll(P);
+}
+
+bool MainProgram::PollReload()
+{
+    // the rebuilt program replaces the variant it was started from, which might not be the active one anymore
+    const int Target = ReloadTarget;
+    const GLuint NewProgram = TakeReload();
+    if (NewProgram == 0)
+        return false;
+    bool bAdopted = false;
+    for (auto &It : Linked)
+    {
+        if (static_cast<int>(It.second.Program) == Target)
+        {
+            glDeleteProgram(Target);
+            It.second.Program = NewProgram;
+            bAdopted = true;
+        }
+    }
+    if (!bAdopted)
+    {
+        glDeleteProgram(NewProgram); // its variant was dropped in the meantime
+        return false;
+    }
+    if (program == Target)
+    {
+        program = NewProgram;
+        CacheUniforms();
+    }
+    return true;
 }
 
 bool MainProgram::NextShader(const ParamsStruct &P)
 {
     ShaderIdx = (ShaderIdx + 1) % OtherShaderPaths.size();
-    return Reload(P);
+    return Select(P);
 }
 
 bool MainProgram::PrevShader(const ParamsStruct &P)
 {
-    ShaderIdx = (ShaderIdx - 1) % OtherShaderPaths.size();
-    return Reload(P);
+    ShaderIdx = (ShaderIdx + OtherShaderPaths.size() - 1) % OtherShaderPaths.size();
+    return Select(P);
+}
+
+bool MainProgram::SetShader(const ParamsStruct &P, const size_t Idx)
+{
+    assert(Idx < OtherShaderPaths.size());
+    ShaderIdx = Idx;
+    return Select(P);
+}
+
+size_t MainProgram::NumShaders() const
+{
+    return OtherShaderPaths.size();
+}
+
+size_t MainProgram::CurrentShader() const
+{
+    return ShaderIdx;
+}
+
+const std::string &MainProgram::GetShaderPath(const size_t Idx) const
+{
+    return OtherShaderPaths.at(Idx);
 }
 }; // namespace ShaderUtils
\ No newline at end of file
@@ -3,24 +3,80 @@
 #ifndef _SHADER_UTILS_H
 #define _SHADER_UTILS_H
 
+#include "gl_headers.h"
 #include "utils.h"
+#include <map>
 #include <string>
 #include <vector>
 
 namespace ShaderUtils
 {
 
+class Precompiler;
+
+// gaze & profile of a view, mirrors the std140 "FovView" struct of the FrameState block
+struct FovView
+{
+    float Mouse[2];                 // gaze (view pixels, y down)
+    float aspect_w;                 // weight of the horizontal distance (1 / aspect^2)
+    float pad;
+    float radius[MaxFovLevels];     // outer radius of each level, already scaled to pixels (vec4[2])
+    int keep[MaxFovLevels];         // kept sixteenths of each level (ivec4[2])
+};
+
+// per-frame renderer state, mirrors the std140 "FrameState" uniform block (FrameStateBlock)
+struct FrameState
+{
+    float iResolution[2];           // of a view
+    int phase[2];
+    float iTime;
+    int iFrame;
+    int stride;
+    int levels;                     // foveation levels in use
+    int views;                      // side by side in the framebuffer
+    float pad[3];
+    FovView view[MaxViews];
+};
+static_assert(sizeof(FovView) == 80 && sizeof(FrameState) == 208,
+              "FrameState must match the std140 layout of the uniform block");
+constexpr GLuint FrameStateBinding = 0; // uniform buffer binding point of the FrameState block
+// GLSL declaration of the FovView struct & the FrameState block (instance "Frame") matching the structs above,
+// ReadSource puts it in every shader
+extern const char *const FrameStateBlock;
+
+// plain (non-block) uniforms whose locations are cached per link, mainly the ShaderToy inputs of the main shaders
+enum Uniform
+{
+    UniformTime = 0,          // iTime
+    UniformFrame,             // iFrame
+    UniformResolution,        // iResolution
+    UniformMouse,             // iMouse
+    UniformMaskPhase,         // mask_phase
+    UniformChannelResolution, // iChannelResolution[4] (multipass shaders)
+    NumUniforms
+};
+
 struct Shader
 {
-    Shader(const std::string &f, const std::string &t, const int ty) : file_path(f), title(t), type(ty), ShaderID(-1)
+    Shader(const std::string &f, const std::string &t, const int ty, const std::string &d = "")
+        : file_path(f), title(t), type(ty), ShaderID(-1), defines(d)
     {
     }
     std::string file_path = "";
     std::string title = "shader";
     int type;
-    int ShaderID = -1; // -1 for unregistered
+    int ShaderID = -1;        // -1 for unregistered
+    std::string defines = ""; // preamble of #define lines, inserted after the #version line
+    std::string source = "";  // read from file_path (with the defines) when (first) compiled
 };
 
+// file_path with the defines injected (compute shaders at 4.30), false if it can't be read
+bool ReadSource(const Shader &S, std::string &Source);
+
+// specializes the foveation shaders for a profile (see fov_common.glsl), programs are built once per distinct one.
+// Right is the second view's profile when rendering two
+std::string FoveationDefines(const FRShaderParams &P, const FRShaderParams *Right = nullptr);
+
 struct Program
 {
 
@@ -30,16 +86,45 @@ struct Program
     bool registerShader(Shader &S);
     bool registerProgram();
     void DeleteShaders();
+    void CacheUniforms();
 
     std::vector<Shader> Shaders;
+    GLint UniformLocs[NumUniforms] = {}; // -1 if the program doesn't use it
+
+    // specialized variants (SetDefines), the inactive ones are kept so switching back is just a swap
+    std::string Defines = "";               // preamble of every shader of the active program
+    std::map<std::string, GLuint> Variants; // inactive variants by their preamble
+    int Generation = 0;                     // bumped by reloads, so stale background builds are never picked up
+    std::string VariantJob(const std::string &D) const;
+    void DropVariants(); // the sources changed
+
+    // background reloads
+    Precompiler *Background = nullptr; // not owned, may be null
+    std::string PendingReload = "";     // name of the rebuild in flight (empty if none)
+    int ReloadTarget = 0;               // program the rebuild replaces
+    bool bReloadAgain = false;          // sources changed again while rebuilding
+    GLuint TakeReload();                // the finished rebuild (0 if still running or it failed)
 
   public:
     Program();
     ~Program();
 
-    bool loadShaders(const std::vector<Shader> &shaders);
+    bool loadShaders(const std::vector<Shader> &shaders); // keeps the current program if this fails
+    // the same, taking the program Job built in the background (compiling here if it isn't there). The shaders
+    // share their defines
+    bool LoadPrecompiled(const std::vector<Shader> &shaders, const std::string &Job);
     bool Reload();
+    bool SetDefines(const std::string &D); // activates the variant for D, compiling it unless it was prebuilt
+    void Prebuild(const std::string &D);   // compiles the variant for D in the background (ex. the next stride)
+    bool IsBuilt(const std::string &D);    // whether SetDefines(D) won't have to compile
     int GetProgram() const;
+    GLint GetUniform(Uniform U) const;
+
+    void SetPrecompiler(Precompiler *B);
+    bool DependsOn(const std::string &Path) const;
+    void ReloadAsync(); // rebuilds from the (re-read) sources in the background, blocking without a precompiler
+    void ReloadAsync(const std::vector<Shader> &Sources); // the same from other files (keeping the defines)
+    bool PollReload();  // swaps in the rebuilt program once it linked (true if swapped), keeps the current otherwise
 };
 
 struct MainProgram : Program
@@ -47,12 +132,36 @@ struct MainProgram : Program
   private:
     std::vector<std::string> OtherShaderPaths;
     size_t ShaderIdx = 0;
+    struct Variant
+    {
+        GLuint Program = 0;
+        std::vector<std::string> Paths; // every source it was built from
+    };
+    std::map<std::string, Variant> Linked; // every program linked so far, by VariantName
+
+    std::string VariantName(const ParamsStruct &P, size_t Idx, const std::string &D) const;
+    std::vector<Shader> VariantShaders(const ParamsStruct &P, size_t Idx, const std::string &D) const;
+    bool Select(const ParamsStruct &P); // makes the current variant active, compiling it if needed
 
   public:
-    bool loadShaders(const ParamsStruct &P);
+    ~MainProgram();
+
+    void PrecompileAll(const ParamsStruct &P); // queues every main shader (with the current foveation shader)
+    bool loadShaders(const ParamsStruct &P, const std::string &FovDefines = "");
     bool Reload(const ParamsStruct &P);
+    void ReloadAsync(const ParamsStruct &P); // Reload in the background, the running program stays until then
+    bool SetDefines(const ParamsStruct &P, const std::string &D); // the foveation shader's variant
+    void Prebuild(const ParamsStruct &P, const std::string &D);
+    bool IsBuilt(const ParamsStruct &P, const std::string &D); // whether selecting it won't have to compile
+    bool Refresh(const ParamsStruct &P);                          // picks up changed params (ex. foveation shader)
+    void HotReload(const ParamsStruct &P, const std::string &Path); // Path changed on disk
+    bool PollReload();
     bool NextShader(const ParamsStruct &P);
     bool PrevShader(const ParamsStruct &P);
+    bool SetShader(const ParamsStruct &P, size_t Idx);
+    size_t NumShaders() const;
+    size_t CurrentShader() const;
+    const std::string &GetShaderPath(size_t Idx) const;
 };
 
 } // namespace ShaderUtils
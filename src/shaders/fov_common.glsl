@@ -0,0 +1,110 @@
+#version 330 core
+
+// Foveation profile shared by the drop, mask & reconstruction shaders (linked into each of their programs).
+// The distance of a block to the gaze block picks one of Frame.levels levels, and each level keeps a fixed
+// share of its pixels (in sixteenths):
+//  - 16: every quad           - 12: all but the top right     - 8: top left & bottom right
+//  - 4: only the top left     - 2: top left of every block of the even block rows
+//  - 1: top left of every other block of the even block rows
+// With 2 views (stereo) the framebuffer holds them side by side, each with its own gaze & profile. The pattern
+// of a view is the one of a single view of its size, everything below works in view pixels.
+
+// the FovView struct & the FrameState block (Frame) are put in by the renderer, see ShaderUtils::FrameStateBlock
+
+// The renderer specializes every program for the current profile (ShaderUtils::FoveationDefines):
+//  - FOV_STRIDE_SHIFT: log2 of the stride, when it's a power of two (blocks & quads become shifts & masks)
+//  - FOV_LEVELS: the number of levels (unrolls the level search)
+//  - FOV_SPARSE: 1 if a level of any view keeps less than 1/4 (0 compiles the lattice infill out)
+//  - FOV_VIEWS: the number of views (1 compiles the view lookups out)
+// Without them everything is read from the FrameState block.
+#ifndef FOV_VIEWS
+#define FOV_VIEWS 2
+#endif
+
+// view of a framebuffer pixel
+int fov_view(const ivec2 frag)
+{
+#if FOV_VIEWS > 1
+    return min(frag.x / int(Frame.iResolution.x), Frame.views - 1);
+#else
+    return 0;
+#endif
+}
+
+// bottom left framebuffer pixel of a view
+ivec2 fov_origin(const int view)
+{
+    return ivec2(view * int(Frame.iResolution.x), 0);
+}
+
+// block of a pixel (in the shifted pattern)
+ivec2 fov_block(const ivec2 pixel)
+{
+#ifdef FOV_STRIDE_SHIFT
+    return pixel >> FOV_STRIDE_SHIFT; // arithmetic shift, so also floors the pixels left of/below the window
+#else
+    return ivec2(floor(vec2(pixel) / Frame.stride));
+#endif
+}
+
+// quad of a pixel within its block, 0 or 1 in x & y ((0, 0) is the top left)
+ivec2 fov_quad(const ivec2 pixel)
+{
+#ifdef FOV_STRIDE_SHIFT
+    return (pixel >> (FOV_STRIDE_SHIFT - 1)) & 1;
+#else
+    return ivec2(greaterThanEqual(mod(vec2(pixel), Frame.stride), vec2(Frame.stride / 2)));
+#endif
+}
+
+// gaze block of a view, in the pattern shifted by phase
+ivec2 fov_center(const int view, const ivec2 phase)
+{
+    vec2 gaze = vec2(Frame.view[view].Mouse.x, -Frame.view[view].Mouse.y + Frame.iResolution.y);
+    return fov_block(ivec2(floor(gaze)) + phase);
+}
+
+// kept sixteenths of a block, both blocks given as their index in the (shifted) block grid
+int fov_keep(const int view, const ivec2 block, const ivec2 center)
+{
+#ifdef FOV_LEVELS
+    const int levels = FOV_LEVELS;
+#else
+    int levels = Frame.levels;
+#endif
+    vec2 d = vec2(block - center) * Frame.stride;
+    float d2 = d.x * d.x * Frame.view[view].aspect_w + d.y * d.y;
+    // the radii increase, so the last one it's outside of picks the level
+    int keep = Frame.view[view].keep[0].x;
+    for (int i = 0; i < levels - 1; i++)
+    {
+        float r = Frame.view[view].radius[i / 4][i % 4];
+        if (d2 > r * r)
+            keep = Frame.view[view].keep[(i + 1) / 4][(i + 1) % 4];
+    }
+    return keep;
+}
+
+// whether any level of a view shades less than every block's top left quad
+bool fov_sparse(const int view)
+{
+#ifdef FOV_SPARSE
+    return FOV_SPARSE != 0;
+#else
+    int last = Frame.levels - 1;
+    return Frame.view[view].keep[last / 4][last % 4] < 4;
+#endif
+}
+
+// whether a quad (0 or 1 in x & y, (0, 0) is the top left) of a block is shaded at this keep level
+bool fov_kept(const int keep, const ivec2 block, const ivec2 quad)
+{
+    if (quad == ivec2(0, 0)) // top left
+        return keep >= 4 || ((block.y & 1) == 0 && (keep == 2 || (block.x & 1) == 0));
+    else if (quad == ivec2(0, 1)) // top right
+        return keep >= 16;
+    else if (quad == ivec2(1, 0)) // bottom left
+        return keep >= 12;
+    else // bottom right
+        return keep >= 8;
+}
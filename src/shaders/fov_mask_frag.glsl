@@ -0,0 +1,32 @@
+#version 330 core
+
+// Writes the drop pattern of fov_render_frag.glsl into the stencil buffer.
+// Kept pixels are discarded, so only the dropped pixels survive to set the stencil reference,
+// which lets the expensive pass cull them with the (early) stencil test before any shading.
+
+uniform ivec2 mask_phase; // shift of the drop pattern for the stencil bit being written (not the frame's)
+
+// fov_common.glsl
+int fov_view(const ivec2 frag);
+ivec2 fov_origin(const int view);
+ivec2 fov_block(const ivec2 pixel);
+ivec2 fov_quad(const ivec2 pixel);
+ivec2 fov_center(const int view, const ivec2 phase);
+int fov_keep(const int view, const ivec2 block, const ivec2 center);
+bool fov_kept(const int keep, const ivec2 block, const ivec2 quad);
+
+void main()
+{
+    ivec2 frag = ivec2(gl_FragCoord.xy);
+    int view = fov_view(frag);
+    ivec2 pixel = frag - fov_origin(view) + mask_phase; // in the shifted pattern of the view
+
+    // which block & quad am on?
+    ivec2 block = fov_block(pixel);
+    ivec2 quad_idx = fov_quad(pixel);
+
+    ivec2 center = fov_center(view, mask_phase);
+
+    if (fov_kept(fov_keep(view, block, center), block, quad_idx))
+        discard;
+}
@@ -1,61 +1,44 @@
 #version 330 core
 
 layout(location = 0) out vec4 fragColor;
-uniform vec2 iResolution;
-uniform float iTime;
-uniform vec2 iMouse;
-uniform vec2 Mouse;
-uniform int iFrame;
-
-// foveated render vars
-uniform int stride;
-uniform float thresh1; // smallest foveal region
-uniform float thresh2; // middle region
-uniform float thresh3; // far region
-
-// constant vars
-int quad = stride / 2; // how wide the group of dropped pixels is
+
 const vec4 clear = vec4(0, 0, 0, 1);
+// only temporal reconstruction shifts the pattern (FOV_TEMPORAL is set by ShaderUtils::FoveationDefines)
+#ifndef FOV_TEMPORAL
+#define FOV_TEMPORAL 1
+#endif
+#if FOV_TEMPORAL
+ivec2 drop_phase; // set by main(), a global can't be initialized from the FrameState block
+#else
+const ivec2 drop_phase = ivec2(0);
+#endif
 
 vec4 expensive_main(); // declaration, definition in fragment shader
 
-float norm2(const vec2 a)
-{
-    return dot(a, a);
-}
-
-float sqr(const float a)
-{
-    return a * a;
-}
+// fov_common.glsl
+int fov_view(const ivec2 frag);
+ivec2 fov_origin(const int view);
+ivec2 fov_block(const ivec2 pixel);
+ivec2 fov_quad(const ivec2 pixel);
+ivec2 fov_center(const int view, const ivec2 phase);
+int fov_keep(const int view, const ivec2 block, const ivec2 center);
+bool fov_kept(const int keep, const ivec2 block, const ivec2 quad);
 
 void main()
 {
-    vec2 coord = gl_FragCoord.xy - 0.5; // top left corner of pixel
-
-    // which quad am on?
-    float xmod = mod(coord.x, stride);
-    float ymod = mod(coord.y, stride);
-
-    // compute (boxy) distance to foveal region
-    vec2 boxy_coord = floor(coord / stride) * stride;
-    vec2 center = floor(vec2(Mouse.x, -Mouse.y + iResolution.y) / stride) * stride;
-    float d2 = norm2(boxy_coord - center);
-
-    if (xmod < quad && ymod < quad) // top left
-    {
-        fragColor = expensive_main();
-    }
-    else if (xmod < quad && ymod >= quad) // top right
-    {
-        fragColor = (d2 > sqr(thresh1)) ? clear : expensive_main();
-    }
-    else if (xmod >= quad && ymod < quad) // bottom left
-    {
-        fragColor = (d2 > sqr(thresh2)) ? clear : expensive_main();
-    }
-    else // bottom right
-    {
-        fragColor = (d2 > sqr(thresh3)) ? clear : expensive_main();
-    }
-}
\ No newline at end of file
+#if FOV_TEMPORAL
+    drop_phase = Frame.phase;
+#endif
+    ivec2 frag = ivec2(gl_FragCoord.xy);
+    int view = fov_view(frag);
+    ivec2 pixel = frag - fov_origin(view) + drop_phase; // in the shifted pattern of the view
+
+    // which block & quad am on?
+    ivec2 block = fov_block(pixel);
+    ivec2 quad_idx = fov_quad(pixel);
+
+    // foveation level from the (boxy) distance to the gaze block
+    ivec2 center = fov_center(view, drop_phase);
+
+    fragColor = fov_kept(fov_keep(view, block, center), block, quad_idx) ? expensive_main() : clear;
+}
@@ -0,0 +1,22 @@
+#version 330 core
+
+// buffer "glow" of the trails example: the scene blurred, at half resolution
+
+layout(location = 0) out vec4 fragColor;
+uniform vec2 iResolution;
+uniform sampler2D iChannel0; // scene
+uniform vec2 iChannelResolution[4];
+
+vec4 expensive_main()
+{
+    vec2 uv = gl_FragCoord.xy / iResolution;
+    vec2 texel = 2.0 / iChannelResolution[0];
+    vec3 sum = vec3(0.0);
+    for (int y = -2; y <= 2; y++)
+    {
+        for (int x = -2; x <= 2; x++)
+            sum += texture(iChannel0, uv + vec2(x, y) * texel).rgb;
+    }
+    fragColor = vec4(sum / 25.0, 1.0);
+    return fragColor;
+}
@@ -0,0 +1,20 @@
+#version 330 core
+
+// image of the trails example: the trails & the glow, tone mapped
+
+layout(location = 0) out vec4 fragColor;
+uniform vec2 iResolution;
+uniform float iTime;
+uniform vec2 iMouse;
+uniform int iFrame;
+uniform sampler2D iChannel0; // trails
+uniform sampler2D iChannel1; // glow
+
+vec4 expensive_main()
+{
+    vec2 uv = gl_FragCoord.xy / iResolution;
+    vec3 col = texture(iChannel0, uv).rgb + 0.6 * texture(iChannel1, uv).rgb;
+    col = col / (1.0 + col);
+    fragColor = vec4(pow(col, vec3(1.0 / 2.2)), 1.0);
+    return fragColor;
+}
@@ -0,0 +1,49 @@
+#version 330 core
+
+// buffer "scene" of the trails example: glowing orbs over a noise field
+
+layout(location = 0) out vec4 fragColor;
+uniform vec2 iResolution;
+uniform float iTime;
+uniform vec2 iMouse;
+uniform int iFrame;
+
+float hash(vec2 p)
+{
+    return fract(sin(dot(p, vec2(127.1, 311.7))) * 43758.5453);
+}
+
+float noise(vec2 p)
+{
+    vec2 i = floor(p);
+    vec2 f = fract(p);
+    vec2 u = f * f * (3.0 - 2.0 * f);
+    return mix(mix(hash(i), hash(i + vec2(1, 0)), u.x), mix(hash(i + vec2(0, 1)), hash(i + vec2(1, 1)), u.x), u.y);
+}
+
+float fbm(vec2 p)
+{
+    float v = 0.0;
+    float a = 0.5;
+    for (int i = 0; i < 6; i++)
+    {
+        v += a * noise(p);
+        p *= 2.0;
+        a *= 0.5;
+    }
+    return v;
+}
+
+vec4 expensive_main()
+{
+    vec2 uv = (2.0 * gl_FragCoord.xy - iResolution) / iResolution.y;
+    vec3 col = vec3(0.1, 0.14, 0.2) * fbm(3.0 * uv + 0.2 * iTime);
+    for (int i = 0; i < 4; i++)
+    {
+        float t = iTime * (0.6 + 0.2 * float(i)) + 1.6 * float(i);
+        vec2 c = 0.6 * vec2(cos(t), sin(1.3 * t));
+        col += 0.01 / (dot(uv - c, uv - c) + 0.002) * (0.5 + 0.5 * cos(vec3(0, 2, 4) + float(i)));
+    }
+    fragColor = vec4(col, 1.0);
+    return fragColor;
+}
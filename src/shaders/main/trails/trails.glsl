@@ -0,0 +1,17 @@
+#version 330 core
+
+// buffer "trails" of the trails example: the scene over its own last frame, fading out
+
+layout(location = 0) out vec4 fragColor;
+uniform vec2 iResolution;
+uniform sampler2D iChannel0; // trails (last frame)
+uniform sampler2D iChannel1; // scene
+
+vec4 expensive_main()
+{
+    vec2 uv = gl_FragCoord.xy / iResolution;
+    vec3 last = texture(iChannel0, uv).rgb;
+    vec3 now = texture(iChannel1, uv).rgb;
+    fragColor = vec4(max(now, 0.94 * last), 1.0);
+    return fragColor;
+}
@@ -0,0 +1,41 @@
+#version 330 core
+
+// Composites the variable-resolution foveation levels into the final image:
+//  - level0: full resolution, only rendered in a box around the gaze (up to the second radius)
+//  - level1: half resolution, only rendered in a box around the gaze (up to the third radius)
+//  - level2: quarter resolution, rendered everywhere
+// Lower levels are bilinearly upsampled and neighbouring levels are blended across each ring. Only the first
+// three radii of the foveation profile are used (profiles with fewer repeat their last one), of the first view
+// (the renderer only runs it with a single one).
+
+layout(location = 0) out vec4 fragColor;
+
+uniform sampler2D level0;
+uniform sampler2D level1;
+uniform sampler2D level2;
+
+void main()
+{
+    vec2 coord = gl_FragCoord.xy - 0.5; // top left corner of pixel
+    vec2 uv = gl_FragCoord.xy / Frame.iResolution;
+
+    vec2 center = vec2(Frame.view[0].Mouse.x, -Frame.view[0].Mouse.y + Frame.iResolution.y);
+    vec2 offset = coord - center;
+    float d = sqrt(offset.x * offset.x * Frame.view[0].aspect_w + offset.y * offset.y);
+    float r1 = Frame.view[0].radius[0].x, r2 = Frame.view[0].radius[0].y, r3 = Frame.view[0].radius[0].z;
+
+    vec4 quarter_res = texture(level2, uv);
+    if (d >= r3)
+    {
+        fragColor = quarter_res;
+        return;
+    }
+
+    vec4 colour = texture(level1, uv);
+    if (d < r2)
+    {
+        vec4 full_res = texelFetch(level0, ivec2(coord), 0);
+        colour = mix(full_res, colour, smoothstep(r1, r2, d));
+    }
+    fragColor = mix(colour, quarter_res, smoothstep(r2, r3, d));
+}
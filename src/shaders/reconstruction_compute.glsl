@@ -0,0 +1,61 @@
+#version 430 core
+
+// Compute engine of the spatial reconstruction (reconstruction_engine). Every workgroup loads its tile of the
+// dropped frame into shared memory once and infills all of it from there, with reconstruct() from
+// reconstruction_shader.glsl (linked in, built with FOV_COMPUTE). The infill reads at most a pixel past the
+// block of the pixel, so that's the apron; the lattice infill of the sparse levels reaches further and falls
+// back to the texture outside of the tile. One dispatch covers every view, reconstruct() keeps the reads of a
+// pixel within its own view
+
+layout(local_size_x = 16, local_size_y = 16) in;
+
+uniform sampler2D tex; // the drop pass' target
+layout(binding = 0, rgba8) uniform writeonly image2D result;
+
+// every invocation reconstructs 2x2 pixels of the tile (ComputeTile in renderer.cpp)
+const int tile_size = 32;
+const int apron = 1;
+const int side = tile_size + 2 * apron;
+shared uint tile[side * side]; // packed RGBA8, exact for the 8 bit target
+
+ivec2 tile_origin; // bottom left pixel of this workgroup's tile (without the apron)
+ivec2 frame_size;  // of the framebuffer, all the views side by side
+
+// reconstruction_shader.glsl
+vec4 reconstruct(const ivec2 pixel, int keep);
+
+// texelFetch, zero outside of the frame
+vec4 fetch(const ivec2 p)
+{
+    ivec2 t = p - tile_origin + apron;
+    if (all(greaterThanEqual(t, ivec2(0))) && all(lessThan(t, ivec2(side))))
+        return unpackUnorm4x8(tile[t.y * side + t.x]);
+    if (any(lessThan(p, ivec2(0))) || any(greaterThanEqual(p, frame_size)))
+        return vec4(0.0);
+    return texelFetch(tex, p, 0);
+}
+
+void main()
+{
+    tile_origin = ivec2(gl_WorkGroupID.xy) * tile_size;
+    frame_size = ivec2(Frame.iResolution) * ivec2(Frame.views, 1);
+
+    // neighbouring invocations load neighbouring texels
+    for (int i = int(gl_LocalInvocationIndex); i < side * side; i += 256)
+    {
+        ivec2 p = tile_origin - apron + ivec2(i % side, i / side);
+        bool inside = all(greaterThanEqual(p, ivec2(0))) && all(lessThan(p, frame_size));
+        tile[i] = inside ? packUnorm4x8(texelFetch(tex, p, 0)) : 0u;
+    }
+    barrier();
+
+    for (int y = 0; y < 2; y++)
+    {
+        for (int x = 0; x < 2; x++)
+        {
+            ivec2 pixel = tile_origin + ivec2(gl_LocalInvocationID.xy) + ivec2(x, y) * 16;
+            if (all(lessThan(pixel, frame_size)))
+                imageStore(result, pixel, reconstruct(pixel, -1));
+        }
+    }
+}
@@ -1,146 +1,231 @@
 #version 330 core
 
-layout(location = 0) out vec4 fragColor;
-uniform vec2 iResolution;
-uniform float iTime;
-uniform vec2 iMouse;
-uniform vec2 Mouse;
-uniform int iFrame;
+// Spatial reconstruction, the fragment pass by default (drawn over the tiles that need infilling, see
+// tile_vertex.glsl). With FOV_COMPUTE only reconstruct() is compiled, for the compute engine
+// (reconstruction_compute.glsl) which supplies fetch() from its shared memory tile
 
-in vec2 texCoord;
+#ifndef FOV_COMPUTE
+layout(location = 0) out vec4 fragColor;
+flat in int tile_keep; // kept sixteenths of every block of the tile, -1 if they differ
 uniform sampler2D tex;
 
-// foveated render vars
-uniform int stride;
-uniform float thresh1; // smallest foveal region
-uniform float thresh2; // middle region
-uniform float thresh3; // far region
+vec4 fetch(const ivec2 p)
+{
+    return texelFetch(tex, p, 0);
+}
+#else
+vec4 fetch(const ivec2 p); // reconstruction_compute.glsl
+#endif
 
-// constant vars
-int quad = stride / 2; // how wide the group of dropped pixels is
+// constant vars (compile time constants in the variants specialized for a power of two stride, see fov_common.glsl)
+#ifdef FOV_STRIDE_SHIFT
+const int stride = 1 << FOV_STRIDE_SHIFT;
+const int quad = stride / 2; // how wide the group of dropped pixels is
+#else
+int stride, quad; // set by reconstruct(), a global can't be initialized from the FrameState block
+#endif
+// the lattice infill is only compiled into the variants with a sparse level (or when that's unknown)
+#ifdef FOV_SPARSE
+#define FOV_LATTICE FOV_SPARSE
+#else
+#define FOV_LATTICE 1
+#endif
 const vec4 clear = vec4(0, 0, 0, 1);
 
-float norm2(const vec2 a)
+// fov_common.glsl
+int fov_view(const ivec2 frag);
+ivec2 fov_origin(const int view);
+ivec2 fov_block(const ivec2 pixel);
+ivec2 fov_quad(const ivec2 pixel);
+ivec2 fov_center(const int view, const ivec2 phase);
+int fov_keep(const int view, const ivec2 block, const ivec2 center);
+bool fov_kept(const int keep, const ivec2 block, const ivec2 quad);
+bool fov_sparse(const int view);
+
+// FOV_VIEWS is set by ShaderUtils::FoveationDefines
+#ifndef FOV_VIEWS
+#define FOV_VIEWS 2
+#endif
+// view of the pixel being reconstructed, everything below is in its pixels
+int view = 0;
+ivec2 view_origin = ivec2(0);
+
+// fetch of a pixel of the view, zero outside of it (like outside of the frame) so the views don't bleed together
+vec4 view_fetch(const ivec2 p)
 {
-    return dot(a, a);
+#if FOV_VIEWS > 1
+    if (p.x < 0 || p.x >= int(Frame.iResolution.x))
+        return vec4(0.0);
+#endif
+    return fetch(p + view_origin);
 }
 
-float sqr(const float a)
+// whether the top left quad of a block of an even row was shaded (blocks outside of the frame are never sampled).
+// Every level keeps the even blocks of these rows, so only the odd ones need a look
+bool anchor_kept(const ivec2 block, const ivec2 center)
 {
-    return a * a;
+    ivec2 anchor = block * stride + quad / 2;
+    if (any(lessThan(anchor, ivec2(0))) || any(greaterThanEqual(anchor, ivec2(Frame.iResolution))))
+        return true;
+    return fov_keep(view, block, center) >= 2;
 }
 
-void main()
+// bilinear infill between the top left quads of a lattice of shaded blocks, for the sparse levels (and the
+// blocks that would sample them)
+vec4 lattice(const ivec2 pixel, const ivec2 center)
 {
-    vec2 coord = gl_FragCoord.xy - 0.5; // top left corner of pixel
+    int anchor = quad / 2; // sampled pixel of a top left quad
+    ivec2 cells = ivec2(1, 2); // 1/8 shades every block of the even rows
+    ivec2 size = cells * stride;
+    ivec2 block0 = ivec2(floor(vec2(pixel - anchor) / vec2(size))) * cells;
+    ivec2 odd = ivec2(block0.x | 1, block0.y);
+    if (!anchor_kept(odd, center) || !anchor_kept(odd + ivec2(0, cells.y), center))
+    {
+        cells = ivec2(2, 2); // 1/16 shades every other block of them, which every level does
+        size = cells * stride;
+        block0 = ivec2(floor(vec2(pixel - anchor) / vec2(size))) * cells;
+    }
+    ivec2 p0 = block0 * stride + anchor;
+    ivec2 p1 = p0 + size;
+    vec2 weight = vec2(pixel - p0) / vec2(size);
+    // only the inner anchor at the window border
+    ivec2 max_coord = ivec2(Frame.iResolution) - 1;
+    weight = mix(weight, vec2(1.0), lessThan(p0, ivec2(0)));
+    weight = mix(weight, vec2(0.0), greaterThan(p1, max_coord));
+    p0 = clamp(p0, ivec2(0), max_coord);
+    p1 = clamp(p1, ivec2(0), max_coord);
 
-    // which quad am on?
-    float xmod = mod(coord.x, stride);
-    float ymod = mod(coord.y, stride);
+    vec4 colour = vec4(0.0);
+    colour += (1.0 - weight.y) * (1.0 - weight.x) * view_fetch(p0);        // bottom left
+    colour += (1.0 - weight.y) * weight.x * view_fetch(ivec2(p1.x, p0.y)); // bottom right
+    colour += weight.y * (1.0 - weight.x) * view_fetch(ivec2(p0.x, p1.y)); // top left
+    colour += weight.y * weight.x * view_fetch(p1);                        // top right
+    return colour;
+}
 
-    // compute (boxy) distance to foveal region
-    vec2 boxy_coord = floor(coord / stride) * stride;
-    vec2 center = floor(vec2(Mouse.x, -Mouse.y + iResolution.y) / stride) * stride;
-    float d2 = norm2(boxy_coord - center);
+// keep is the pixel's (a framebuffer pixel) kept sixteenths if known, else negative
+vec4 reconstruct(const ivec2 frag, int keep)
+{
+#ifndef FOV_STRIDE_SHIFT
+    stride = Frame.stride;
+    quad = stride / 2;
+#endif
+    view = fov_view(frag);
+    view_origin = fov_origin(view);
+    ivec2 pixel = frag - view_origin;
+    vec2 coord = vec2(pixel); // top left corner of pixel
+
+    // which block & quad am on?
+    ivec2 block = fov_block(pixel);
+    ivec2 quad_idx = fov_quad(pixel);
+    float xmod = float(pixel.x - block.x * stride);
+    float ymod = float(pixel.y - block.y * stride);
+
+    // foveation level from the (boxy) distance to the gaze block
+    ivec2 center = fov_center(view, ivec2(0));
+    if (keep < 0)
+        keep = fov_keep(view, block, center);
 
     // assume equal weights, though these change depending on interpolation
     float weight_x = 0.5;
     float weight_y = 0.5;
+    vec4 colour;
 
-    if (xmod < quad && ymod < quad) // top left
+    if (fov_kept(keep, block, quad_idx))
+    {
+        // rendered in full in frag shader, pass through
+        colour = view_fetch(ivec2(coord));
+    }
+#if FOV_LATTICE
+    // the cases below sample the blocks to the right & above, which the sparse levels may not shade. Of these 4
+    // blocks the one furthest from the gaze keeps the least
+    else if (fov_sparse(view) && fov_keep(view, block + ivec2(greaterThanEqual(block, center)), center) < 4)
     {
-        // no op (always rendered in full in frag shader)
-        discard;
+        colour = lattice(pixel, center);
     }
-    else if (xmod < quad && ymod >= quad && d2 < sqr(thresh3)) // top right
+#endif
+    else if (quad_idx == ivec2(0, 1) && keep >= 8) // top right
     {
-        if (d2 > sqr(thresh1))
+        weight_x = xmod / quad;          // positive is right
+        weight_y = (ymod - quad) / quad; // positive is up
+        colour = vec4(0.0);
+        // always accumulate vertical pixels for interp
+        colour += weight_y * view_fetch(ivec2(coord.x, coord.y + stride - ymod));           // top
+        colour += (1.0 - weight_y) * view_fetch(ivec2(coord.x, coord.y - ymod + quad - 1)); // bottom
+        // usually accumulate horizontal pixels for interp, but not if left is unfilled
+        vec4 left_colour = view_fetch(ivec2(coord.x - xmod - 1, coord.y));
+        if (left_colour.rgb != vec3(0)) // needs to be coloured somewhat
         {
-            weight_x = xmod / quad;          // positive is right
-            weight_y = (ymod - quad) / quad; // positive is up
-            fragColor = vec4(0.0);
-            // always accumulate vertical pixels for interp
-            fragColor += weight_y * texelFetch(tex, ivec2(coord.x, coord.y + stride - ymod), 0);           // top
-            fragColor += (1.0 - weight_y) * texelFetch(tex, ivec2(coord.x, coord.y - ymod + quad - 1), 0); // bottom
-            // usually accumulate horizontal pixels for interp, but not if left is unfilled
-            vec4 left_colour = texelFetch(tex, ivec2(coord.x - xmod - 1, coord.y), 0);
-            if (left_colour.rgb != vec3(0)) // needs to be coloured somewhat
-            {
-                // as long as left is good, use it for more data
-                fragColor += weight_x * texelFetch(tex, ivec2(coord.x + quad - xmod, coord.y), 0); // right
-                fragColor += (1.0 - weight_x) * left_colour;                                       // left
-                fragColor /= 2; // average between x data and y data
-            }
+            // as long as left is good, use it for more data
+            colour += weight_x * view_fetch(ivec2(coord.x + quad - xmod, coord.y)); // right
+            colour += (1.0 - weight_x) * left_colour;                          // left
+            colour /= 2; // average between x data and y data
         }
-        else
-            discard;
     }
-    else if (xmod >= quad && ymod < quad && d2 < sqr(thresh3)) // bottom left
+    else if (quad_idx == ivec2(1, 0) && keep >= 8) // bottom left
     {
-        if (d2 > sqr(thresh2))
+        weight_x = (xmod - quad) / quad; // positive is right
+        weight_y = ymod / quad;          // positive is up
+        colour = vec4(0.0);
+        // always accumulate left/right data for interp
+        colour += (1.0 - weight_x) * view_fetch(ivec2(coord.x - xmod + quad - 1, coord.y)); // left
+        colour += weight_x * view_fetch(ivec2(coord.x + stride - xmod, coord.y));           // right
+        // usually accumulate vertical pixels for interp, but not if bottom is unfilled
+        vec4 bottom_colour = view_fetch(ivec2(coord.x, coord.y - ymod - 1));
+        if (bottom_colour.rgb != vec3(0)) // needs to be coloured somewhat
         {
-            weight_x = (xmod - quad) / quad; // positive is right
-            weight_y = ymod / quad;          // positive is up
-            fragColor = vec4(0.0);
-            // always accumulate left/right data for interp
-            fragColor += (1.0 - weight_x) * texelFetch(tex, ivec2(coord.x - xmod + quad - 1, coord.y), 0); // left
-            fragColor += weight_x * texelFetch(tex, ivec2(coord.x + stride - xmod, coord.y), 0);           // right
-            // usually accumulate vertical pixels for interp, but not if bottom is unfilled
-            vec4 bottom_colour = texelFetch(tex, ivec2(coord.x, coord.y - ymod - 1), 0);
-            if (bottom_colour.rgb != vec3(0)) // needs to be coloured somewhat
-            {
-                fragColor += weight_y * texelFetch(tex, ivec2(coord.x, coord.y + quad - ymod), 0); // top
-                fragColor += (1.0 - weight_y) * bottom_colour;                                     // bottom
-                fragColor /= 2; // average between x data and y data
-            }
+            colour += weight_y * view_fetch(ivec2(coord.x, coord.y + quad - ymod)); // top
+            colour += (1.0 - weight_y) * bottom_colour;                        // bottom
+            colour /= 2; // average between x data and y data
         }
-        else
-            discard;
     }
-    else // bottom right
+    else // only the top left is shaded
     {
-        if (d2 >= sqr(thresh3))
+        colour = vec4(0.0);
+        // need to case for horizontal, vertical, or diagonal bilinear interp.
+        if (xmod < quad)
         {
-            fragColor = vec4(0.0);
-            // need to case for horizontal, vertical, or diagonal bilinear interp.
-            if (xmod < quad)
-            {
-                // case 1: vertical bilinear interpolation
-                weight_y = (ymod - quad) / quad; // positive is up
+            // case 1: vertical bilinear interpolation
+            weight_y = (ymod - quad) / quad; // positive is up
 
-                fragColor += weight_y * texelFetch(tex, ivec2(coord.x, coord.y + stride - ymod), 0);           // top
-                fragColor += (1.0 - weight_y) * texelFetch(tex, ivec2(coord.x, coord.y - ymod + quad - 1), 0); // bottom
+            colour += weight_y * view_fetch(ivec2(coord.x, coord.y + stride - ymod));           // top
+            colour += (1.0 - weight_y) * view_fetch(ivec2(coord.x, coord.y - ymod + quad - 1)); // bottom
+        }
+        else
+        {
+            weight_x = (xmod - quad) / quad; // positive is right
+            if (ymod < quad)
+            {
+                // case 2: horizontal bilinear interpolation
+                colour += weight_x * view_fetch(ivec2(coord.x + stride - xmod, coord.y));           // R
+                colour += (1.0 - weight_x) * view_fetch(ivec2(coord.x - xmod + quad - 1, coord.y)); // L
             }
             else
             {
-                weight_x = (xmod - quad) / quad; // positive is right
-                if (ymod < quad)
-                {
-                    // case 2: horizontal bilinear interpolation
-                    fragColor += weight_x * texelFetch(tex, ivec2(coord.x + stride - xmod, coord.y), 0);           // R
-                    fragColor += (1.0 - weight_x) * texelFetch(tex, ivec2(coord.x - xmod + quad - 1, coord.y), 0); // L
-                }
-                else
-                {
-                    // case 3: diagonal trilinear interpolation
-                    weight_y = (ymod - quad) / quad;                        // positive is up
-                    float weight_xy1 = (1.0 - weight_y) * weight_x;         // positive is bottom right
-                    float weight_xy2 = weight_y * (1.0 - weight_x);         // positive is top left
-                    float weight_xy3 = weight_y * weight_x;                 // positive is top right
-                    float weight_xy4 = (1.0 - weight_y) * (1.0 - weight_x); // positive is bottom left
-
-                    fragColor += // bottom right
-                        weight_xy1 * texelFetch(tex, ivec2(coord.x + stride - xmod, coord.y - ymod + quad - 1), 0);
-                    fragColor += // top left
-                        weight_xy2 * texelFetch(tex, ivec2(coord.x - xmod + quad - 1, coord.y + stride - ymod), 0);
-                    fragColor += // top right
-                        weight_xy3 * texelFetch(tex, ivec2(coord.x + stride - xmod, coord.y + stride - ymod), 0);
-                    fragColor += // bottom left
-                        weight_xy4 * texelFetch(tex, ivec2(coord.x - xmod + quad - 1, coord.y - ymod + quad - 1), 0);
-                }
+                // case 3: diagonal trilinear interpolation
+                weight_y = (ymod - quad) / quad;                        // positive is up
+                float weight_xy1 = (1.0 - weight_y) * weight_x;         // positive is bottom right
+                float weight_xy2 = weight_y * (1.0 - weight_x);         // positive is top left
+                float weight_xy3 = weight_y * weight_x;                 // positive is top right
+                float weight_xy4 = (1.0 - weight_y) * (1.0 - weight_x); // positive is bottom left
+
+                colour += // bottom right
+                    weight_xy1 * view_fetch(ivec2(coord.x + stride - xmod, coord.y - ymod + quad - 1));
+                colour += // top left
+                    weight_xy2 * view_fetch(ivec2(coord.x - xmod + quad - 1, coord.y + stride - ymod));
+                colour += // top right
+                    weight_xy3 * view_fetch(ivec2(coord.x + stride - xmod, coord.y + stride - ymod));
+                colour += // bottom left
+                    weight_xy4 * view_fetch(ivec2(coord.x - xmod + quad - 1, coord.y - ymod + quad - 1));
             }
         }
-        else
-            discard;
     }
-}
\ No newline at end of file
+    return colour;
+}
+
+#ifndef FOV_COMPUTE
+void main()
+{
+    fragColor = reconstruct(ivec2(gl_FragCoord.xy), tile_keep);
+}
+#endif
@@ -0,0 +1,90 @@
+#version 330 core
+
+// Temporal alternative to reconstruction_shader.glsl. The drop pattern is shifted every frame (phase),
+// so over a few frames every pixel gets shaded (except in the sparse 1/8 & 1/16 levels). Dropped pixels are
+// filled from the accumulated history, clamped to the colour range of this frame's shaded neighbours so stale
+// history can't ghost.
+
+layout(location = 0) out vec4 fragColor;
+
+uniform sampler2D tex;     // this frame's (partially dropped) render
+uniform sampler2D history; // last frame's reconstruction
+
+// constant vars (compile time constants in the variants specialized for a power of two stride)
+#ifdef FOV_STRIDE_SHIFT
+const int stride = 1 << FOV_STRIDE_SHIFT;
+const int quad = stride / 2; // how wide the group of dropped pixels is
+#else
+int stride, quad; // set by main(), a global can't be initialized from the FrameState block
+#endif
+
+// fov_common.glsl
+int fov_view(const ivec2 frag);
+ivec2 fov_origin(const int view);
+ivec2 fov_block(const ivec2 pixel);
+ivec2 fov_quad(const ivec2 pixel);
+ivec2 fov_center(const int view, const ivec2 phase);
+int fov_keep(const int view, const ivec2 block, const ivec2 center);
+bool fov_kept(const int keep, const ivec2 block, const ivec2 quad);
+
+bool is_kept(const int view, ivec2 pixel, const ivec2 center)
+{
+    // same drop pattern as fov_render_frag.glsl (pixel is in the unshifted view space)
+    pixel += Frame.phase;
+    ivec2 block = fov_block(pixel);
+    return fov_kept(fov_keep(view, block, center), block, fov_quad(pixel));
+}
+
+void main()
+{
+#ifndef FOV_STRIDE_SHIFT
+    stride = Frame.stride;
+    quad = stride / 2;
+#endif
+    ivec2 frag = ivec2(gl_FragCoord.xy);
+    int view = fov_view(frag);
+    ivec2 origin = fov_origin(view);
+    ivec2 pixel = frag - origin;
+    ivec2 center = fov_center(view, Frame.phase);
+
+    if (is_kept(view, pixel, center))
+    {
+        // shaded this frame, pass through
+        fragColor = texelFetch(tex, frag, 0);
+        return;
+    }
+
+    // colour range of the shaded samples one quad away in every direction, further out in the sparse levels
+    // (which don't shade every block)
+    vec4 lo = vec4(1.0);
+    vec4 hi = vec4(0.0);
+    int num = 0;
+    ivec2 max_coord = ivec2(Frame.iResolution) - 1;
+    for (int dist = quad; dist <= 2 * stride && num == 0; dist *= 2)
+    {
+        for (int j = -1; j <= 1; j++)
+        {
+            for (int i = -1; i <= 1; i++)
+            {
+                ivec2 neighbour = clamp(pixel + ivec2(i, j) * dist, ivec2(0), max_coord);
+                if ((i == 0 && j == 0) || !is_kept(view, neighbour, center))
+                    continue;
+                vec4 colour = texelFetch(tex, neighbour + origin, 0);
+                lo = min(lo, colour);
+                hi = max(hi, colour);
+                num++;
+            }
+        }
+    }
+
+    if (num == 0)
+    {
+        // nothing shaded nearby (only at the view border), fall back to history alone
+        fragColor = texelFetch(history, frag, 0);
+        return;
+    }
+
+    // reuse the previous shading, but never outside of what this frame's neighbourhood allows
+    vec4 previous = texelFetch(history, frag, 0);
+    fragColor = clamp(previous, lo, hi);
+}
@@ -0,0 +1,15 @@
+#version 330 core
+// instanced quad over a run of tiles of the reconstruction that need infilling (Renderer::UpdateTiles)
+
+layout(location = 0) in vec3 position; // corner of the canvas (-1 to 1)
+layout(location = 1) in ivec4 tile;    // bottom left pixel & size (pixels)
+layout(location = 2) in int keep;      // kept sixteenths of every block in it (-1 if they differ)
+
+flat out int tile_keep;
+void main()
+{
+    vec2 corner = vec2(tile.xy) + (position.xy * 0.5 + 0.5) * vec2(tile.zw);
+    vec2 size = Frame.iResolution * vec2(Frame.views, 1); // all the views side by side
+    gl_Position = vec4(min(corner, size) / size * 2.0 - 1.0, 0.0, 1.0);
+    tile_keep = keep;
+}
@@ -0,0 +1,263 @@
+#include "timeline.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace Timeline
+{
+
+namespace
+{
+
+struct Event
+{
+    const char *Name = nullptr;
+    int64_t Begin = 0, End = 0; // microseconds
+    int Track = 0;
+    std::string Detail;
+};
+
+constexpr int GpuTrack = 0;
+// a dump waits this many frames for the GPU timings of the frames before it (GpuProfiler's ring is 5 deep)
+constexpr int DumpDelay = 8;
+
+const auto Epoch = std::chrono::steady_clock::now();
+std::atomic<bool> bOn{false};
+thread_local int Track = -1;
+int64_t LastSpike = -1; // render thread (EndFrame) only
+
+std::mutex Lock; // guards everything below
+std::vector<Event> Ring;
+size_t Next = 0, Count = 0;
+std::vector<std::string> TrackNames = {"GPU"};
+int64_t WindowUs = 0;  // how far back a dump goes
+int64_t GpuOffset = 0; // timeline minus GPU clock (microseconds)
+bool bGpuSynced = false;
+int DumpIn = 0; // frames until the requested dump is taken, 0 if none is
+std::string DumpReason;
+int64_t DumpRequested = 0;
+int NumDumps = 0;
+std::string OutputPrefix;
+std::thread Writer;
+std::atomic<bool> bWriting{false};
+
+int ThisTrack()
+{
+    if (Track < 0)
+    {
+        std::lock_guard<std::mutex> Guard(Lock);
+        Track = static_cast<int>(TrackNames.size());
+        TrackNames.push_back("thread " + std::to_string(Track));
+    }
+    return Track;
+}
+
+void Push(const char *Name, const int64_t Begin, const int64_t End, const int T, const std::string &Detail)
+{
+    std::lock_guard<std::mutex> Guard(Lock);
+    if (Ring.empty())
+        return;
+    Event &E = Ring[Next];
+    E.Name = Name;
+    E.Begin = Begin;
+    E.End = End;
+    E.Track = T;
+    E.Detail = Detail;
+    Next = (Next + 1) % Ring.size();
+    Count = std::min(Count + 1, Ring.size());
+}
+
+std::string Escape(const std::string &S)
+{
+    std::string Out;
+    for (const char C : S)
+    {
+        if (C == '"' || C == '\\')
+            Out += '\\';
+        if (static_cast<unsigned char>(C) < 0x20)
+            Out += ' ';
+        else
+            Out += C;
+    }
+    return Out;
+}
+
+void Write(const std::string &Path, const std::vector<Event> &Events, const std::vector<std::string> &Names,
+           const std::string &Reason, const int64_t Requested)
+{
+    std::ofstream Out(Path);
+    Out << "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"reason\":\"" << Escape(Reason) << "\"},\"traceEvents\":[\n";
+    Out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"gl-fovrender\"}}";
+    for (size_t T = 0; T < Names.size(); T++)
+    {
+        Out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << T << ",\"args\":{\"name\":\""
+            << Escape(Names[T]) << "\"}}";
+    }
+    for (const Event &E : Events)
+    {
+        Out << ",\n{\"name\":\"" << E.Name << "\",\"cat\":\"" << (E.Track == GpuTrack ? "gpu" : "cpu")
+            << "\",\"ph\":\"X\",\"ts\":" << E.Begin << ",\"dur\":" << std::max<int64_t>(E.End - E.Begin, 0)
+            << ",\"pid\":1,\"tid\":" << E.Track;
+        if (!E.Detail.empty())
+            Out << ",\"args\":{\"detail\":\"" << Escape(E.Detail) << "\"}";
+        Out << "}";
+    }
+    Out << ",\n{\"name\":\"dump\",\"ph\":\"i\",\"s\":\"g\",\"ts\":" << Requested << ",\"pid\":1,\"tid\":0,"
+        << "\"args\":{\"reason\":\"" << Escape(Reason) << "\"}}\n]}\n";
+    Out.close();
+    if (!Out)
+        std::cerr << "can't write the timeline to \"" << Path << "\"" << std::endl;
+    else
+        std::cout << "Timeline: " << Events.size() << " spans (" << Reason << ") written to \"" << Path << "\""
+                  << std::endl;
+    bWriting = false;
+}
+
+// under Lock
+void Dump()
+{
+    if (bWriting)
+    {
+        std::cerr << "timeline still being written, skipping the dump (" << DumpReason << ")" << std::endl;
+        return;
+    }
+    if (Writer.joinable())
+        Writer.join();
+
+    // the last seconds, oldest first
+    const int64_t From = Now() - WindowUs;
+    std::vector<Event> Events;
+    for (size_t i = 0; i < Count; i++)
+    {
+        const Event &E = Ring[(Next + Ring.size() - Count + i) % Ring.size()];
+        if (E.End >= From)
+            Events.push_back(E);
+    }
+    const std::string Path = OutputPrefix + "_" + std::to_string(NumDumps++) + ".json";
+    bWriting = true;
+    Writer = std::thread(Write, Path, std::move(Events), TrackNames, DumpReason, DumpRequested);
+}
+
+} // namespace
+
+bool Start(const TimelineParamsStruct &P)
+{
+    std::lock_guard<std::mutex> Guard(Lock);
+    // generously sized, frames are a few dozen spans
+    WindowUs = static_cast<int64_t>(std::max(P.seconds, 0.1f) * 1e6);
+    Ring.assign(std::max<size_t>(static_cast<size_t>(std::max(P.seconds, 0.1f) * 16384), 4096), Event());
+    Next = Count = 0;
+    OutputPrefix = P.output_prefix;
+    bOn = true;
+    std::cout << "Timeline: keeping the last " << P.seconds << "s, dumped on demand (T)";
+    if (P.spike_ms > 0.f)
+        std::cout << " or after a frame over " << P.spike_ms << "ms";
+    std::cout << std::endl;
+    return true;
+}
+
+void Stop()
+{
+    std::lock_guard<std::mutex> Guard(Lock);
+    if (DumpIn > 0 && !Ring.empty())
+    {
+        DumpIn = 0;
+        Dump(); // requested right before exiting
+    }
+    bOn = false;
+    if (Writer.joinable())
+        Writer.join();
+    Ring.clear();
+    Count = Next = 0;
+}
+
+bool IsOn()
+{
+    return bOn.load(std::memory_order_relaxed);
+}
+
+int64_t Now()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - Epoch).count();
+}
+
+void NameThread(const char *Name)
+{
+    const int T = ThisTrack();
+    std::lock_guard<std::mutex> Guard(Lock);
+    TrackNames[T] = Name;
+}
+
+void Add(const char *Name, const int64_t Begin, const int64_t End, const std::string &Detail)
+{
+    if (IsOn())
+        Push(Name, Begin, End, ThisTrack(), Detail);
+}
+
+void SyncGpuClock(const int64_t GpuNs)
+{
+    const int64_t Cpu = Now();
+    std::lock_guard<std::mutex> Guard(Lock);
+    GpuOffset = Cpu - GpuNs / 1000;
+    bGpuSynced = true;
+}
+
+void AddGpu(const char *Name, const uint64_t BeginNs, const uint64_t EndNs, const uint64_t FrameId)
+{
+    if (!IsOn())
+        return;
+    int64_t Offset;
+    {
+        std::lock_guard<std::mutex> Guard(Lock);
+        if (!bGpuSynced)
+            return;
+        Offset = GpuOffset;
+    }
+    Push(Name, static_cast<int64_t>(BeginNs / 1000) + Offset, static_cast<int64_t>(EndNs / 1000) + Offset, GpuTrack,
+         "frame " + std::to_string(FrameId));
+}
+
+void EndFrame(const uint64_t FrameId, const int64_t Begin, const TimelineParamsStruct &P)
+{
+    if (!IsOn())
+        return;
+    const int64_t End = Now();
+    Push("frame", Begin, End, ThisTrack(), std::to_string(FrameId));
+    const double Ms = (End - Begin) * 1e-3;
+    if (P.spike_ms > 0.f && Ms > P.spike_ms && (LastSpike < 0 || End - LastSpike > WindowUs))
+    {
+        // the next one a whole dump later, a run of slow frames is one dump
+        LastSpike = End;
+        std::stringstream ss;
+        ss << "frame " << FrameId << " took " << Ms << "ms";
+        RequestDump(ss.str());
+    }
+
+    std::lock_guard<std::mutex> Guard(Lock);
+    OutputPrefix = P.output_prefix;
+    if (DumpIn > 0 && --DumpIn == 0)
+        Dump();
+}
+
+void RequestDump(const std::string &Reason)
+{
+    if (!IsOn())
+    {
+        std::cout << "Timeline is off (timeline=true keeps one)" << std::endl;
+        return;
+    }
+    std::lock_guard<std::mutex> Guard(Lock);
+    if (DumpIn > 0)
+        return; // that one covers this too
+    DumpIn = DumpDelay;
+    DumpReason = Reason;
+    DumpRequested = Now();
+}
+
+} // namespace Timeline
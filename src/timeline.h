@@ -0,0 +1,56 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include "utils.h"
+#include <cstdint>
+#include <string>
+
+// Timeline of what every thread (and the GPU) spent its time on, to tell CPU stalls from GPU bound frames. Spans
+// go into a ring covering the last few seconds, cheap enough to stay on, and are only written out (as a Chrome
+// trace / Perfetto JSON file, on a background thread) on demand or after a frame time spike. Everything is a no-op
+// until Start
+namespace Timeline
+{
+
+bool Start(const TimelineParamsStruct &P);
+void Stop(); // waits for a dump still being written
+bool IsOn();
+int64_t Now(); // microseconds on the timeline's clock
+
+void NameThread(const char *Name); // the calling thread's track
+// Name has to outlive the timeline (a literal)
+void Add(const char *Name, int64_t Begin, int64_t End, const std::string &Detail = "");
+// GPU timestamps (ns, GL_TIMESTAMP) go on the clock of the last SyncGpuClock
+void SyncGpuClock(int64_t GpuNs); // GL_TIMESTAMP as of now
+void AddGpu(const char *Name, uint64_t BeginNs, uint64_t EndNs, uint64_t FrameId);
+
+// closes a frame that started at Begin, dumps once a requested dump (or a spike, a frame slower than spike_ms) has
+// its GPU timings in
+void EndFrame(uint64_t FrameId, int64_t Begin, const TimelineParamsStruct &P);
+void RequestDump(const std::string &Reason);
+
+// the lifetime of the object, on the calling thread's track
+class Span
+{
+  public:
+    explicit Span(const char *Name, const std::string &Detail = "")
+        : Name(Name), Detail(IsOn() ? Detail : std::string()), Begin(IsOn() ? Now() : -1)
+    {
+    }
+    ~Span()
+    {
+        if (Begin >= 0)
+            Add(Name, Begin, Now(), Detail);
+    }
+    Span(const Span &) = delete;
+    Span &operator=(const Span &) = delete;
+
+  private:
+    const char *Name;
+    std::string Detail;
+    int64_t Begin;
+};
+
+} // namespace Timeline
+
+#endif
@@ -1,10 +1,16 @@
 #ifndef UTILS
 #define UTILS
 
+#include <algorithm>
+#include <array>
 #include <cassert>
+#include <cmath>
 #include <cstdio>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <map>
+#include <sstream>
 #include <vector>
 
 inline bool stob(const std::string &s)
@@ -13,40 +19,268 @@ inline bool stob(const std::string &s)
     return (s.at(0) == 't' || s.at(0) == 'T');
 }
 
-inline auto readFile(const std::string_view path) -> const std::string
+inline std::vector<std::string> split(const std::string &s, const char delim)
+{
+    // split a delimiter-separated list (ex. "8,16,32") into its elements
+    std::vector<std::string> Elements;
+    std::stringstream ss(s);
+    std::string Element;
+    while (std::getline(ss, Element, delim))
+    {
+        if (!Element.empty())
+            Elements.push_back(Element);
+    }
+    return Elements;
+}
+
+inline bool sameFile(const std::string &a, const std::string &b)
+{
+    // same file on disk, regardless of how the paths are spelled (false if either doesn't exist)
+    std::error_code Err;
+    return std::filesystem::equivalent(a, b, Err);
+}
+
+// false if it can't be read (ex. removed since the directory was scanned), the caller keeps what it had
+inline bool readFile(const std::string_view path, std::string &out)
 {
     std::cout << "Reading shader: \"" << path << "\"" << std::endl;
-    std::ifstream Input(path);
+    std::ifstream Input(path.data());
     if (!Input.is_open())
     {
-        std::cout << "Unable to read file \"" << path << "\"" << std::endl;
-        exit(1);
+        std::cerr << "Unable to read file \"" << path << "\"" << std::endl;
+        return false;
     }
     // Avoid dynamic allocation: read the 4096 first bytes
     constexpr auto read_size = std::size_t(4096);
     auto stream = std::ifstream(path.data());
     stream.exceptions(std::ios_base::badbit);
 
-    auto out = std::string();
+    out.clear();
     auto buf = std::string(read_size, '\0');
     while (stream.read(&buf[0], read_size))
     {
         out.append(buf, 0, stream.gcount());
     }
     out.append(buf, 0, stream.gcount());
-    return out;
+    return true;
 }
 
 struct MainShaderParams
 {
     std::string vertex_shader_path, non_fr_fragment_shader_path, fragment_shader_dir, fragment_shader_name;
+    std::string cache_dir = "";  // program binary cache, disabled if empty
+    bool bPrecompile = true;     // compile every main shader in the background (not while benchmarking)
+};
+
+enum class FovStrategy
+{
+    Checkerboard, // drop pixels in one full resolution pass, then reconstruct
+    MultiRes,     // render the rings at decreasing resolution, then composite
+};
+
+inline FovStrategy stofs(const std::string &s)
+{
+    return (s == "multires") ? FovStrategy::MultiRes : FovStrategy::Checkerboard;
+}
+
+inline std::string fstos(const FovStrategy S)
+{
+    return (S == FovStrategy::MultiRes) ? "multires" : "checkerboard";
+}
+
+enum class ReconstructionMode
+{
+    Spatial,  // infill dropped pixels from their kept neighbours in the same frame
+    Temporal, // shift the drop pattern every frame and infill from the (clamped) history
 };
 
+inline ReconstructionMode stors(const std::string &s)
+{
+    return (s == "temporal") ? ReconstructionMode::Temporal : ReconstructionMode::Spatial;
+}
+
+inline std::string rstos(const ReconstructionMode R)
+{
+    return (R == ReconstructionMode::Temporal) ? "temporal" : "spatial";
+}
+
+enum class ReconstructionEngine
+{
+    Auto,     // compute when the context has GL 4.3
+    Fragment, // full-screen fragment pass
+    Compute,  // compute shader infilling from shared memory tiles (spatial reconstruction only)
+};
+
+inline ReconstructionEngine stoeng(const std::string &s)
+{
+    if (s == "fragment")
+        return ReconstructionEngine::Fragment;
+    return (s == "compute") ? ReconstructionEngine::Compute : ReconstructionEngine::Auto;
+}
+
 struct FRShaderParams
 {
-    std::string drop_shader, reconstruction_shader;
+    std::string drop_shader, reconstruction_shader, mask_shader, multires_shader, temporal_shader, compute_shader;
+    std::string tile_shader; // vertex shader of the reconstruction's tiles
+    FovStrategy Strategy = FovStrategy::Checkerboard;
+    ReconstructionMode Reconstruction = ReconstructionMode::Spatial; // only used by the checkerboard strategy
+    ReconstructionEngine Engine = ReconstructionEngine::Auto;       // of the spatial reconstruction
+    bool bStencilMask = false; // cull dropped pixels with a stencil mask instead of branching in drop_shader
     int stride;
-    float thresh1, thresh2, thresh3;
+    // foveation profile: level i reaches out to radii[i] (fraction of the window diagonal), the last level covers
+    // everything beyond. Each level shades keep[i] of its pixels (1, 3/4, 1/2, 1/4, 1/8 or 1/16)
+    std::vector<float> radii = {0.1f, 0.25f, 0.4f};
+    std::vector<float> keep = {1.f, 0.75f, 0.5f, 0.25f};
+    float aspect = 1.f; // horizontal stretch of the levels (1 for circles)
+    std::string common_shader; // fov_common.glsl, linked into every program that evaluates the profile
+};
+
+constexpr int MaxFovLevels = 8; // size of the profile arrays of the FrameState block
+constexpr int MaxViews = 2;     // size of the view array of the FrameState block
+
+inline int KeepSixteenths(const float Keep)
+{
+    // the drop pattern only knows these ratios, 0 for anything else
+    const int Sixteenths = static_cast<int>(Keep * 16.f + 0.5f);
+    for (const int Supported : {16, 12, 8, 4, 2, 1})
+    {
+        if (Sixteenths == Supported && std::abs(Keep * 16.f - Sixteenths) < 0.01f)
+            return Supported;
+    }
+    return 0;
+}
+
+inline float stofrac(const std::string &s)
+{
+    // "0.25" or "1/4"
+    const size_t Slash = s.find('/');
+    if (Slash == std::string::npos)
+        return std::stof(s);
+    return std::stof(s.substr(0, Slash)) / std::stof(s.substr(Slash + 1));
+}
+
+inline bool CheckFovProfile(const FRShaderParams &P)
+{
+    const size_t NumLevels = P.keep.size();
+    if (NumLevels < 1 || NumLevels > MaxFovLevels || P.radii.size() + 1 != NumLevels)
+    {
+        std::cerr << "the foveation profile needs 1 to " << MaxFovLevels << " keep ratios and one radius less ("
+                  << P.keep.size() << " ratios, " << P.radii.size() << " radii)" << std::endl;
+        return false;
+    }
+    for (size_t i = 0; i < NumLevels; i++)
+    {
+        if (KeepSixteenths(P.keep[i]) == 0)
+        {
+            std::cerr << "unsupported keep ratio " << P.keep[i] << " (1, 3/4, 1/2, 1/4, 1/8 or 1/16)" << std::endl;
+            return false;
+        }
+        if (i > 0 && P.keep[i] > P.keep[i - 1])
+        {
+            std::cerr << "keep ratios can't increase away from the gaze" << std::endl;
+            return false;
+        }
+        if (i + 1 < NumLevels && (P.radii[i] <= 0.f || (i > 0 && P.radii[i] <= P.radii[i - 1])))
+        {
+            std::cerr << "foveation radii must be positive and increasing" << std::endl;
+            return false;
+        }
+    }
+    if (P.aspect <= 0.f)
+    {
+        std::cerr << "foveation aspect must be positive" << std::endl;
+        return false;
+    }
+    // a block is 2x2 quads of stride / 2 pixels (the keys double & halve it within the same range)
+    if (P.stride < 2 || P.stride > 256 || P.stride % 2 != 0)
+    {
+        std::cerr << "unsupported stride " << P.stride << " (even, 2 to 256)" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+enum class CaptureFormat
+{
+    Y4M,  // <path>.y4m
+    PNG,  // <path>_000000.png, <path>_000001.png, ...
+    Pipe, // y4m stream into the stdin of command (ex. an encoder)
+};
+
+inline CaptureFormat stocf(const std::string &s)
+{
+    return (s == "png") ? CaptureFormat::PNG : (s == "pipe") ? CaptureFormat::Pipe : CaptureFormat::Y4M;
+}
+
+inline std::string cftos(const CaptureFormat F)
+{
+    return (F == CaptureFormat::PNG) ? "png" : (F == CaptureFormat::Pipe) ? "pipe" : "y4m";
+}
+
+struct CaptureParamsStruct
+{
+    bool bEnable = false; // capture from the first frame (toggled with C while running)
+    CaptureFormat Format = CaptureFormat::Y4M;
+    std::string path = "capture";
+    std::string command = ""; // params are whitespace separated, so its arguments are separated by commas
+    int fps = 60;             // frame rate written to the y4m header
+    int num_pbos = 3;         // frames in flight before the readback would have to wait
+};
+
+enum class GazeSource
+{
+    Mouse,  // the cursor
+    Trace,  // replays a recorded trace file
+    Socket, // samples sent by another process (ex. an eye tracker) over a local socket
+};
+
+inline GazeSource stogs(const std::string &s)
+{
+    return (s == "trace") ? GazeSource::Trace : (s == "socket") ? GazeSource::Socket : GazeSource::Mouse;
+}
+
+inline std::string gstos(const GazeSource G)
+{
+    return (G == GazeSource::Trace) ? "trace" : (G == GazeSource::Socket) ? "socket" : "mouse";
+}
+
+struct GazeParamsStruct
+{
+    GazeSource Source = GazeSource::Mouse;
+    std::string trace = "gaze.txt";            // lines of "seconds x y" (x & y normalized, y down)
+    bool bTraceLoop = true;                    // restart the trace once it ends
+    std::string socket = "udp:127.0.0.1:4242"; // "udp:host:port" or "unix:path", datagrams of "x y"
+    bool bPredict = true;                      // extrapolate the gaze to when the frame is scanned out
+    float latency_ms = 25.f;                   // gaze sample to scan-out latency to compensate
+    float saccade_speed = 2.f;                 // gaze speed (windows per second) treated as a saccade
+    float max_lead = 0.1f;                     // furthest (normalized) the prediction may lead the gaze
+};
+
+struct TraceParamsStruct
+{
+    std::string record = "";                      // records the session's inputs to this file (empty disables)
+    std::string replay = "";                      // replays a recorded session instead of live inputs, then exits
+    float time_step = 0.f;                        // fixed replay clock step (seconds), 0 uses the recorded ones
+    std::string output_prefix = "replay_results"; // timings of the replay, written like the benchmark's
+};
+
+struct TimelineParamsStruct
+{
+    bool bEnable = false;                   // keeps a ring of CPU & GPU spans, dumped on demand or on spikes
+    float seconds = 5.f;                    // how far back a dump goes
+    float spike_ms = 0.f;                   // dumps after a frame slower than this (0 only on demand)
+    std::string output_prefix = "timeline"; // dumps go to <prefix>_<n>.json (Chrome trace / Perfetto)
+};
+
+struct AdaptiveParamsStruct
+{
+    bool bEnable = false;     // adapt the foveation profile to the GPU frame time (not in replays or the benchmark)
+    float target_ms = 8.3f;   // GPU time budget per frame
+    float hysteresis = 0.15f; // only give quality back below (1 - hysteresis) * target_ms
+    int num_frames = 8;       // frames averaged per decision (once the previous change shows up in the timings)
+    float min_radius = 0.5f;  // smallest share of the configured radii
+    int max_keep_steps = 2;   // most notches the levels outside the fovea drop (1, 3/4, 1/2, 1/4, 1/8, 1/16)
+    int max_stride = 64;      // largest stride it may double up to
 };
 
 struct WindowParamsStruct
@@ -54,75 +288,361 @@ struct WindowParamsStruct
     int X0, Y0;
 };
 
+struct ViewParamsStruct
+{
+    int views = 1; // 2 renders a stereo pair side by side (left & right eye), each half of the window
+    // profile of the right eye, the fr one's if empty (needs as many levels, the stride is shared)
+    std::vector<float> right_radii, right_keep;
+    float right_aspect = 0.f; // 0 for fov_aspect
+};
+
+// the profile of a view, Base is the first view's
+inline FRShaderParams ViewProfile(const FRShaderParams &Base, const ViewParamsStruct &V, const int View)
+{
+    FRShaderParams P = Base;
+    if (View == 0)
+        return P;
+    if (!V.right_radii.empty())
+        P.radii = V.right_radii;
+    if (!V.right_keep.empty())
+        P.keep = V.right_keep;
+    if (V.right_aspect > 0.f)
+        P.aspect = V.right_aspect;
+    return P;
+}
+
+struct BenchmarkParamsStruct
+{
+    bool bEnable = false;
+    bool bHeadless = true;             // use the GLFW null platform (no display server required)
+    std::string context_api = "egl";   // "egl" or "osmesa" (only used when headless)
+    int width = 1920, height = 1080;   // fixed offscreen resolution
+    int num_frames = 300;              // measured frames per configuration
+    int num_warmup_frames = 30;        // frames rendered (but not measured) before each configuration
+    float time_step = 1.f / 60.f;      // fixed simulated time step (seconds) per frame
+    std::vector<int> strides = {16};   // sweep of stride values
+    std::vector<std::vector<float>> thresholds = {{0.1f, 0.25f, 0.4f}}; // sweep of the foveation radii
+    std::vector<FovStrategy> strategies = {FovStrategy::Checkerboard};  // foveation strategies to compare
+    std::vector<ReconstructionMode> reconstructions = {ReconstructionMode::Spatial}; // checkerboard only
+    std::string output_prefix = "bench_results";
+    bool bVerify = false;   // check the GPU reconstruction against the CPU reference (checkerboard spatial only)
+    bool bQuality = true;   // score the last frame of every foveated run against the full quality one
+    float min_ssim = 0.f;   // fail the benchmark if any foveated run scores below this (0 disables)
+    std::string trace = ""; // input trace whose gaze path every configuration replays (fixed center if empty)
+};
+
+// shading on the CPU instead of a GL context (CpuBackend), only runs the benchmark
+struct CpuParamsStruct
+{
+    bool bEnable = false;
+    std::vector<std::string> shaders = {"example", "gradient", "mandelbrot"}; // C++ ports of the main shaders
+    int num_threads = 0; // 0 uses every hardware thread
+};
+
 struct ParamsStruct
 {
     bool bEnableVsync, bEnableDebugMode;
     bool bEnableFovRender, bEnablePostProcessing;
+    bool bHotReload = true; // watch the shaders & this file, rebuilding whatever changed while running
+    int frames_in_flight = 2; // frames queued on the GPU at most (0 leaves it to the driver)
 
     MainShaderParams MainParams;
     FRShaderParams FRParams;
     WindowParamsStruct WindowParams;
+    ViewParamsStruct ViewParams;
+    BenchmarkParamsStruct BenchParams;
+    CpuParamsStruct CpuParams;
+    CaptureParamsStruct CaptureParams;
+    GazeParamsStruct GazeParams;
+    TraceParamsStruct TraceParams;
+    TimelineParamsStruct TimelineParams;
+    AdaptiveParamsStruct AdaptiveParams;
+    std::string params_socket = ""; // unix socket taking live key=value updates (empty disables)
     std::string FilePath;
-    void ParseFile()
+
+    // reads every key of FilePath (exits if it can't be read), into Values as well if given
+    void ParseFile(std::map<std::string, std::string> *Values = nullptr);
+    // parses Value into Key (ParamKeys), false if there's no such key or Value doesn't parse (nothing changes then)
+    bool Set(const std::string &Key, const std::string &Value, unsigned *Stage = nullptr);
+};
+
+// what has to be redone when a key changes while running (Renderer::SetParams)
+enum ParamStage : unsigned
+{
+    StageLive = 0,          // read whenever it's used (ex. every frame's FrameState), nothing to rebuild
+    StageTargets = 1 << 0,  // the window & its render targets
+    StagePrograms = 1 << 1, // shader programs, rebuilt in the background before the change is swapped in
+    StageRestart = 1 << 2,  // only read at startup
+};
+
+struct ParamKey
+{
+    const char *Name;
+    unsigned Stage;
+    void (*Set)(ParamsStruct &P, const std::string &Value); // throws (changing nothing) if Value doesn't parse
+};
+
+inline std::vector<float> stofv(const std::string &s, const char delim = ',')
+{
+    std::vector<float> Values;
+    for (const std::string &Element : split(s, delim))
+        Values.push_back(std::stof(Element));
+    return Values;
+}
+
+inline std::vector<int> stoiv(const std::string &s)
+{
+    std::vector<int> Values;
+    for (const std::string &Element : split(s, ','))
+        Values.push_back(std::stoi(Element));
+    return Values;
+}
+
+inline std::vector<float> stofracv(const std::string &s)
+{
+    std::vector<float> Values;
+    for (const std::string &Element : split(s, ','))
+        Values.push_back(stofrac(Element));
+    return Values;
+}
+
+// the first three radii (thresh1, thresh2 & thresh3)
+inline void SetThreshold(ParamsStruct &P, const size_t Level, const std::string &Value)
+{
+    const float Radius = std::stof(Value);
+    if (P.FRParams.radii.size() <= Level)
+        P.FRParams.radii.resize(Level + 1, 0.f);
+    P.FRParams.radii[Level] = Radius;
+}
+
+// every key of the params file
+inline const std::vector<ParamKey> &ParamKeys()
+{
+    using P = ParamsStruct;
+    using V = const std::string &;
+    static const std::vector<ParamKey> Keys = {
+        {"enable_vsync", StageLive, [](P &p, V v) { p.bEnableVsync = stob(v); }},
+        {"enable_foveated_render", StagePrograms, [](P &p, V v) { p.bEnableFovRender = stob(v); }},
+        {"enable_postprocessing", StageLive, [](P &p, V v) { p.bEnablePostProcessing = stob(v); }},
+        {"debug_mode", StageLive, [](P &p, V v) { p.bEnableDebugMode = stob(v); }},
+        {"frames_in_flight", StageLive, [](P &p, V v) { p.frames_in_flight = std::stoi(v); }},
+        {"hot_reload", StageRestart, [](P &p, V v) { p.bHotReload = stob(v); }},
+        {"params_socket", StageRestart, [](P &p, V v) { p.params_socket = v; }},
+        {"vertex_shader", StagePrograms, [](P &p, V v) { p.MainParams.vertex_shader_path = v; }},
+        {"fragment_shaders", StageRestart, [](P &p, V v) { p.MainParams.fragment_shader_dir = v; }},
+        {"non_fr_fragment_shader", StagePrograms, [](P &p, V v) { p.MainParams.non_fr_fragment_shader_path = v; }},
+        {"start_frag_shader", StageRestart, [](P &p, V v) { p.MainParams.fragment_shader_name = v; }},
+        {"shader_cache_dir", StageRestart, [](P &p, V v) { p.MainParams.cache_dir = v; }},
+        {"precompile_shaders", StageRestart, [](P &p, V v) { p.MainParams.bPrecompile = stob(v); }},
+        {"fr_fragment_shader", StagePrograms, [](P &p, V v) { p.FRParams.drop_shader = v; }},
+        {"fr_common_shader", StagePrograms, [](P &p, V v) { p.FRParams.common_shader = v; }},
+        {"fr_reconstruction_shader", StagePrograms, [](P &p, V v) { p.FRParams.reconstruction_shader = v; }},
+        {"fr_mask_shader", StagePrograms, [](P &p, V v) { p.FRParams.mask_shader = v; }},
+        {"fr_multires_shader", StagePrograms, [](P &p, V v) { p.FRParams.multires_shader = v; }},
+        {"fr_temporal_shader", StagePrograms, [](P &p, V v) { p.FRParams.temporal_shader = v; }},
+        {"fr_compute_shader", StagePrograms, [](P &p, V v) { p.FRParams.compute_shader = v; }},
+        {"fr_tile_shader", StagePrograms, [](P &p, V v) { p.FRParams.tile_shader = v; }},
+        {"fov_strategy", StagePrograms, [](P &p, V v) { p.FRParams.Strategy = stofs(v); }},
+        {"stencil_mask", StagePrograms, [](P &p, V v) { p.FRParams.bStencilMask = stob(v); }},
+        {"reconstruction_mode", StageLive, [](P &p, V v) { p.FRParams.Reconstruction = stors(v); }},
+        {"reconstruction_engine", StageRestart, [](P &p, V v) { p.FRParams.Engine = stoeng(v); }},
+        {"stride", StageLive, [](P &p, V v) { p.FRParams.stride = std::stoi(v); }},
+        {"thresh1", StageLive, [](P &p, V v) { SetThreshold(p, 0, v); }},
+        {"thresh2", StageLive, [](P &p, V v) { SetThreshold(p, 1, v); }},
+        {"thresh3", StageLive, [](P &p, V v) { SetThreshold(p, 2, v); }},
+        {"fov_radii", StageLive, [](P &p, V v) { p.FRParams.radii = stofv(v); }},
+        {"fov_keep", StageLive, [](P &p, V v) { p.FRParams.keep = stofracv(v); }},
+        {"fov_aspect", StageLive, [](P &p, V v) { p.FRParams.aspect = std::stof(v); }},
+        {"capture", StageRestart, [](P &p, V v) { p.CaptureParams.bEnable = stob(v); }},
+        // read whenever capturing starts (the C key)
+        {"capture_format", StageLive, [](P &p, V v) { p.CaptureParams.Format = stocf(v); }},
+        {"capture_path", StageLive, [](P &p, V v) { p.CaptureParams.path = v; }},
+        {"capture_command", StageLive,
+         [](P &p, V v) {
+             std::string Command;
+             for (const std::string &Arg : split(v, ','))
+                 Command += (Command.empty() ? "" : " ") + Arg;
+             p.CaptureParams.command = Command;
+         }},
+        {"capture_fps", StageLive, [](P &p, V v) { p.CaptureParams.fps = std::stoi(v); }},
+        {"capture_pbos", StageLive, [](P &p, V v) { p.CaptureParams.num_pbos = std::stoi(v); }},
+        {"gaze_source", StageRestart, [](P &p, V v) { p.GazeParams.Source = stogs(v); }},
+        {"gaze_trace", StageRestart, [](P &p, V v) { p.GazeParams.trace = v; }},
+        {"gaze_trace_loop", StageRestart, [](P &p, V v) { p.GazeParams.bTraceLoop = stob(v); }},
+        {"gaze_socket", StageRestart, [](P &p, V v) { p.GazeParams.socket = v; }},
+        {"gaze_predict", StageLive, [](P &p, V v) { p.GazeParams.bPredict = stob(v); }},
+        {"gaze_latency_ms", StageLive, [](P &p, V v) { p.GazeParams.latency_ms = std::stof(v); }},
+        {"gaze_saccade_speed", StageLive, [](P &p, V v) { p.GazeParams.saccade_speed = std::stof(v); }},
+        {"gaze_max_lead", StageLive, [](P &p, V v) { p.GazeParams.max_lead = std::stof(v); }},
+        {"trace_record", StageRestart, [](P &p, V v) { p.TraceParams.record = v; }},
+        {"trace_replay", StageRestart, [](P &p, V v) { p.TraceParams.replay = v; }},
+        {"trace_time_step", StageRestart, [](P &p, V v) { p.TraceParams.time_step = std::stof(v); }},
+        {"trace_output", StageRestart, [](P &p, V v) { p.TraceParams.output_prefix = v; }},
+        {"timeline", StageRestart, [](P &p, V v) { p.TimelineParams.bEnable = stob(v); }},
+        {"timeline_seconds", StageRestart, [](P &p, V v) { p.TimelineParams.seconds = std::stof(v); }},
+        {"timeline_spike_ms", StageLive, [](P &p, V v) { p.TimelineParams.spike_ms = std::stof(v); }},
+        {"timeline_output", StageLive, [](P &p, V v) { p.TimelineParams.output_prefix = v; }},
+        {"adaptive", StageLive, [](P &p, V v) { p.AdaptiveParams.bEnable = stob(v); }},
+        {"adaptive_target_ms", StageLive, [](P &p, V v) { p.AdaptiveParams.target_ms = std::stof(v); }},
+        {"adaptive_hysteresis", StageLive, [](P &p, V v) { p.AdaptiveParams.hysteresis = std::stof(v); }},
+        {"adaptive_frames", StageLive, [](P &p, V v) { p.AdaptiveParams.num_frames = std::stoi(v); }},
+        {"adaptive_min_radius", StageLive, [](P &p, V v) { p.AdaptiveParams.min_radius = std::stof(v); }},
+        {"adaptive_max_keep_steps", StageLive, [](P &p, V v) { p.AdaptiveParams.max_keep_steps = std::stoi(v); }},
+        {"adaptive_max_stride", StageLive, [](P &p, V v) { p.AdaptiveParams.max_stride = std::stoi(v); }},
+        {"init_width", StageTargets, [](P &p, V v) { p.WindowParams.X0 = std::stoi(v); }},
+        {"init_height", StageTargets, [](P &p, V v) { p.WindowParams.Y0 = std::stoi(v); }},
+        {"views", StagePrograms, [](P &p, V v) { p.ViewParams.views = std::stoi(v); }},
+        {"right_fov_radii", StageLive, [](P &p, V v) { p.ViewParams.right_radii = stofv(v); }},
+        {"right_fov_keep", StageLive, [](P &p, V v) { p.ViewParams.right_keep = stofracv(v); }},
+        {"right_fov_aspect", StageLive, [](P &p, V v) { p.ViewParams.right_aspect = std::stof(v); }},
+        {"enable_benchmark", StageRestart, [](P &p, V v) { p.BenchParams.bEnable = stob(v); }},
+        {"bench_headless", StageRestart, [](P &p, V v) { p.BenchParams.bHeadless = stob(v); }},
+        {"bench_context", StageRestart, [](P &p, V v) { p.BenchParams.context_api = v; }},
+        {"bench_width", StageRestart, [](P &p, V v) { p.BenchParams.width = std::stoi(v); }},
+        {"bench_height", StageRestart, [](P &p, V v) { p.BenchParams.height = std::stoi(v); }},
+        {"bench_frames", StageRestart, [](P &p, V v) { p.BenchParams.num_frames = std::stoi(v); }},
+        {"bench_warmup", StageRestart, [](P &p, V v) { p.BenchParams.num_warmup_frames = std::stoi(v); }},
+        {"bench_time_step", StageRestart, [](P &p, V v) { p.BenchParams.time_step = std::stof(v); }},
+        {"bench_strides", StageRestart, [](P &p, V v) { p.BenchParams.strides = stoiv(v); }},
+        {"bench_thresholds", StageRestart,
+         [](P &p, V v) {
+             // list of colon separated radii (one per level boundary, ex. "thresh1:thresh2:thresh3")
+             std::vector<std::vector<float>> Thresholds;
+             for (const std::string &Radii : split(v, ','))
+                 Thresholds.push_back(stofv(Radii, ':'));
+             p.BenchParams.thresholds = Thresholds;
+         }},
+        {"bench_strategies", StageRestart,
+         [](P &p, V v) {
+             std::vector<FovStrategy> Strategies;
+             for (const std::string &Strategy : split(v, ','))
+                 Strategies.push_back(stofs(Strategy));
+             p.BenchParams.strategies = Strategies;
+         }},
+        {"bench_reconstructions", StageRestart,
+         [](P &p, V v) {
+             std::vector<ReconstructionMode> Reconstructions;
+             for (const std::string &Reconstruction : split(v, ','))
+                 Reconstructions.push_back(stors(Reconstruction));
+             p.BenchParams.reconstructions = Reconstructions;
+         }},
+        {"bench_output", StageRestart, [](P &p, V v) { p.BenchParams.output_prefix = v; }},
+        {"bench_verify", StageRestart, [](P &p, V v) { p.BenchParams.bVerify = stob(v); }},
+        {"bench_quality", StageRestart, [](P &p, V v) { p.BenchParams.bQuality = stob(v); }},
+        {"bench_min_ssim", StageRestart, [](P &p, V v) { p.BenchParams.min_ssim = std::stof(v); }},
+        {"bench_trace", StageRestart, [](P &p, V v) { p.BenchParams.trace = v; }},
+        {"cpu_backend", StageRestart, [](P &p, V v) { p.CpuParams.bEnable = stob(v); }},
+        {"cpu_shaders", StageRestart, [](P &p, V v) { p.CpuParams.shaders = split(v, ','); }},
+        {"cpu_threads", StageRestart, [](P &p, V v) { p.CpuParams.num_threads = std::stoi(v); }},
+    };
+    return Keys;
+}
+
+// a "key=value" line of a params file (or the params socket), false for blanks, [sections] & comments
+inline bool ParseParamLine(const std::string &Line, std::pair<std::string, std::string> &Pair)
+{
+    const auto Trim = [](const std::string &s) {
+        const size_t First = s.find_first_not_of(" \t\r");
+        return (First == std::string::npos) ? std::string() : s.substr(First, s.find_last_not_of(" \t\r") - First + 1);
+    };
+    const std::string Trimmed = Trim(Line);
+    if (Trimmed.empty() || Trimmed[0] == '[' || Trimmed[0] == '#' || Trimmed[0] == ';')
+        return false;
+    const size_t Delim = Trimmed.find('=');
+    if (Delim == std::string::npos)
+    {
+        std::cerr << "ignoring \"" << Trimmed << "\", not a key=value pair" << std::endl;
+        return false;
+    }
+    Pair = {Trim(Trimmed.substr(0, Delim)), Trim(Trimmed.substr(Delim + 1))};
+    return true;
+}
+
+// every key=value of a params file in order, false if it can't be read
+inline bool ReadParamsFile(const std::string &Path, std::vector<std::pair<std::string, std::string>> &Pairs)
+{
+    std::ifstream Input(Path);
+    if (!Input.is_open())
+        return false;
+    std::string Line;
+    std::pair<std::string, std::string> Pair;
+    while (std::getline(Input, Line))
+    {
+        if (ParseParamLine(Line, Pair))
+            Pairs.push_back(Pair);
+    }
+    return true;
+}
+
+inline bool ParamsStruct::Set(const std::string &Key, const std::string &Value, unsigned *Stage)
+{
+    for (const ParamKey &K : ParamKeys())
     {
-        /// TODO: REFACTOR THIS
-        // create input stream to get file data
-        std::ifstream Input(FilePath);
-        if (!Input.is_open())
+        if (Key != K.Name)
+            continue;
+        try
         {
-            std::cout << "ERROR: could not open \"" << FilePath << "\"" << std::endl;
-            exit(1);
+            K.Set(*this, Value);
         }
-        std::cout << "Reading params from \"" << FilePath << "\"" << std::endl;
-
-        // read from file into params
-        std::string Tmp;
-        const std::string Delim = "=";
-        while (!Input.eof())
+        catch (const std::exception &)
         {
-            Input >> Tmp;
-            if (Input.bad() || Input.fail())
-                break;
-            if (Tmp.at(0) == '[' || Tmp.at(0) == '#' || Tmp.at(0) == ';') // ignoring labels & comments
-                continue;
-            std::string ParamName = Tmp.substr(0, Tmp.find(Delim));
-            std::string ParamValue = Tmp.substr(Tmp.find(Delim) + 1, Tmp.size());
-            if (!ParamName.compare("enable_vsync"))
-                bEnableVsync = stob(ParamValue);
-            else if (!ParamName.compare("enable_foveated_render"))
-                bEnableFovRender = stob(ParamValue);
-            else if (!ParamName.compare("enable_postprocessing"))
-                bEnablePostProcessing = stob(ParamValue);
-            else if (!ParamName.compare("debug_mode"))
-                bEnableDebugMode = stob(ParamValue);
-            else if (!ParamName.compare("vertex_shader"))
-                MainParams.vertex_shader_path = ParamValue;
-            else if (!ParamName.compare("fragment_shaders"))
-                MainParams.fragment_shader_dir = ParamValue;
-            else if (!ParamName.compare("non_fr_fragment_shader"))
-                MainParams.non_fr_fragment_shader_path = ParamValue;
-            else if (!ParamName.compare("start_frag_shader"))
-                MainParams.fragment_shader_name = ParamValue;
-            else if (!ParamName.compare("fr_fragment_shader"))
-                FRParams.drop_shader = ParamValue;
-            else if (!ParamName.compare("stride"))
-                FRParams.stride = std::stoi(ParamValue);
-            else if (!ParamName.compare("thresh1"))
-                FRParams.thresh1 = std::stof(ParamValue);
-            else if (!ParamName.compare("thresh2"))
-                FRParams.thresh2 = std::stof(ParamValue);
-            else if (!ParamName.compare("thresh3"))
-                FRParams.thresh3 = std::stof(ParamValue);
-            else if (!ParamName.compare("fr_reconstruction_shader"))
-                FRParams.reconstruction_shader = ParamValue;
-            else if (!ParamName.compare("init_width"))
-                WindowParams.X0 = std::stoi(ParamValue);
-            else if (!ParamName.compare("init_height"))
-                WindowParams.Y0 = std::stoi(ParamValue);
-            else
-                continue;
+            std::cerr << "can't parse \"" << Key << "=" << Value << "\"" << std::endl;
+            return false;
         }
+        if (Stage != nullptr)
+            *Stage = K.Stage;
+        return true;
     }
-};
+    std::cerr << "unknown param \"" << Key << "\"" << std::endl;
+    return false;
+}
+
+inline void ParamsStruct::ParseFile(std::map<std::string, std::string> *Values)
+{
+    std::vector<std::pair<std::string, std::string>> Pairs;
+    if (!ReadParamsFile(FilePath, Pairs))
+    {
+        std::cout << "ERROR: could not open \"" << FilePath << "\"" << std::endl;
+        exit(1);
+    }
+    std::cout << "Reading params from \"" << FilePath << "\"" << std::endl;
+    for (const auto &Pair : Pairs)
+    {
+        Set(Pair.first, Pair.second);
+        if (Values != nullptr)
+            (*Values)[Pair.first] = Pair.second;
+    }
+}
+
+inline int NumViews(const ParamsStruct &P)
+{
+    // the multires levels & composite only know a single view
+    if (P.bEnableFovRender && P.FRParams.Strategy == FovStrategy::MultiRes)
+        return 1;
+    return std::clamp(P.ViewParams.views, 1, MaxViews);
+}
+
+inline bool CheckViews(const ParamsStruct &P)
+{
+    const ViewParamsStruct &V = P.ViewParams;
+    if (V.views < 1 || V.views > MaxViews)
+    {
+        std::cerr << "views must be 1 or " << MaxViews << " (" << V.views << ")" << std::endl;
+        return false;
+    }
+    if (V.views == 1)
+        return true;
+    const FRShaderParams Right = ViewProfile(P.FRParams, V, 1);
+    if (!CheckFovProfile(Right))
+        return false;
+    if (Right.keep.size() != P.FRParams.keep.size())
+    {
+        std::cerr << "the right view's profile needs as many levels as the left one's" << std::endl;
+        return false;
+    }
+    if (P.FRParams.Strategy == FovStrategy::MultiRes)
+        std::cout << "WARNING: the multires strategy renders a single view" << std::endl;
+    return true;
+}
 
 #endif
\ No newline at end of file
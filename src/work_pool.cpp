@@ -0,0 +1,111 @@
+#include "work_pool.h"
+#include <algorithm>
+
+WorkPool::WorkPool(int NumThreads)
+{
+    if (NumThreads <= 0)
+        NumThreads = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 0; i < NumThreads; i++)
+        Queues.push_back(std::make_unique<Queue>());
+    for (int i = 1; i < NumThreads; i++)
+        Threads.emplace_back(&WorkPool::Loop, this, i);
+}
+
+WorkPool::~WorkPool()
+{
+    {
+        std::lock_guard<std::mutex> Guard(Lock);
+        bStop = true;
+    }
+    Wake.notify_all();
+    for (std::thread &T : Threads)
+        T.join();
+}
+
+void WorkPool::Run(const int NumTasks, const std::function<void(int)> &Task)
+{
+    {
+        std::unique_lock<std::mutex> Guard(Lock);
+        // a worker that woke up late may still be draining the previous batch (it can't find anything left, but
+        // it holds on to that batch's task), hand out the next one only once they're all back
+        Idle.wait(Guard, [&] { return Active == 0; });
+        const int N = NumThreads();
+        for (int i = 0; i < N; i++)
+        {
+            Queue &Q = *Queues[i];
+            std::lock_guard<std::mutex> QueueGuard(Q.Lock);
+            for (int t = static_cast<int>(static_cast<int64_t>(NumTasks) * i / N);
+                 t < static_cast<int>(static_cast<int64_t>(NumTasks) * (i + 1) / N); t++)
+                Q.Tasks.push_back(t);
+        }
+        Current = &Task;
+        Batch++;
+    }
+    Wake.notify_all();
+
+    Work(0, Task);
+
+    // every task has been taken once the caller's queue & everyone else's are empty, wait for the ones in flight
+    std::unique_lock<std::mutex> Guard(Lock);
+    Idle.wait(Guard, [&] { return Active == 0; });
+    Current = nullptr;
+}
+
+bool WorkPool::Pop(const int Worker, int &Task)
+{
+    {
+        Queue &Own = *Queues[Worker];
+        std::lock_guard<std::mutex> Guard(Own.Lock);
+        if (!Own.Tasks.empty())
+        {
+            Task = Own.Tasks.front();
+            Own.Tasks.pop_front();
+            return true;
+        }
+    }
+    const int N = NumThreads();
+    for (int i = 1; i < N; i++)
+    {
+        Queue &Victim = *Queues[(Worker + i) % N];
+        std::lock_guard<std::mutex> Guard(Victim.Lock);
+        if (!Victim.Tasks.empty())
+        {
+            Task = Victim.Tasks.back();
+            Victim.Tasks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkPool::Work(const int Worker, const std::function<void(int)> &Task)
+{
+    int Idx;
+    while (Pop(Worker, Idx))
+        Task(Idx);
+}
+
+void WorkPool::Loop(const int Worker)
+{
+    uint64_t Seen = 0;
+    while (true)
+    {
+        const std::function<void(int)> *Task;
+        {
+            std::unique_lock<std::mutex> Guard(Lock);
+            Wake.wait(Guard, [&] { return bStop || Batch != Seen; });
+            if (bStop)
+                return;
+            Seen = Batch;
+            Task = Current;
+            Active++;
+        }
+        if (Task != nullptr)
+            Work(Worker, *Task);
+        {
+            std::lock_guard<std::mutex> Guard(Lock);
+            Active--;
+        }
+        Idle.notify_all();
+    }
+}
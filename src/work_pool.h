@@ -0,0 +1,48 @@
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent threads running batches of indexed tasks. Every thread starts on a contiguous share of the batch
+// (neighbouring tiles stay on one core) and steals from the back of the others' once its own runs dry, so a few
+// expensive tasks (ex. the tiles around the gaze) don't leave the rest of the threads idle.
+class WorkPool
+{
+  public:
+    explicit WorkPool(int NumThreads = 0); // 0 uses every hardware thread, the calling thread counts as one
+    ~WorkPool();
+    WorkPool(const WorkPool &) = delete;
+    WorkPool &operator=(const WorkPool &) = delete;
+
+    int NumThreads() const { return static_cast<int>(Queues.size()); }
+    // runs Task(0) to Task(NumTasks - 1) on every thread (the caller's too), returns once all of them are done
+    void Run(int NumTasks, const std::function<void(int)> &Task);
+
+  private:
+    struct Queue
+    {
+        std::mutex Lock;
+        std::deque<int> Tasks;
+    };
+    bool Pop(int Worker, int &Task); // the front of its own queue, else the back of another one
+    void Work(int Worker, const std::function<void(int)> &Task);
+    void Loop(int Worker);
+
+    std::vector<std::unique_ptr<Queue>> Queues; // one per thread, the caller's first
+    std::vector<std::thread> Threads;
+    std::mutex Lock; // guards everything below
+    std::condition_variable Wake, Idle;
+    const std::function<void(int)> *Current = nullptr; // task of the running batch
+    uint64_t Batch = 0;                                  // batches started so far
+    int Active = 0;                                      // workers still on a batch
+    bool bStop = false;
+};
+
+#endif